@@ -0,0 +1,249 @@
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/time.h>
+#include "tile2d.h"
+using namespace std;
+
+// How many Tiles to cull, and how many times to cull them.
+#define TILE_COUNT 1000000
+#define RUNS 50
+
+// How many Tiles to fill in instances for.
+#define INSTANCE_COUNT 200000
+
+// Returns the time in milliseconds.
+double now()
+{
+    timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec*1000.0 + t.tv_usec/1000.0;
+}
+
+// Culls the Tiles RUNS times, and works out the average and quickest time
+// it took. (A busy machine can make the average a lot worse than the
+// kernel really is.)
+unsigned int timeCull(const CullBounds & b, const CullView & v, unsigned int * out,
+                      WorkerPool * pool, double & average, double & best)
+{
+    unsigned int visible = 0;
+    double total = 0.0;
+    best = 1e9;
+    for( unsigned int r = 0; r < RUNS; ++r )
+    {
+        double start = now();
+        visible = CullKernel::cull(b, v, out, pool);
+        double ms = now() - start;
+        total += ms;
+        best = min(best, ms);
+    }
+    average = total / RUNS;
+    return visible;
+}
+
+float randRange(float lo, float hi)
+{
+    return lo + (hi-lo)*(rand()/(float)RAND_MAX);
+}
+
+/*
+ * What the instance workers need: the same things the Renderer's do.
+ */
+struct InstanceBench
+{
+    Renderer * renderer;
+    RenderQueue * queue;
+    TileInstance * prepared;
+};
+
+// Fills in the instances of part of the gathered Tiles, like the Renderer's
+// workers do before drawing. (Nothing's occluded or scissored away here, so
+// the draw list is just every gathered Tile, in order.)
+void prepare(void * job, unsigned int begin, unsigned int end, unsigned int /*part*/)
+{
+    InstanceBench * j = (InstanceBench*) job;
+    for( unsigned int i = begin; i < end; ++i )
+    {
+        TileWithType t = j->queue->getVisible(i);
+        if( t.second->getInstanceShaderKey() == NULL ) continue;
+        t.second->fillInstance(j->renderer, &j->prepared[i]);
+        j->prepared[i].layer = j->queue->getVisibleLayer(i);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Scatter a million Tiles over a world ten screens wide and tall, across
+    // five planes and screen space. They're grouped by plane, like the
+    // RenderQueue hands them over.
+    vector<float> x(TILE_COUNT), y(TILE_COUNT);
+    vector<unsigned short> hw(TILE_COUNT), hh(TILE_COUNT);
+    vector<unsigned char> view(TILE_COUNT);
+    srand(1234);
+    for( unsigned int i = 0; i < TILE_COUNT; ++i )
+    {
+        x[i] = randRange(-10.0, 10.0);
+        y[i] = randRange(-10.0, 10.0);
+        hw[i] = CullKernel::packExtent(randRange(0.05, 0.5));
+        hh[i] = CullKernel::packExtent(randRange(0.05, 0.5));
+        view[i] = i / (TILE_COUNT/6 + 1);
+    }
+
+    CullBounds b;
+    b.x = &x[0];
+    b.y = &y[0];
+    b.halfW = &hw[0];
+    b.halfH = &hh[0];
+    b.view = &view[0];
+    b.count = TILE_COUNT;
+
+    // A camera a ways off the origin, with some parallax.
+    CullView v;
+    float factors[6] = {1.5, 1.0, 0.75, 0.5, 0.25, 1.0};
+    for( unsigned int i = 0; i < 6; ++i )
+    {
+        v.scale[i] = factors[i];
+        v.centerX[i] = 2.0*factors[i];
+        v.centerY[i] = -1.0*factors[i];
+    }
+    v.scale[5] = 1.0;
+    v.centerX[5] = 0.0;
+    v.centerY[5] = 0.0;
+    v.extentX = 1.0;
+    v.extentY = 1.0;
+
+    // Cull them with every path this machine can run, and make sure they
+    // all agree.
+    vector<unsigned int> reference(TILE_COUNT), out(TILE_COUNT);
+    unsigned int expected = 0;
+    for( int p = CULL_SCALAR; p <= CullKernel::getBestPath(); ++p )
+    {
+        CullKernel::setPath((cull_path)p);
+        CullKernel::cull(b, v, &out[0]);
+
+        double ms, best;
+        unsigned int visible = timeCull(b, v, &out[0], NULL, ms, best);
+
+        cout << CullKernel::getPathName((cull_path)p) << ": " << visible << " of " << TILE_COUNT
+             << " visible, " << ms << "ms per cull (best " << best << "ms)." << endl;
+
+        if( p == CULL_SCALAR )
+        {
+            reference = out;
+            expected = visible;
+        }
+        else if( visible != expected || !equal(out.begin(), out.begin()+visible, reference.begin()) )
+        {
+            cout << "  Doesn't match the scalar path!" << endl;
+            return 1;
+        }
+    }
+
+    // Then split the best path between more and more threads, and make sure
+    // the order doesn't change.
+    CullKernel::setPath(CullKernel::getBestPath());
+    double single = 0.0;
+    for( unsigned int threads = 1; threads <= 8; threads *= 2 )
+    {
+        WorkerPool pool;
+        pool.init(threads);
+        CullKernel::cull(b, v, &out[0], &pool);
+
+        double ms, best;
+        unsigned int visible = timeCull(b, v, &out[0], &pool, ms, best);
+        pool.destroy();
+        if( threads == 1 ) single = ms;
+
+        cout << threads << " thread" << (threads > 1 ? "s" : "") << ": " << ms << "ms per cull (best "
+             << best << "ms), " << single/ms << "x." << endl;
+
+        if( visible != expected || !equal(out.begin(), out.begin()+visible, reference.begin()) )
+        {
+            cout << "  Doesn't match one thread!" << endl;
+            return 1;
+        }
+    }
+
+    // Now fill in the instances of a screen full of SceneTiles and
+    // AnimTiles, in drawing order, split between the same numbers of
+    // threads. Nothing here needs a window; the Renderer's just there for
+    // the AnimTiles' clock.
+    Renderer renderer;
+    RenderQueue queue;
+    vector<Tile*> tiles;
+    for( unsigned int i = 0; i < INSTANCE_COUNT; ++i )
+    {
+        Tile * t;
+        tile_type type;
+        if( i % 3 == 0 )
+        {
+            AnimTile * a = new AnimTile();
+            a->init(randRange(-1.0, 1.0), randRange(-1.0, 1.0), (tile_plane)(i % 5), .05, .05,
+                    false, (char*)"tex", 4, 8, 8, false, .1);
+            t = a;
+            type = ANIM_TILE;
+        }
+        else
+        {
+            SceneTile * st = new SceneTile();
+            st->init(randRange(-1.0, 1.0), randRange(-1.0, 1.0), (tile_plane)(i % 5), .05, .05,
+                     i % 2, (char*)"tex");
+            t = st;
+            type = SCENE_TILE;
+        }
+        t->setRotation(i*.01);
+        tiles.push_back(t);
+        queue.addToRenderQueue(type, t);
+    }
+    queue.gatherVisible(0.0, 0.0, 0.0, 0.0);
+    unsigned int drawn = queue.visibleSize();
+    vector<TileInstance> prepared(drawn), first;
+
+    single = 0.0;
+    for( unsigned int threads = 1; threads <= 8; threads *= 2 )
+    {
+        WorkerPool pool;
+        pool.init(threads);
+        InstanceBench j;
+        j.renderer = &renderer;
+        j.queue = &queue;
+        j.prepared = &prepared[0];
+        pool.run(prepare, &j, drawn, INSTANCE_GRAIN);
+
+        double total = 0.0, best = 1e9;
+        for( unsigned int r = 0; r < RUNS; ++r )
+        {
+            double start = now();
+            pool.run(prepare, &j, drawn, INSTANCE_GRAIN);
+            double ms = now() - start;
+            total += ms;
+            best = min(best, ms);
+        }
+        double ms = total / RUNS;
+        pool.destroy();
+        if( threads == 1 )
+        {
+            single = ms;
+            first = prepared;
+        }
+
+        cout << "Instances, " << threads << " thread" << (threads > 1 ? "s" : "") << ": " << drawn
+             << " Tiles, " << ms << "ms (best " << best << "ms), " << single/ms << "x." << endl;
+
+        if( memcmp(&first[0], &prepared[0], drawn*sizeof(TileInstance)) != 0 )
+        {
+            cout << "  Doesn't match one thread!" << endl;
+            return 1;
+        }
+    }
+
+    queue.flush();
+    for( unsigned int i = 0; i < tiles.size(); ++i )
+    {
+        tiles[i]->destroy();
+        delete tiles[i];
+    }
+    return 0;
+}
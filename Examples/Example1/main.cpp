@@ -76,6 +76,7 @@ int main(int argc, char **argv)
     for(int i = 0; i < 11; ++i)
     {
         leftwall[i] = r->makeSceneTile(-32,y,PLANE_PLAYFIELD_B,64,32,true,"wall");
+        leftwall[i]->setStatic(true);
         y+= 32;
     }
     for(int i = 0; i < 11; ++i) r->addToRenderQueue(SCENE_TILE,leftwall[i]);
@@ -94,6 +95,7 @@ int main(int argc, char **argv)
     for(int i = 0; i < 7; ++i)
     {
         rightwall[i] = r->makeSceneTile(480,y,PLANE_PLAYFIELD_B,64,32,true,"wall");
+        rightwall[i]->setStatic(true);
         y+= 32;
     }
     for(int i = 0; i < 7; ++i) r->addToRenderQueue(SCENE_TILE,rightwall[i]);
@@ -104,6 +106,7 @@ int main(int argc, char **argv)
     for(int i = 0; i < 14; ++i)
     {
         ceiling[i] = r->makeSceneTile(x,416,PLANE_PLAYFIELD_B,32,64,true,"ceiling");
+        ceiling[i]->setStatic(true);
         x+= 32;
     }
     for(int i = 0; i < 14; ++i) r->addToRenderQueue(SCENE_TILE,ceiling[i]);
@@ -4,7 +4,7 @@
 #include "Shader.h"
 #include "Tile.h"
 #include "Renderer.h"
-#include "BasicMatrix.h"
+#include "Matrix.h"
 
 /**
  * @class AnimTile
@@ -55,6 +55,24 @@ private:
      */
     float lastChange;
 
+    /*
+     * When this AnimTile is instanced its frame is worked out by the vertex
+     * shader. This is the time (or frame count) its animation was started
+     * at, or negative if it hasn't been yet.
+     */
+    double animStart;
+    
+    /*
+     * The frame shown when the instanced animation was started.
+     */
+    unsigned int startFrame;
+    
+    /*
+     * The time (or frame count) this AnimTile was last instanced at, so
+     * that we can still tell which frame it's on.
+     */
+    double lastSeen;
+
     /*
      * The key to this AnimTile's texture.
      */
@@ -65,6 +83,12 @@ private:
      * to malloc during the render call.
      */
     static GLfloat* fractFrameDim;
+    
+    /**
+     * @brief Brings curFrame up to date with the instanced animation, then
+     *        stops it so that it's restarted from curFrame.
+     */
+    void syncFrame();
 
 public:
 
@@ -104,6 +128,14 @@ public:
      */
     void render(Renderer * r);
     
+    /**
+     * @brief Fills out this AnimTile's per-instance attributes, including
+     *        what the vertex shader needs to figure out the current frame.
+     * @param r The Renderer drawing this AnimTile.
+     * @param inst The TileInstance to fill out.
+     */
+    void fillInstance(Renderer * r, TileInstance * inst);
+    
     /**
      * @brief Returns the amount of time to wait between changing frames.
      * @return  The amount of time to wait before iterating the current frame.
@@ -160,6 +192,24 @@ public:
      */
     void setNumFrames(unsigned int numFrames);
     
+    /**
+     * @brief Returns the key of the Shader this AnimTile is drawn with.
+     * @return The key of the Shader this AnimTile is drawn with.
+     */
+    const char * getShaderKey();
+    
+    /**
+     * @brief Returns the key of the Texture this AnimTile is drawn with.
+     * @return The key of the Texture this AnimTile is drawn with.
+     */
+    const char * getTextureKey();
+    
+    /**
+     * @brief Returns the key of the Shader that draws AnimTiles instanced.
+     * @return The key of the Shader that draws AnimTiles instanced.
+     */
+    const char * getInstanceShaderKey();
+    
     /**
 	 * @brief Prints out info to stdout about this Tile.
 	 */
@@ -3,9 +3,11 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include "Asset.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "TextureArray.h"
 
 class Texture;
 class Shader;
@@ -28,6 +30,24 @@ private:
      */
     std::map<std::string, Asset*> assetHash;
     
+    /*
+     * Whether or not newly loaded Textures are also copied into
+     * TextureArrays.
+     */
+    bool useTextureArrays;
+    
+    /*
+     * The TextureArrays Textures have been copied into.
+     */
+    std::vector<TextureArray*> textureArrays;
+    
+    /**
+     * @brief Copies a Texture into the first TextureArray with the same
+     *        dimensions and format that has room, creating one if need be.
+     * @param t The Texture to copy.
+     */
+    void addToTextureArray(Texture * t);
+    
     /**
      * @brief Adds an Asset pointer to the manager.
      * @param key The key to associate this Asset with.
@@ -92,6 +112,26 @@ public:
      */
     shader_error addNewShaderStrings(const char * key, const char * vertString, const char * fragString);
     
+    /**
+     * @brief Sets whether or not Textures loaded from here on are also
+     *        copied into texture arrays, one per distinct size and format.
+     *        Instanced Tiles whose Textures share an array can be drawn in
+     *        a single batch even when their Textures differ. This costs a
+     *        second copy of each Texture in video memory, and requires
+     *        EXT_texture_array.
+     * @param use Whether or not to use texture arrays.
+     * @return Whether or not texture arrays are now in use. If false when
+     *         true was requested, they aren't supported.
+     */
+    bool setUseTextureArrays(bool use);
+    
+    /**
+     * @brief Returns whether or not loaded Textures are copied into texture
+     *        arrays.
+     * @return Whether or not loaded Textures are copied into texture arrays.
+     */
+    bool usesTextureArrays();
+    
     /**
      * @brief Tests whether an Asset exists in the Manager.
      * @param key The key associated with the Asset.
@@ -4,7 +4,7 @@
 #include "Shader.h"
 #include "Tile.h"
 #include "Renderer.h"
-#include "BasicMatrix.h"
+#include "Matrix.h"
 
 /**
  * @class BGTile
@@ -34,7 +34,7 @@ public:
     ~BGTile();
     
     /**
-     * @brief Initializes this BGTile, setting up the underlying BasicMatrix.
+     * @brief Initializes this BGTile, setting up the underlying matrices.
      * @param x The X position of this BGTile.
      * @param y The Y position of this BGTile.
      * @param width The width of this BGTile.
@@ -61,6 +61,24 @@ public:
      */
     char * getTexture();
     
+    /**
+     * @brief Returns the key of the Shader this BGTile is drawn with.
+     * @return The key of the Shader this BGTile is drawn with.
+     */
+    const char * getShaderKey();
+    
+    /**
+     * @brief Returns the key of the Texture this BGTile is drawn with.
+     * @return The key of the Texture this BGTile is drawn with.
+     */
+    const char * getTextureKey();
+    
+    /**
+     * @brief Returns the key of the Shader that draws BGTiles instanced.
+     * @return The key of the Shader that draws BGTiles instanced.
+     */
+    const char * getInstanceShaderKey();
+    
     /**
 	 * @brief Prints out info to stdout about this Tile.
 	 */
@@ -0,0 +1,172 @@
+#ifndef CULLKERNEL_H
+#define CULLKERNEL_H
+
+#include <cstddef>
+#include <cstring>
+#include "WorkerPool.h"
+
+// The fewest Tiles a worker is given to cull. Less than this and splitting
+// them up costs more than it saves.
+#define CULL_GRAIN 2048
+
+// The most views a CullView can have. (The RenderQueue uses one per plane,
+// plus one for Tiles that ignore scroll.) The AVX2 kernel keeps them all in
+// two registers, so this can't go any higher.
+#define CULL_MAX_VIEWS 16
+
+/*
+ * The bounds of a bunch of Tiles, as a structure of arrays. Each array holds
+ * one value per Tile, so the kernel can chew through them several at a time.
+ * The view member says which of the CullView's views each Tile is seen
+ * through.
+ *
+ * Culling a lot of Tiles is mostly reading, so the half extents are packed
+ * into 16 bits with packExtent(): just the top half of the float, rounded
+ * up. That's 13 bytes a Tile instead of 17, unpacking is a single shift,
+ * and a Tile can only ever come out a hair bigger than it is (less than
+ * 1%), never smaller.
+ */
+struct CullBounds
+{
+    const float * x;
+    const float * y;
+    const unsigned short * halfW;
+    const unsigned short * halfH;
+    const unsigned char * view;
+    unsigned int count;
+};
+
+/*
+ * What the Tiles are being culled against. A Tile seen through view v is on
+ * screen when |x*scale[v] - centerX[v]| <= extentX + halfW, and likewise
+ * for Y. (The scale is a plane's parallax factor, and the center is where
+ * the camera is in that plane's scaled space.)
+ */
+struct CullView
+{
+    float scale[CULL_MAX_VIEWS];
+    float centerX[CULL_MAX_VIEWS];
+    float centerY[CULL_MAX_VIEWS];
+    float extentX;
+    float extentY;
+};
+
+/*
+ * The different implementations of the kernel.
+ */
+enum cull_path
+{
+    CULL_SCALAR,
+    CULL_SSE2,
+    CULL_AVX2
+};
+
+/**
+ * @class CullKernel
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file CullKernel.h
+ * @brief Tests a whole array of Tile bounds against the view at once, and
+ *        writes out the indices of the ones that are on screen. There are
+ *        SSE2 and AVX2 versions, and the best one the CPU supports is picked
+ *        the first time it's used. Everything else falls back to plain C++.
+ *        Build with T2D_NO_SIMD to only ever use the plain version.
+ */
+class CullKernel
+{
+private:
+
+    /*
+     * The implementation in use, and the best one the CPU supports.
+     */
+    static cull_path path;
+    static cull_path best;
+    static bool detected;
+    
+    /**
+     * @brief Works out the best implementation the CPU supports.
+     */
+    static void detect();
+    
+    /**
+     * @brief The implementations. Each culls the Tiles from first to the
+     *        end of the bounds and returns how many indices it wrote out.
+     */
+    static unsigned int cullScalar(const CullBounds & b, const CullView & v, unsigned int first, unsigned int * out);
+    static unsigned int cullSSE2(const CullBounds & b, const CullView & v, unsigned int * out);
+    static unsigned int cullAVX2(const CullBounds & b, const CullView & v, unsigned int * out);
+    
+    /**
+     * @brief Culls one part of the bounds for a WorkerPool. The on-screen
+     *        indices are written out starting at the part's beginning.
+     */
+    static void cullPart(void * job, unsigned int begin, unsigned int end, unsigned int part);
+
+public:
+
+    /**
+     * @brief Culls an array of Tile bounds.
+     * @param b The bounds to cull.
+     * @param v What to cull them against.
+     * @param out Where to write the indices of the on-screen Tiles, in
+     *        order. Needs room for b.count of them.
+     * @return How many Tiles are on screen.
+     */
+    static unsigned int cull(const CullBounds & b, const CullView & v, unsigned int * out);
+    
+    /**
+     * @brief Culls an array of Tile bounds, split up between the threads of
+     *        a WorkerPool. The indices come out in the same order as they
+     *        would on one thread.
+     * @param b The bounds to cull.
+     * @param v What to cull them against.
+     * @param out Where to write the indices of the on-screen Tiles, in
+     *        order. Needs room for b.count of them.
+     * @param pool The WorkerPool to split the work between.
+     * @return How many Tiles are on screen.
+     */
+    static unsigned int cull(const CullBounds & b, const CullView & v, unsigned int * out,
+                             WorkerPool * pool);
+    
+    /**
+     * @brief Returns the implementation in use.
+     * @return The implementation in use.
+     */
+    static cull_path getPath();
+    
+    /**
+     * @brief Picks the implementation to use. Asking for one the CPU doesn't
+     *        support gets the best one it does.
+     * @param p The implementation to use.
+     */
+    static void setPath(cull_path p);
+    
+    /**
+     * @brief Returns the best implementation the CPU supports.
+     * @return The best implementation the CPU supports.
+     */
+    static cull_path getBestPath();
+    
+    /**
+     * @brief Packs a half extent into 16 bits for CullBounds, rounding up.
+     * @param f The half extent.
+     * @return The top half of the float, rounded up.
+     */
+    static unsigned short packExtent(float f);
+    
+    /**
+     * @brief Unpacks a half extent packed with packExtent().
+     * @param h The packed half extent.
+     * @return It as a float.
+     */
+    static float unpackExtent(unsigned short h);
+    
+    /**
+     * @brief Returns the name of an implementation.
+     * @param p The implementation.
+     * @return Its name.
+     */
+    static const char * getPathName(cull_path p);
+};
+
+#endif // CULLKERNEL_H
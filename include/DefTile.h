@@ -5,7 +5,7 @@
 #include "Tile.h"
 #include "Renderer.h"
 #include "Shader.h"
-#include "BasicMatrix.h"
+#include "Matrix.h"
 
 /**
  * @class DefTile
@@ -22,6 +22,10 @@
  *        transform: The Tile's transformation matrix. Note though that unlike
  *         other Tiles, this one must have the Camera position taken into its 
  *         account by the vertex shader. (mat3)
+ *        scrollCoeffs: The parallax factor of each plane. (float[10])
+ *        plane: The plane of this Tile, or 10 if it ignores scroll. Together
+ *         with scrollCoeffs, it's all the parallax math needs, just like the
+ *         stock shaders. (float)
  *        fwdColor: The color buffer of the first pass. (sampler2D)
  *        fwdDepth: The depth buffer of the first pass. (sampler2D)
  *        texA: The first custom texture. (sampler2D)
@@ -66,7 +70,7 @@ public:
     
     /**
      * @brief Initializes this DefTile. This is a hefty one. It sets up the
-     *        internal BasicMatrix pointer, as well as defines the shader and
+     *        internal matrices, as well as defines the shader and
      *        all the textures to be used. 
      *        To not use a texture slot, just pass in NULL. Note though, that 
      *        the corresponding uniform must still be present in the shader. 
@@ -160,6 +164,18 @@ public:
      */
     char * getTexD();
     
+    /**
+     * @brief Returns the key of the Shader this DefTile is drawn with.
+     * @return The key of the Shader this DefTile is drawn with.
+     */
+    const char * getShaderKey();
+    
+    /**
+     * @brief Returns the key of the first Texture this DefTile is drawn with.
+     * @return The key of the first Texture this DefTile is drawn with.
+     */
+    const char * getTextureKey();
+    
     /**
 	 * @brief Prints out info to stdout about this Tile.
 	 */
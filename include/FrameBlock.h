@@ -0,0 +1,127 @@
+#ifndef FRAMEBLOCK_H
+#define FRAMEBLOCK_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <cstring>
+
+// The name of the uniform block Shaders declare to get the per-frame
+// values, and the binding point it's bound to.
+#define FRAME_BLOCK_NAME "T2DFrame"
+#define FRAME_BLOCK_BINDING 0
+
+// How many scroll coefficients fit in the block. (vec4[3], so at least
+// NUM_PLANES.)
+#define FRAME_BLOCK_SCROLL_COEFFS 12
+
+/*
+ * The contents of the frame block, laid out to match std140. Everything's a
+ * vec4 (or an array of them) so there's no padding to worry about.
+ */
+struct FrameBlockData
+{
+    GLfloat camera[4];                          // Camera X, Y, offset X, offset Y.
+    GLfloat resolution[4];                      // Framebuffer W, H, window W, H.
+    GLfloat scroll[FRAME_BLOCK_SCROLL_COEFFS];  // The parallax factor of each plane.
+    GLfloat time[4];                            // Frame time, frame count.
+};
+
+/**
+ * @class FrameBlock
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file FrameBlock.h
+ * @brief A uniform buffer (ARB_uniform_buffer_object) holding the values
+ *        that are the same for every Tile in a frame, so that they're
+ *        uploaded once per frame rather than once per Tile. Any Shader that
+ *        declares the block gets it bound automatically:
+ * 
+ *        #extension GL_ARB_uniform_buffer_object : require
+ *        layout(std140) uniform T2DFrame
+ *        {
+ *            vec4 t2dCamera;       // xy: camera position, zw: parallax offset
+ *            vec4 t2dResolution;   // xy: framebuffer size, zw: window size
+ *            vec4 t2dScroll[3];    // The parallax factor of each plane.
+ *            vec4 t2dTime;         // x: frame time, y: frame count
+ *        };
+ * 
+ *        Where uniform buffers aren't supported the block does nothing, and
+ *        Tiles fall back on setting the old individual uniforms.
+ */
+class FrameBlock
+{
+private:
+
+    /*
+     * The handle to the uniform buffer.
+     */
+    GLuint buffer;
+    
+    /*
+     * Whether or not uniform buffers are supported.
+     */
+    bool supported;
+    
+    /*
+     * The values to upload next.
+     */
+    FrameBlockData data;
+
+public:
+
+    /**
+     * @brief Constructs a new FrameBlock. Use init() to create it.
+     */
+    FrameBlock();
+    
+    /**
+     * @brief Destructs this FrameBlock. Call destroy() first.
+     */
+    ~FrameBlock();
+    
+    /**
+     * @brief Creates the uniform buffer and binds it to FRAME_BLOCK_BINDING,
+     *        if uniform buffers are supported.
+     */
+    void init();
+    
+    /**
+     * @brief Returns whether or not uniform buffers are supported.
+     * @return Whether or not uniform buffers are supported.
+     */
+    bool isSupported();
+    
+    /**
+     * @brief Sets the camera position and parallax offset.
+     */
+    void setCamera(GLfloat x, GLfloat y, GLfloat offX, GLfloat offY);
+    
+    /**
+     * @brief Sets the framebuffer and window resolutions.
+     */
+    void setResolution(GLfloat fbWidth, GLfloat fbHeight, GLfloat winWidth, GLfloat winHeight);
+    
+    /**
+     * @brief Sets the parallax factor of a plane.
+     * @param plane The plane.
+     * @param coeff Its parallax factor.
+     */
+    void setScroll(unsigned int plane, GLfloat coeff);
+    
+    /**
+     * @brief Sets the frame time and frame count.
+     */
+    void setTime(GLfloat time, GLfloat frameCount);
+    
+    /**
+     * @brief Sends everything that's been set to the GPU.
+     */
+    void upload();
+    
+    /**
+     * @brief Frees the uniform buffer.
+     */
+    void destroy();
+};
+
+#endif // FRAMEBLOCK_H
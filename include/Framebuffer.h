@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "GLStateCache.h"
 
 /**
  * @class Framebuffer
@@ -12,6 +13,8 @@
  * @file Framebuffer.h
  * @brief Encapsulates an OpenGL framebuffer Object. Both the color0 and depth
  *        attachments are readable textures. (RGBA and DEPTH_COMPONENT).
+ *        Where packed depth-stencil is supported the depth texture has
+ *        stencil too, though it still samples as plain depth.
  */
 class Framebuffer
 {
@@ -42,6 +45,18 @@ private:
      */
     GLuint depthbuffer;
     
+    /*
+     * Whether or not the depth attachment has stencil.
+     */
+    bool stencil;
+    
+    /**
+     * @brief Creates the attachments and the framebuffer itself.
+     * @param stencil Whether or not to give the depth attachment stencil.
+     * @return Whether or not the framebuffer is complete.
+     */
+    bool create(bool stencil);
+    
 public:
 
     /**
@@ -100,6 +115,12 @@ public:
      */
     GLuint getDepthTexture();
     
+    /**
+     * @brief Returns whether or not this Framebuffer has a stencil buffer.
+     * @return Whether or not this Framebuffer has a stencil buffer.
+     */
+    bool hasStencil();
+    
     /**
      * @brief Destroys all of this Framebuffer's holdings on the GPU.
      */
@@ -0,0 +1,166 @@
+#ifndef GLSTATECACHE_H
+#define GLSTATECACHE_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <cstddef>
+
+// How many texture units have their bindings tracked. Units past this are
+// passed straight through to OpenGL.
+#define GL_STATE_CACHE_UNITS 16
+
+/**
+ * @class GLStateCache
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file GLStateCache.h
+ * @brief Keeps track of the bits of OpenGL state the engine changes the
+ *        most: the current program, the texture bound to each unit, the
+ *        bound framebuffer, the viewport, the bound VAO, and blending and
+ *        depth testing. Changes that wouldn't change anything are skipped.
+ *        
+ *        This only works if everything goes through it. If you change any of
+ *        that state with OpenGL directly, call invalidate() afterwards so the
+ *        cache doesn't think it knows better. The same goes for when the
+ *        context changes.
+ */
+class GLStateCache
+{
+private:
+    
+    /*
+     * The state we think OpenGL is in. Anything set to its "unknown" value
+     * (see invalidate()) always gets sent through.
+     */
+    static GLuint program;
+    static GLuint activeUnit;
+    static GLuint textures2D[GL_STATE_CACHE_UNITS];
+    static GLuint texturesArray[GL_STATE_CACHE_UNITS];
+    static GLuint framebuffer;
+    static GLint viewportRect[4];
+    static GLuint vertexArray;
+    static int blend;
+    static GLenum blendSrc, blendDst;
+    static int depthTest;
+    static GLenum depthFuncValue;
+    
+    /*
+     * How many state changes were sent to OpenGL, and how many were
+     * filtered out because they wouldn't have changed anything.
+     */
+    static unsigned long issuedCount;
+    static unsigned long filteredCount;
+    
+    /**
+     * @brief Returns the cached binding of a texture unit for the given
+     *        target, or NULL if that target isn't tracked.
+     */
+    static GLuint * getTextureSlot(GLuint unit, GLenum target);
+    
+    /**
+     * @brief Counts a state change as issued or filtered.
+     * @param changed Whether or not the state changed.
+     * @return Whether or not the state changed.
+     */
+    static bool count(bool changed);
+    
+public:
+
+    /**
+     * @brief Forgets everything we know about the OpenGL state, so that the
+     *        next change of each kind goes through no matter what.
+     */
+    static void invalidate();
+    
+    /**
+     * @brief glUseProgram(), if the program isn't already in use.
+     */
+    static void useProgram(GLuint program);
+    
+    /**
+     * @brief glActiveTexture(), if the unit isn't already active.
+     * @param unit The texture unit, counting from zero. (Not GL_TEXTURE0+.)
+     */
+    static void activeTexture(GLuint unit);
+    
+    /**
+     * @brief Binds a texture to a texture unit, if it isn't already bound
+     *        there. GL_TEXTURE_2D and GL_TEXTURE_2D_ARRAY_EXT are tracked.
+     * @param unit The texture unit, counting from zero.
+     * @param target The texture target.
+     * @param texture The texture to bind.
+     */
+    static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    
+    /**
+     * @brief Binds a texture to whichever texture unit is active.
+     * @param target The texture target.
+     * @param texture The texture to bind.
+     */
+    static void bindTexture(GLenum target, GLuint texture);
+    
+    /**
+     * @brief glBindFramebuffer(GL_FRAMEBUFFER, ...), if it isn't already bound.
+     */
+    static void bindFramebuffer(GLuint framebuffer);
+    
+    /**
+     * @brief glViewport(), if the viewport is different.
+     */
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    
+    /**
+     * @brief glBindVertexArray(), if it isn't already bound.
+     */
+    static void bindVertexArray(GLuint vertexArray);
+    
+    /**
+     * @brief Enables or disables GL_BLEND, if it isn't already.
+     */
+    static void setBlend(bool enabled);
+    
+    /**
+     * @brief glBlendFunc(), if the blend function is different.
+     */
+    static void blendFunc(GLenum src, GLenum dst);
+    
+    /**
+     * @brief Enables or disables GL_DEPTH_TEST, if it isn't already.
+     */
+    static void setDepthTest(bool enabled);
+    
+    /**
+     * @brief glDepthFunc(), if the depth function is different.
+     */
+    static void depthFunc(GLenum func);
+    
+    /**
+     * @brief Call these when deleting an object, since OpenGL unbinds
+     *        deleted objects and might give their names out again.
+     */
+    static void forgetProgram(GLuint program);
+    static void forgetTexture(GLuint texture);
+    static void forgetFramebuffer(GLuint framebuffer);
+    static void forgetVertexArray(GLuint vertexArray);
+    
+    /**
+     * @brief Returns how many state changes were sent to OpenGL since the
+     *        counts were last reset.
+     * @return How many state changes were sent to OpenGL.
+     */
+    static unsigned long getIssuedCount();
+    
+    /**
+     * @brief Returns how many state changes were filtered out since the
+     *        counts were last reset.
+     * @return How many state changes were filtered out.
+     */
+    static unsigned long getFilteredCount();
+    
+    /**
+     * @brief Resets the issued and filtered counts.
+     */
+    static void resetCounts();
+};
+
+#endif // GLSTATECACHE_H
@@ -0,0 +1,197 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <cmath>
+
+/**
+ * @class Matrix
+ * @author Gerard Geer
+ * @date 06/25/16
+ * @file Matrix.h
+ * @brief A matrix whose size is known at compile time, so it can live inside
+ *        whatever owns it instead of on the heap. Like BasicMatrix, the values
+ *        are stored row-major in one flat array, so getLinear() can be handed
+ *        straight to a ShaderUniform. Unlike BasicMatrix, nothing here ever
+ *        allocates, which matters since Tiles multiply theirs every frame.
+ */
+template <unsigned int R, unsigned int C>
+class Matrix
+{
+private:
+
+    /*
+     * The values, row after row.
+     */
+    float m[R*C];
+
+public:
+
+    /**
+     * @brief Constructs a new Matrix. It's an identity matrix if square,
+     *        and all zeros otherwise.
+     */
+    Matrix()
+    {
+        for( unsigned int i = 0; i < R*C; ++i ) this->m[i] = 0.0f;
+        for( unsigned int i = 0; i < R && i < C; ++i ) this->m[ C*i + i ] = 1.0f;
+    }
+
+    /**
+     * @brief Returns an identity matrix (or as close as a non-square
+     *        one can get).
+     * @return A new identity Matrix.
+     */
+    static Matrix identity()
+    {
+        return Matrix();
+    }
+
+    /**
+     * @brief Returns a matrix that rotates about the origin in the XY plane,
+     *        counter-clockwise. Everything past the top left 2x2 is identity,
+     *        so a 3x3 one leaves translation alone.
+     * @param theta The angle to rotate by, in radians.
+     * @return A new rotation Matrix.
+     */
+    static Matrix rotation(float theta)
+    {
+        Matrix rot;
+        float c = cos(theta), s = sin(theta);
+        rot.m[0] =  c;  rot.m[1]   = -s;
+        rot.m[C] =  s;  rot.m[C+1] =  c;
+        return rot;
+    }
+
+    /**
+     * @brief Returns the number of rows (height) of this Matrix.
+     * @return The number of rows of this Matrix.
+     */
+    unsigned int getRows() const
+    {
+        return R;
+    }
+
+    /**
+     * @brief Returns the number of columns (width) of this Matrix.
+     * @return The number of columns of this Matrix.
+     */
+    unsigned int getColumns() const
+    {
+        return C;
+    }
+
+    /**
+     * @brief Returns a particular value of this Matrix.
+     * @param r The row of the item desired.
+     * @param c The column of the item desired.
+     * @return A particular value of the Matrix.
+     */
+    float get(unsigned int r, unsigned int c) const
+    {
+        return this->m[ r*C + c ];
+    }
+
+    /**
+     * @brief Sets a particular value of this Matrix.
+     * @param r The row of the item to set.
+     * @param c The column of the item to set.
+     * @param val The value to set it to.
+     */
+    void set(unsigned int r, unsigned int c, float val)
+    {
+        this->m[ r*C + c ] = val;
+    }
+
+    /**
+     * @brief Sets this Matrix' values to that of another.
+     * @param other The other Matrix.
+     */
+    void set(const Matrix & other)
+    {
+        for( unsigned int i = 0; i < R*C; ++i ) this->m[i] = other.m[i];
+    }
+
+    /**
+     * @brief Multiplies this Matrix by another one, in place. The right hand
+     *        side has to be square so that the result still fits.
+     * @param rhs The Matrix to be on the right hand side of the operation.
+     */
+    void multiplyBy(const Matrix<C,C> & rhs)
+    {
+        Matrix result;
+        multiply(*this, rhs, &result);
+        this->set(result);
+    }
+
+    /**
+     * @brief Returns a pointer to the underlying 1D array, row-major.
+     * @return A pointer to the underlying 1D array.
+     */
+    float * getLinear()
+    {
+        return this->m;
+    }
+
+    /**
+     * @brief Returns a pointer to the underlying 1D array, row-major.
+     * @return A pointer to the underlying 1D array.
+     */
+    const float * getLinear() const
+    {
+        return this->m;
+    }
+};
+
+/**
+ * @brief Multiplies two matrices together. The sizes are fixed, so the
+ *        compiler's free to unroll all of this.
+ * @param lhs The Matrix on the left hand side.
+ * @param rhs The Matrix on the right hand side.
+ * @param out Where to put the product. Can't be either of the other two.
+ */
+template <unsigned int R, unsigned int N, unsigned int C>
+inline void multiply(const Matrix<R,N> & lhs, const Matrix<N,C> & rhs, Matrix<R,C> * out)
+{
+    const float * a = lhs.getLinear();
+    const float * b = rhs.getLinear();
+    float * o = out->getLinear();
+    for( unsigned int r = 0; r < R; ++r )
+    {
+        for( unsigned int c = 0; c < C; ++c )
+        {
+            float sum = 0.0f;
+            for( unsigned int i = 0; i < N; ++i ) sum += a[ r*N + i ] * b[ i*C + c ];
+            o[ r*C + c ] = sum;
+        }
+    }
+}
+
+/**
+ * @brief Multiplies two 3x3 matrices together, written out by hand since
+ *        it's the one every Tile does every frame.
+ * @param lhs The Matrix on the left hand side.
+ * @param rhs The Matrix on the right hand side.
+ * @param out Where to put the product. Can't be either of the other two.
+ */
+inline void multiply(const Matrix<3,3> & lhs, const Matrix<3,3> & rhs, Matrix<3,3> * out)
+{
+    const float * a = lhs.getLinear();
+    const float * b = rhs.getLinear();
+    float * o = out->getLinear();
+    o[0] = a[0]*b[0] + a[1]*b[3] + a[2]*b[6];
+    o[1] = a[0]*b[1] + a[1]*b[4] + a[2]*b[7];
+    o[2] = a[0]*b[2] + a[1]*b[5] + a[2]*b[8];
+    o[3] = a[3]*b[0] + a[4]*b[3] + a[5]*b[6];
+    o[4] = a[3]*b[1] + a[4]*b[4] + a[5]*b[7];
+    o[5] = a[3]*b[2] + a[4]*b[5] + a[5]*b[8];
+    o[6] = a[6]*b[0] + a[7]*b[3] + a[8]*b[6];
+    o[7] = a[6]*b[1] + a[7]*b[4] + a[8]*b[7];
+    o[8] = a[6]*b[2] + a[7]*b[5] + a[8]*b[8];
+}
+
+/*
+ * What Tiles use for their transforms: 2D homogeneous coordinates.
+ */
+typedef Matrix<3,3> Matrix3;
+
+#endif // MATRIX_H
@@ -0,0 +1,78 @@
+#ifndef OCCLUSIONBUFFER_H
+#define OCCLUSIONBUFFER_H
+
+#include <cmath>
+
+// How many cells across and down the screen the buffer has. Small enough to
+// clear and fill every frame for next to nothing, big enough that a Tile
+// covering most of the screen covers most of the cells.
+#define OCCLUSION_COLS 64
+#define OCCLUSION_ROWS 40
+
+/**
+ * @class OcclusionBuffer
+ * @author Gerard Geer
+ * @date 06/22/16
+ * @file OcclusionBuffer.h
+ * @brief A coarse, conservative depth buffer over the screen, kept on the CPU.
+ *        Opaque Tiles are added as they're reached in drawing order, and
+ *        each only marks the cells it completely covers. Everything else is
+ *        tested against the cells it so much as touches, and is only hidden
+ *        if every one of them is covered by something strictly nearer. That
+ *        way nothing that could show through is ever skipped.
+ *
+ *        Coordinates are normalized screen coordinates, [-1,1] on both axes.
+ *        Depths are Tile depths, so smaller is nearer.
+ */
+class OcclusionBuffer
+{
+private:
+
+    /*
+     * The depth of the nearest occluder covering each cell, row by row.
+     */
+    float depth[OCCLUSION_ROWS * OCCLUSION_COLS];
+
+    /*
+     * Whether or not anything's been added since the last clear(), so that
+     * scenes without any occluders don't pay for the tests.
+     */
+    bool empty;
+
+public:
+
+    /**
+     * @brief Constructs a new, empty OcclusionBuffer.
+     */
+    OcclusionBuffer();
+
+    /**
+     * @brief Empties the buffer.
+     */
+    void clear();
+
+    /**
+     * @brief Marks the cells completely inside a rectangle as covered at the
+     *        given depth, unless they're already covered by something nearer.
+     * @param x0 The left edge of the rectangle.
+     * @param y0 The bottom edge of the rectangle.
+     * @param x1 The right edge of the rectangle.
+     * @param y1 The top edge of the rectangle.
+     * @param d The depth of the occluder.
+     */
+    void addOccluder(float x0, float y0, float x1, float y1, float d);
+
+    /**
+     * @brief Tests whether the on-screen part of a rectangle is completely
+     *        covered by occluders nearer than the given depth.
+     * @param x0 The left edge of the rectangle.
+     * @param y0 The bottom edge of the rectangle.
+     * @param x1 The right edge of the rectangle.
+     * @param y1 The top edge of the rectangle.
+     * @param d The depth of whatever the rectangle bounds.
+     * @return Whether or not it's hidden.
+     */
+    bool isOccluded(float x0, float y0, float x1, float y1, float d);
+};
+
+#endif // OCCLUSIONBUFFER_H
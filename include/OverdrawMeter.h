@@ -0,0 +1,215 @@
+#ifndef OVERDRAWMETER_H
+#define OVERDRAWMETER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include "GLStateCache.h"
+
+class Tile;
+class StaticChunk;
+
+// How many buckets the histogram has. Bucket i holds the pixels written i
+// times, except the last, which holds everything written that many times or
+// more.
+#define OVERDRAW_BUCKETS 16
+
+// How many of the draws that wrote the most pixels are kept track of.
+#define OVERDRAW_WORST_DRAWS 8
+
+/*
+ * Which pass a set of overdraw stats is for. OVERDRAW_TOTAL is both passes
+ * added together, pixel for pixel.
+ */
+enum overdraw_pass
+{
+    OVERDRAW_FWD,
+    OVERDRAW_DEF,
+    OVERDRAW_TOTAL,
+    NUM_OVERDRAW_PASSES
+};
+
+/*
+ * A single draw, and how many pixels it wrote. Either a Tile or a whole
+ * StaticChunk. These are only pointers, so don't hold on to them past
+ * removing whatever they point to.
+ */
+struct OverdrawDraw
+{
+    Tile * tile;
+    StaticChunk * chunk;
+    GLuint pixels;
+};
+
+/*
+ * How many times each pixel of a pass got written in a frame.
+ */
+struct OverdrawStats
+{
+    GLuint pixels;                           // Pixels in the framebuffer.
+    unsigned long fragments;                 // Fragments written, all told.
+    GLfloat mean;                            // Fragments per pixel.
+    GLuint max;                              // The most any one pixel got.
+    GLuint histogram[OVERDRAW_BUCKETS];      // Pixels by how often they got written.
+    OverdrawDraw worst[OVERDRAW_WORST_DRAWS]; // The draws that wrote the most, most first.
+    GLuint worstCount;                       // How many of those there are.
+};
+
+/**
+ * @class OverdrawMeter
+ * @author Gerard Geer
+ * @date 06/23/16
+ * @file OverdrawMeter.h
+ * @brief Measures how many times each pixel of the framebuffers gets written.
+ *        Integer attachments need GL 3, and swapping every Tile's fragment
+ *        output would mean knowing every custom shader, so instead each
+ *        fragment that survives the depth (and alpha) test bumps the
+ *        stencil buffer, and each draw is wrapped in an occlusion query to
+ *        find out how many pixels it wrote on its own. The stencil is read
+ *        back at the end of each pass and tallied on the CPU.
+ *
+ *        That stalls the pipeline a couple times a frame, so this is only
+ *        for finding out where the fill rate goes, not for shipping. The
+ *        framebuffers have to have stencil (see Framebuffer::hasStencil()),
+ *        and counts top out at 255.
+ */
+class OverdrawMeter
+{
+private:
+
+    /*
+     * The size of the framebuffers this frame.
+     */
+    GLuint width, height;
+
+    /*
+     * The occlusion queries, one per draw, reused every pass.
+     */
+    std::vector<GLuint> queries;
+
+    /*
+     * The draws this pass, in the order of their queries, and the draws
+     * from both passes this frame.
+     */
+    std::vector<OverdrawDraw> draws;
+    std::vector<OverdrawDraw> frameDraws;
+
+    /*
+     * The stencil buffer as read back, and both passes' counts added up.
+     */
+    std::vector<GLubyte> stencil;
+    std::vector<GLubyte> counts;
+
+    /*
+     * The texture the added up counts are uploaded to, and its size.
+     */
+    GLuint heatmap;
+    GLuint heatmapW, heatmapH;
+
+    /*
+     * The pass being measured.
+     */
+    overdraw_pass pass;
+
+    /*
+     * The stats from the last frame.
+     */
+    OverdrawStats stats[NUM_OVERDRAW_PASSES];
+
+    /**
+     * @brief Fills out a set of stats from per-pixel counts and the draws
+     *        that made them.
+     * @param counts How many times each pixel got written.
+     * @param draws The draws. These get sorted.
+     * @param s The stats to fill out.
+     */
+    static void tally(const std::vector<GLubyte> & counts,
+                      std::vector<OverdrawDraw> & draws, OverdrawStats * s);
+
+public:
+
+    /**
+     * @brief Constructs a new OverdrawMeter with empty stats.
+     */
+    OverdrawMeter();
+
+    /**
+     * @brief Destructs this OverdrawMeter. Call destroy() first.
+     */
+    ~OverdrawMeter();
+
+    /**
+     * @brief Returns whether or not the GL has what's needed to measure
+     *        overdraw: occlusion queries and packed depth-stencil.
+     * @return Whether or not overdraw can be measured.
+     */
+    static bool isSupported();
+
+    /**
+     * @brief Starts a frame.
+     * @param width The width of the framebuffers.
+     * @param height The height of the framebuffers.
+     */
+    void beginFrame(GLuint width, GLuint height);
+
+    /**
+     * @brief Clears the stencil of the current render target and starts
+     *        counting into it.
+     * @param pass Which pass this is.
+     */
+    void beginPass(overdraw_pass pass);
+
+    /**
+     * @brief Starts counting the pixels a single draw writes. Only one of
+     *        the two should be given.
+     * @param t The Tile being drawn, if it's a Tile.
+     * @param c The StaticChunk being drawn, if it's a StaticChunk.
+     */
+    void beginDraw(Tile * t, StaticChunk * c);
+
+    /**
+     * @brief Stops counting the pixels of the current draw.
+     */
+    void endDraw();
+
+    /**
+     * @brief Stops counting, reads back the stencil of the current render
+     *        target, and tallies the pass.
+     */
+    void endPass();
+
+    /**
+     * @brief Tallies both passes together and uploads the heatmap.
+     */
+    void endFrame();
+
+    /**
+     * @brief Returns the stats from the last frame.
+     * @param pass Which pass to get the stats of.
+     * @return The stats of that pass.
+     */
+    const OverdrawStats & getStats(overdraw_pass pass);
+
+    /**
+     * @brief Returns a texture of how many times each pixel got written last
+     *        frame, in both passes, as a fraction of 255. It's 0 until a
+     *        frame's been measured.
+     * @return The heatmap texture.
+     */
+    GLuint getHeatmap();
+
+    /**
+     * @brief Prints the stats from the last frame to stdout.
+     */
+    void report();
+
+    /**
+     * @brief Frees the queries and the heatmap.
+     */
+    void destroy();
+};
+
+#endif // OVERDRAWMETER_H
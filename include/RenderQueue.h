@@ -2,82 +2,635 @@
 #define RENDERQUEUE_H
 
 #include <vector>
-#include <valarray>
+#include <algorithm>
 #include <map>
+#include <string>
 #include "AssetManager.h"
 #include "Tile.h"
+#include "SpatialGrid.h"
+#include "CullKernel.h"
+#include "StaticChunk.h"
 
 /*
- * A type definition that links a Tile's ID with its index in the rendering queue.
+ * The packed 64-bit key each queued Tile is sorted by. From the most to the
+ * least significant bits it holds:
+ *     63:    Pass. (Forward Tiles before DefTiles.)
+ *     62:    Transparency. (Opaque Tiles before transparent ones.)
+ *     58-61: Plane, front to back for opaque Tiles, back to front otherwise.
+ *     48-57: Shader ID.
+ *     32-47: Texture ID. (Or TextureArray ID, if the Texture is in one.)
+ *     0-31:  Insertion sequence, so that no two keys are ever equal.
  */
-typedef std::pair<unsigned long, unsigned int> IdAndIndex;
+typedef unsigned long long SortKey;
 
+/*
+ * Widths of the interned render state IDs within a SortKey.
+ */
+#define SORT_KEY_SHADER_BITS 10
+#define SORT_KEY_TEXTURE_BITS 16
+
+/*
+ * The bits of a SortKey that hold the Shader and Texture IDs. Tiles whose
+ * keys match here share render state.
+ */
+#define SORT_KEY_STATE_MASK 0x03FFFFFF00000000ULL
+
+/*
+ * The index of the grid that holds Tiles that ignore scroll. (The others are
+ * indexed by plane.)
+ */
+#define SCREEN_SPACE_GRID NUM_PLANES
+
+/*
+ * What a slot's chunk member is set to when its Tile is static, but hasn't
+ * been put in a StaticChunk yet.
+ */
+#define CHUNK_PENDING -2
+
+/*
+ * Set on the entries of the visible list that are StaticChunks rather than
+ * slots. The rest of the entry is the chunk's index.
+ */
+#define VISIBLE_CHUNK_BIT 0x80000000u
+
+/*
+ * The most changed Tiles kept track of between frames. Past that, the whole
+ * screen is considered changed.
+ */
+#define QUEUE_MAX_DAMAGE 256
+
+/*
+ * How much of the screen has changed since the damage was last cleared.
+ */
+enum queue_damage
+{
+    DAMAGE_NONE,
+    DAMAGE_PARTIAL,
+    DAMAGE_ALL
+};
+
+/*
+ * Where a Tile was or is that needs redrawing: its bounds, in the space of
+ * its grid.
+ */
+struct DamageBox
+{
+    unsigned char view;
+    float x, y;
+    float hw, hh;
+};
+
+#if NUM_PLANES+1 > CULL_MAX_VIEWS
+    #error "The CullKernel doesn't have enough views for every plane."
+#endif
+
+/*
+ * A single slot of the RenderQueue's slot map.
+ */
+struct QueueSlot
+{
+    /*
+     * The Tile occupying the slot, and its type.
+     */
+    TileWithType tile;
+
+    /*
+     * The current generation of the slot. Bumped every time the slot is
+     * freed so that stale handles no longer match.
+     */
+    unsigned int generation;
+
+    /*
+     * Whether or not the slot is currently occupied.
+     */
+    bool alive;
+
+    /*
+     * The insertion sequence number of the Tile in this slot.
+     */
+    unsigned int seq;
+
+    /*
+     * The Shader and Texture keys the Tile had when its IDs were last
+     * interned, so that unchanged keys don't need to be looked up again.
+     */
+    const char * shaderKey;
+    const char * textureKey;
+
+    /*
+     * The interned IDs of the above keys.
+     */
+    unsigned int shaderID;
+    unsigned int textureID;
+
+    /*
+     * If the Tile's Texture has been copied into a TextureArray, the layer
+     * it's in. Otherwise -1.
+     */
+    GLint layer;
+
+    /*
+     * The Tile's SortKey as of the last time the queue was sorted.
+     */
+    SortKey key;
+
+    /*
+     * The grid the Tile is in (its plane, or SCREEN_SPACE_GRID), or -1 if
+     * it's in none, and the cells it covers there.
+     */
+    int grid;
+    CellRange cells;
+
+    /*
+     * The StaticChunk the Tile is baked into, CHUNK_PENDING if it's static
+     * but hasn't been put in one yet, or -1 if it isn't baked.
+     */
+    int chunk;
+
+    /*
+     * The last visibility query that gathered this slot, so that Tiles
+     * spanning several cells are only gathered once.
+     */
+    unsigned int visit;
+};
+
+/**
+ * @class RenderQueue
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file RenderQueue.h
+ * @brief Stores the Tiles waiting to be drawn. The Tiles themselves live in a
+ *        slot map so that they can be added and removed in constant time.
+ *        When the queue is traversed after having changed, each live Tile is
+ *        given a SortKey and the keys are radix sorted. This yields forward
+ *        Tiles before deferred ones, opaque Tiles from front to back, then
+ *        transparent Tiles from back to front, with Tiles on the same plane
+ *        grouped by Shader and Texture to keep state changes to a minimum.
+ */
 class RenderQueue
 {
 private:
 
     /*
-	 * The vector that we consider to be the queue.
+     * The number used to give each RenderQueue a unique ID.
+     */
+    static unsigned int nextID;
+
+    /*
+     * This RenderQueue's unique ID. Every handle it gives out carries it.
+     */
+    unsigned int id;
+
+    /*
+     * The slot map that stores the queued Tiles.
+     */
+    std::vector< QueueSlot > slots;
+
+    /*
+     * The indices of the slots that are free for reuse.
+     */
+    std::vector< unsigned int > freeSlots;
+
+    /*
+     * The sequence number to give the next Tile added.
+     */
+    unsigned int nextSeq;
+
+    /*
+     * Interning tables that map Shader and Texture keys to small IDs.
+     */
+    std::map< std::string, unsigned int > shaderIDs;
+    std::map< std::string, unsigned int > textureIDs;
+
+    /*
+     * The AssetManager used to find out which Textures live in
+     * TextureArrays. May be NULL.
+     */
+    AssetManager * assets;
+
+    /*
+     * The WorkerPool culling is split between. May be NULL.
+     */
+    WorkerPool * workers;
+
+    /*
+     * The sort keys and the slots they belong to, plus scratch space of the
+     * same size for the radix sort to ping-pong between.
+     */
+    std::vector< SortKey > keys;
+    std::vector< unsigned int > keySlots;
+    std::vector< SortKey > keyScratch;
+    std::vector< unsigned int > slotScratch;
+
+    /*
+	 * The sorted, drawing-order view of the live slots. This is only
+	 * rebuilt when something has changed since the last time it was read.
 	 */
     std::vector< TileWithType > queue;
-    
+
     /*
-	 * A map that maps Tile IDs to indices.
-	 */
-    std::map< unsigned long, unsigned int > memo;
-    
+     * Whether or not the slots have changed since queue was last rebuilt.
+     */
+    bool dirty;
+
+    /*
+     * A spatial grid of the queued Tiles for each plane, in that plane's
+     * parallax-scaled space, plus one for the Tiles that ignore scroll.
+     */
+    SpatialGrid grids[NUM_PLANES+1];
+
+    /*
+     * The version of the scroll coefficients the grids were built with.
+     */
+    unsigned int gridScrollVersion;
+
+    /*
+     * The number of the current visibility query.
+     */
+    unsigned int visit;
+
+    /*
+     * The bounds of the Tile in each slot, as a structure of arrays for the
+     * CullKernel. The view is the grid the Tile is in.
+     */
+    std::vector< float > boundsX;
+    std::vector< float > boundsY;
+    std::vector< float > boundsHW;
+    std::vector< float > boundsHH;
+    std::vector< unsigned char > boundsView;
+
+    /*
+     * The bounds of the Tiles the grids turned up, packed together for the
+     * CullKernel, and the indices of the ones it found on screen.
+     */
+    std::vector< float > packX;
+    std::vector< float > packY;
+    std::vector< unsigned short > packHW;
+    std::vector< unsigned short > packHH;
+    std::vector< unsigned char > packView;
+    std::vector< unsigned int > onScreen;
+
+    /*
+     * The StaticChunks static Tiles are baked into, the indices of the
+     * unused entries, and which chunk is where.
+     */
+    std::vector< StaticChunk* > chunks;
+    std::vector< unsigned int > freeChunks;
+    std::map< ChunkKey, unsigned int > chunkIDs;
+
+    /*
+     * The static slots waiting to be put into a StaticChunk. They wait until
+     * the queue is sorted, since the chunk they go in depends on their key.
+     */
+    std::vector< unsigned int > pendingChunks;
+
+    /*
+     * The view used by the last visibility query.
+     */
+    CullView view;
+
+    /*
+     * The slots the grids turned up, then the keys and slots of the ones
+     * that were gathered, in drawing order. Visible StaticChunks are in
+     * there too, marked with VISIBLE_CHUNK_BIT.
+     */
+    std::vector< unsigned int > candidates;
+    std::vector< SortKey > visibleKeys;
+    std::vector< unsigned int > visibleSlots;
+
+    /*
+     * Where Tiles were added, removed or changed since the damage was last
+     * cleared, or whether or not everything's changed.
+     */
+    std::vector< DamageBox > damaged;
+    bool damagedAll;
+
+    /**
+     * @brief Marks where a slot's Tile is, as of its bounds, as needing
+     *        redrawing.
+     * @param slot The slot.
+     */
+    void damage(unsigned int slot);
+
+    /**
+     * @brief Returns the interned ID of a key, adding it if need be.
+     * @param table The interning table to look in.
+     * @param key The key. NULL is always given ID zero.
+     * @return The interned ID of the key.
+     */
+    static unsigned int intern(std::map< std::string, unsigned int > & table, const char * key);
+
     /**
-     * @brief Memoizes or re-memoizes the rendering queue.
+     * @brief Computes the SortKey of the Tile in a slot.
+     * @param s The slot.
+     * @return The SortKey of the slot's Tile.
      */
-    void memoize();
-    
+    SortKey makeKey(QueueSlot & s);
+
+    /**
+     * @brief Sorts keys (and keySlots alongside) with an 8-bit LSD radix sort.
+     *        Passes where every key has the same digit are skipped.
+     */
+    void radixSort(std::vector< SortKey > & k, std::vector< unsigned int > & s);
+
+    /**
+     * @brief Works out which grid a Tile belongs in and which of its cells
+     *        the Tile covers.
+     * @param t The Tile.
+     * @param cells Where to put the cells it covers.
+     * @return The index of the grid.
+     */
+    static int locate(Tile * t, CellRange & cells);
+
+    /**
+     * @brief Copies the bounds of a slot's Tile into the bounds arrays.
+     * @param slot The slot.
+     */
+    void updateBounds(unsigned int slot);
+
+    /**
+     * @brief Returns whether or not a Tile gets baked into a StaticChunk.
+     *        Only static BGTiles and SceneTiles do.
+     * @param tile The Tile and its type.
+     * @return Whether or not it gets baked.
+     */
+    static bool bakes(const TileWithType & tile);
+
+    /**
+     * @brief Adds a slot's Tile to the grid it belongs in, or queues it up
+     *        to be baked if it's static.
+     * @param slot The slot.
+     */
+    void index(unsigned int slot);
+
+    /**
+     * @brief Removes a slot's Tile from whatever grid or StaticChunk it's in.
+     * @param slot The slot.
+     */
+    void unindex(unsigned int slot);
+
     /**
-     * @brief This is used as the predicate when sorting Tiles. It places opaque
-     *        from front to back, then transparent Tiles from back to front.
-     * @param lhs The left-hand-side Tile in the comparision.
-     * @param rhs The right-hand-size Tile in the comparison.
-     * @return Whether or not the first one is less than the second.
+     * @brief Puts every static slot waiting for a StaticChunk into the one
+     *        it belongs in, making it if need be. The keys must be current.
      */
-    static bool tileSortingPredicate(TileWithType lhs, TileWithType rhs);
-    
+    void placePending();
+
+    /**
+     * @brief Frees every StaticChunk.
+     */
+    void destroyChunks();
+
+    /**
+     * @brief Rebuilds every grid and StaticChunk from scratch. Needed when
+     *        the scroll coefficients change, since they scale each plane's
+     *        space.
+     */
+    void reindexAll();
+
+    /**
+     * @brief Places a Tile into a free slot.
+     * @param type The type of the Tile.
+     * @param tile The Tile.
+     * @return The handle to the Tile's new slot.
+     */
+    TileHandle insert(tile_type type, Tile * tile);
+
+    /**
+     * @brief Checks whether a handle refers to a live slot of this queue.
+     * @param handle The handle to check.
+     * @return Whether or not the handle is still valid.
+     */
+    bool isValid(TileHandle handle) const;
+
+    /**
+     * @brief Rebuilds and sorts the keys of every live slot if anything has
+     *        changed, then rebuilds the drawing-order queue from them. Freed
+     *        slots are simply skipped, so removals cost nothing extra here.
+     */
+    void flatten();
+
 public:
-    
+
+    /**
+     * @brief Constructs an empty RenderQueue.
+     */
+    RenderQueue();
+
+    /**
+     * @brief Returns the unique ID of this RenderQueue.
+     * @return The unique ID of this RenderQueue.
+     */
+    unsigned int getID() const;
+
     /**
      * @brief Adds a Tile to the render queue. Whatever is in the render
      *        queue when Renderer::render() is called will be rendered.
+     * @param type The type of the Tile being added.
      * @param tile The Tile to add to the render queue.
+     * @return A handle that can be used to remove the Tile in constant time.
      */
-    void addToRenderQueue(tile_type type, Tile * tile);
-    
+    TileHandle addToRenderQueue(tile_type type, Tile * tile);
+
+    /**
+     * @brief Adds many Tiles of the same type to the render queue in a
+     *        single pass.
+     * @param type The type of every Tile being added.
+     * @param tiles An array of the Tiles to add.
+     * @param n The number of Tiles in the array.
+     */
+    void addBatch(tile_type type, Tile ** tiles, unsigned int n);
+
+    /**
+     * @brief Removes a single Tile from the rendering queue by its handle.
+     *        This does not delete the Tile instance.
+     * @param handle The handle given when the Tile was added.
+     * @return Whether or not the Tile could be removed. If false, the handle
+     *         was stale or came from another RenderQueue.
+     */
+    bool removeFromRenderQueue(TileHandle handle);
+
     /**
-     * @brief Removes a single Tile from the sorted rendering queue. This does
+     * @brief Removes a single Tile from the rendering queue. This does
      *        not delete the Tile instance the pointer points to.
      * @param tile The Tile instance to remove.
      * @return Whether or not the Tile could be removed. If false, the Tile
      *         was not in the RenderQueue.
      */
     bool removeFromRenderQueue(Tile* tile);
-    
+
+    /**
+     * @brief Sets the AssetManager whose Textures the queued Tiles use.
+     *        Tiles whose Textures share a TextureArray are then given the
+     *        same texture ID, so that they sort (and batch) together.
+     * @param assets The AssetManager.
+     */
+    void setAssetManager(AssetManager * assets);
+
+    /**
+     * @brief Sets the WorkerPool to split culling between.
+     * @param workers The WorkerPool, or NULL to cull on the calling thread.
+     */
+    void setWorkerPool(WorkerPool * workers);
+
+    /**
+     * @brief Tells the queue that the plane, transparency, Shader or Texture
+     *        of one or more queued Tiles has changed, so it needs to re-sort
+     *        (and redraw everything).
+     */
+    void invalidate();
+
+    /**
+     * @brief Called by a queued Tile when it moves or changes size, so that
+     *        it can be moved to the right cells of its grid. Static Tiles
+     *        get rebaked instead.
+     * @param tile The Tile that changed.
+     * @param resort Whether or not the change affects its SortKey too.
+     */
+    void tileChanged(Tile * tile, bool resort);
+
+    /**
+     * @brief Like tileChanged(), but for a lot of Tiles that moved at once.
+     *        Tiles that aren't in this queue are ignored. If there are more
+     *        than the damage list can hold, everything's marked as needing
+     *        redrawing up front instead of one at a time.
+     * @param tiles The Tiles that changed.
+     * @param n How many there are.
+     */
+    void tilesChanged(Tile * const * tiles, unsigned int n);
+
+    /**
+     * @brief Gathers the on-screen Tiles, in drawing order. The grid cells
+     *        overlapping each plane's view (worked out with the plane's own
+     *        parallax factor) are looked in first, then what's in them is
+     *        tested against the screen by the CullKernel. StaticChunks are
+     *        tested as a whole and gathered in place of their Tiles.
+     * @param camX The X position of the Camera.
+     * @param camY The Y position of the Camera.
+     * @param offX The horizontal parallax offset of the Camera.
+     * @param offY The vertical parallax offset of the Camera.
+     */
+    void gatherVisible(GLfloat camX, GLfloat camY, GLfloat offX, GLfloat offY);
+
+    /**
+     * @brief Returns how many Tiles and StaticChunks the last
+     *        gatherVisible() turned up.
+     * @return How many Tiles and StaticChunks were gathered.
+     */
+    unsigned int visibleSize();
+
+    /**
+     * @brief Returns a Tile gathered by the last gatherVisible().
+     * @param index Its index, in drawing order.
+     * @return The Tile and its type. The Tile is NULL if a StaticChunk was
+     *         gathered there instead.
+     */
+    TileWithType getVisible(unsigned int index);
+
+    /**
+     * @brief Returns a StaticChunk gathered by the last gatherVisible().
+     * @param index Its index, in drawing order.
+     * @return The StaticChunk, or NULL if a Tile was gathered there instead.
+     */
+    StaticChunk * getVisibleChunk(unsigned int index);
+
+    /**
+     * @brief Returns the view used by the last gatherVisible(), for working
+     *        out where StaticChunks go on screen.
+     * @return The view used by the last gatherVisible().
+     */
+    const CullView & getView();
+
+    /**
+     * @brief Returns the SortKey of a Tile gathered by the last
+     *        gatherVisible().
+     * @param index Its index, in drawing order.
+     * @return Its SortKey.
+     */
+    SortKey getVisibleKey(unsigned int index);
+
+    /**
+     * @brief Returns the TextureArray layer of a Tile gathered by the last
+     *        gatherVisible().
+     * @param index Its index, in drawing order.
+     * @return The layer, or -1 if its Texture isn't in a TextureArray.
+     */
+    GLint getVisibleLayer(unsigned int index);
+
+    /**
+     * @brief Works out where the bounds of a Tile or StaticChunk gathered by
+     *        the last gatherVisible() end up on screen.
+     * @param index Its index, in drawing order.
+     * @param rect Where to put the left, bottom, right and top edges.
+     */
+    void getVisibleRect(unsigned int index, GLfloat * rect);
+
+    /**
+     * @brief Sorts the Tiles gathered by the last gatherVisible() by plane.
+     *        The Tiles of gathered StaticChunks are tested one by one
+     *        against the same view, so only the ones actually on screen make
+     *        it in.
+     * @param planes NUM_PLANES lists to add the Tiles to, one per plane.
+     */
+    void collectVisibleTiles(std::vector<Tile*> * planes);
+
+    /**
+     * @brief Works out how much of the screen the Tiles added, removed or
+     *        changed since the damage was last cleared cover, through the
+     *        view of the last gatherVisible(). Where they were before
+     *        changing counts as much as where they are now.
+     * @param rect Where to put the left, bottom, right and top edges of
+     *        all of it put together, when only part of the screen changed.
+     * @return How much of the screen changed.
+     */
+    queue_damage getDamage(GLfloat * rect);
+
+    /**
+     * @brief Marks the whole screen as needing redrawing. For changes the
+     *        queue can't see, like a Texture being reloaded.
+     */
+    void damageAll();
+
+    /**
+     * @brief Forgets about everything that's changed.
+     */
+    void clearDamage();
+
     /**
      * @brief Clears the rendering queue. Note that this doesn't destroy
      *        the Tiles within. It just simply clears out the line of Tiles
      *        waiting to get to be drawn.
      */
     void flush();
-    
+
     /**
     * @brief Returns the item at the specified index in the queue.
     * @param index The index to retrieve from.
 	* @return The item at the specified index in the queue.
     */
     TileWithType get(unsigned int index);
-    
+
+    /**
+     * @brief Returns the SortKey of the item at the specified index in the
+     *        queue.
+     * @param index The index to retrieve from.
+     * @return The SortKey of the item at the specified index.
+     */
+    SortKey getKey(unsigned int index);
+
+    /**
+     * @brief Returns the TextureArray layer of the Texture of the item at
+     *        the specified index in the queue.
+     * @param index The index to retrieve from.
+     * @return The layer, or -1 if the Texture isn't in a TextureArray.
+     */
+    GLint getLayer(unsigned int index);
+
     /**
 	 * @brief Returns the size of this RenderQueue.
 	 * @return The size of this RenderQueue.
 	 */
     unsigned int size();
-    
+
 };
 
 #endif // RENDERQUEUE_H
\ No newline at end of file
@@ -12,11 +12,28 @@
 #include "AnimTile.h"
 #include "DefTile.h"
 #include "FwdTile.h"
+#include "TileMapLayer.h"
 #include "Framebuffer.h"
 #include "RenderQueue.h"
+#include "StreamBuffer.h"
+#include "FrameBlock.h"
+#include "OcclusionBuffer.h"
+#include "OverdrawMeter.h"
+#include "WorkerPool.h"
 #include "Window.h"
 #include "shader_source.h"
 
+// The range of vertex attribute locations used for per-instance attributes.
+#define INSTANCE_ATTRIB_FIRST 2
+#define INSTANCE_ATTRIB_LAST 7
+
+// How many instances a frame's region of the instance stream starts out
+// with room for.
+#define INSTANCE_STREAM_SIZE 4096
+
+// The fewest Tiles a worker is given to fill in the instances of.
+#define INSTANCE_GRAIN 256
+
 // All of these classes include Renderer.h, and so in that
 // include, these classes aren't yet defined. Therefore we
 // make a forward declaration here.
@@ -26,6 +43,55 @@ class SceneTile;
 class AnimTile;
 class DefTile;
 class FwdTile;
+class TileMapLayer;
+
+/*
+ * A stock shader along with the handles of the uniforms the forward Tile
+ * types set every time they're drawn, so that they're only looked up the
+ * once.
+ */
+struct StockShader
+{
+    Shader * program;
+    UniformId transform;
+    UniformId depth;
+    UniformId texture;
+    UniformId hFlip;
+    UniformId vFlip;
+    UniformId fractFrameDim;
+    UniformId curFrame;
+    UniformId parallax;
+    UniformId plane;
+    UniformId cells;
+    UniformId mapSize;
+    UniformId tilesetSize;
+    UniformId texDim;
+    UniformId time;
+    UniformId frameCount;
+};
+
+/*
+ * A stock shader that does parallax scrolling itself, and the handles of
+ * the uniforms that takes.
+ */
+struct ScrollShader
+{
+    Shader * program;
+    UniformId camera;
+    UniformId scrollCoeffs;
+};
+
+/*
+ * An instanced stock shader, and its variant for Textures in a
+ * TextureArray. (Which has no program if texture arrays aren't supported.)
+ * The key is the one Tiles give from getInstanceShaderKey().
+ */
+struct InstanceShader
+{
+    const char * key;
+    StockShader plain;
+    StockShader array;
+};
 
 /**
  * @class Renderer
@@ -46,9 +112,10 @@ class FwdTile;
  *        -To begin, the renderer uses two framebuffer objects, so support of
  *         FBOs is essential.
  *        -First of all to draw a Tile you must add it to the render queue.
- *        -Second, the render queue is sorted with all opaque Tiles sorted from
- *         front to back, then all transparent Tiles are sorted from back to
- *         to front.
+ *        -Second, the render queue sorts the Tiles by plane and
+ *         transparency so that all opaque Tiles are drawn from front to
+ *         back, then all transparent Tiles are drawn from back to front.
+ *         Tiles on the same plane are grouped by Shader and Texture.
  *        -Next the BG-, Scene-, and AnimTiles are rendered into a first,
  *         forward framebuffer.
  *        -Then all of the DefTiles are rendered into a second, deferred
@@ -67,12 +134,32 @@ class FwdTile;
  *         alpha.
  *        
  *        How Tile rendering works:
+ *        -Each RenderQueue keeps a spatial grid of its Tiles for every plane.
+ *         Only the Tiles in the cells overlapping the view are gathered and
+ *         tested against the screen, so off-screen Tiles cost next to nothing.
+ *        -BGTiles and SceneTiles marked static are instead baked into
+ *         StaticChunks: vertex buffers holding all the static Tiles in a
+ *         patch of a plane that share a Texture. Each is drawn with one
+ *         glDrawArrays() call, and only rebaked when one of them changes.
+ *        -A TileMapLayer draws a whole grid of cells as one quad, looking up
+ *         each fragment's tile in an index texture, so big maps don't need a
+ *         Tile per cell.
  *        -Each Tile subclass overrides a pure virtual method from Tile: 
  *         render(). This method is passed a pointer to the calling Renderer
  *         instance.
- *        -The Tile sets all the uniforms and constructs the parallax 
- *         transformation matrix of itself, then calls glDrawArrays() on the
- *         common VAO for every Tile stored within the Renderer.
+ *        -The Tile sets all the uniforms, including its transformation
+ *         matrix in world space and its plane, then calls glDrawArrays() on
+ *         the common VAO for every Tile stored within the Renderer. The stock
+ *         shaders apply parallax themselves, from the camera and the parallax
+ *         factor of each plane, which are given to them once a frame.
+ *        -BGTiles and SceneTiles can instead be instanced. When the GL
+ *         supports it, consecutive on-screen Tiles that share a Shader and
+ *         Texture have their transforms gathered into an instance buffer,
+ *         and are drawn with a single glDrawArraysInstanced() call.
+ *        -If the AssetManager is told to use texture arrays before Textures
+ *         are loaded, same-sized Textures are also copied into layers of a
+ *         shared TextureArray, and instanced Tiles using any of them can
+ *         share a batch.
  */
 class Renderer
 {
@@ -80,6 +167,7 @@ friend class Window;
 friend class BGTile;
 friend class SceneTile;
 friend class AnimTile;
+friend class TileMapLayer;
 
 private:
 
@@ -117,6 +205,159 @@ private:
      */
     GLuint tileVAO;
     
+    /*
+     * The ring buffer that the per-instance attributes of instanced Tiles
+     * are streamed into.
+     */
+    StreamBuffer * instanceStream;
+    
+    /*
+     * The uniform buffer holding the camera, resolution and time, updated
+     * once at the start of each frame.
+     */
+    FrameBlock * frameBlock;
+    
+    /*
+     * Whether or not the GL supports instanced drawing, and whether or
+     * not we're actually using it.
+     */
+    bool instancingSupported;
+    bool instancing;
+    
+    /*
+     * The instances of the batch currently being gathered.
+     */
+    std::vector< TileInstance > instances;
+    
+    /*
+     * The instanced Shader and the Texture of the current batch, and the
+     * render state bits of the SortKey its Tiles share.
+     */
+    const char * batchShader;
+    const char * batchTexture;
+    SortKey batchState;
+    
+    /*
+     * The instanced stock shaders, and the one the current batch is drawn
+     * with.
+     */
+    std::vector< InstanceShader > instanceShaders;
+    InstanceShader * batchProgram;
+    
+    /*
+     * How many Tiles were drawn and culled, and how many draw calls were
+     * made, during the current frame.
+     */
+    unsigned int drawn;
+    unsigned int culled;
+    unsigned int drawCalls;
+    
+    /*
+     * The Tiles on each plane that were on screen in the last frame.
+     */
+    std::vector<Tile*> visibleTiles[NUM_PLANES];
+    
+    /*
+     * The coarse occlusion buffer, whether or not we're using it, and how
+     * many Tiles it hid this frame.
+     */
+    OcclusionBuffer occlusion;
+    bool occlusionCulling;
+    unsigned int occluded;
+    
+    /**
+     * @brief Returns whether or not a gathered Tile is sure to hide
+     *        everything behind its bounds: it's drawn by one of the stock
+     *        Tiles, it isn't rotated, and neither it nor its Texture has any
+     *        transparency.
+     * @param t The Tile and its type.
+     * @return Whether or not it can be added to the occlusion buffer.
+     */
+    bool occludes(const TileWithType & t);
+    
+    /*
+     * What measures overdraw, whether or not it's measuring, and whether
+     * or not the final pass shows its heatmap instead of the scene.
+     */
+    OverdrawMeter overdraw;
+    bool overdrawMode;
+    bool overdrawHeatmap;
+    
+    /*
+     * Whether or not only what's changed gets redrawn, where the Camera was
+     * last frame, and whether or not everything has to be redrawn anyway.
+     */
+    bool dirtyTracking;
+    GLfloat lastCamera[4];
+    bool redrawAll;
+    
+    /*
+     * The part of the screen being redrawn this pass, in pixels (x, y,
+     * width, height) and in the normalized screen coordinates Tiles' bounds
+     * are in, and how many pixels got redrawn this frame.
+     */
+    GLint scissor[4];
+    GLfloat scissorRect[4];
+    bool scissoring;
+    unsigned int redrawn;
+    
+    /**
+     * @brief Returns whether or not a Tile can look different from one
+     *        frame to the next without anything about it changing: an
+     *        AnimTile, or a Tile with a custom Shader that might use the
+     *        time.
+     * @param t The Tile and its type.
+     * @return Whether or not it has to be redrawn every frame.
+     */
+    bool animates(const TileWithType & t);
+    
+    /**
+     * @brief Gathers the on-screen Tiles of a RenderQueue.
+     * @param q The RenderQueue.
+     */
+    void gather(RenderQueue * q);
+    
+    /**
+     * @brief Works out what part of the current render target needs
+     *        redrawing, and clears it (and only it).
+     * @param q The RenderQueue of the pass. Its Tiles need to be gathered.
+     * @param full Whether or not to redraw the whole thing regardless.
+     * @return Whether or not anything needs redrawing.
+     */
+    bool beginPass(RenderQueue * q, bool full);
+    
+    /*
+     * The WorkerPool that culling and filling in instances are split
+     * between.
+     */
+    WorkerPool workers;
+    
+    /*
+     * The indices of the gathered Tiles that actually get drawn this pass,
+     * and for each, its instance and the Shader it's instanced with. (NULL
+     * if it isn't.)
+     */
+    std::vector< unsigned int > drawList;
+    std::vector< TileInstance > prepared;
+    std::vector< const char * > preparedShaders;
+    
+    /*
+     * The Tiles changed by the last updateTransforms(), to pass along to
+     * the queues.
+     */
+    std::vector< Tile * > changedTiles;
+    
+    /**
+     * @brief Fills in the instances of part of the draw list, for the
+     *        WorkerPool.
+     */
+    static void prepareInstances(void * job, unsigned int begin, unsigned int end, unsigned int part);
+    
+    /**
+     * @brief Puts things back after a pass that beginPass() said to draw.
+     */
+    void endPass();
+    
     /*
      * The Camera used for rendering.
      */
@@ -166,6 +407,14 @@ private:
      * Number of frames that have occurred.
      */
     unsigned long frameCount;
+    
+    /*
+     * The time and frame count the instances being drawn were filled in
+     * at. Instanced animations get their times relative to these, so the
+     * floats they're sent as stay small.
+     */
+    double instanceEpoch;
+    unsigned long instanceEpochFrame;
 
 
     /*
@@ -185,24 +434,111 @@ private:
      */
     void initStockShaders();
     
+    /*
+     * The stock shaders of the BGTile, SceneTile and AnimTile, with their
+     * uniforms already looked up.
+     */
+    StockShader bgShader;
+    StockShader sceneShader;
+    StockShader animShader;
+    
+    /*
+     * The shaders StaticChunks are drawn with, for plain Textures and for
+     * TextureArrays. (The latter has no program if texture arrays aren't
+     * supported.)
+     */
+    StockShader chunkShader;
+    StockShader chunkArrayShader;
+    
+    /*
+     * The shader TileMapLayers are drawn with.
+     */
+    StockShader mapShader;
+    
+    /*
+     * Every stock shader that does parallax scrolling itself, which need
+     * the camera and the parallax factor of each plane once a frame.
+     */
+    std::vector< ScrollShader > scrollShaders;
+    
+    /**
+     * @brief Looks up a stock shader and the handles of its uniforms.
+     * @param s The StockShader to fill in.
+     * @param key The key of the shader in the vital AssetManager.
+     */
+    void initStockShader(StockShader * s, const char * key);
+    
+    /**
+     * @brief Looks up an instanced stock shader and its texture array
+     *        variant, and adds them to the instanced shaders.
+     * @param key The key of the shader in the vital AssetManager.
+     */
+    void initInstanceShader(const char * key);
+    
+    /**
+     * @brief Finds an instanced stock shader by the key Tiles give for it.
+     * @param key The key.
+     * @return The InstanceShader, or NULL if there's no such one.
+     */
+    InstanceShader * getInstanceShader(const char * key);
+    
     /**
      * @brief Initializes the Tiles' VAO. (They all share the same geometry.
      */
     void initTileVAO();  
-
+    
     /**
-     * @brief Tests to see if a Tile is on screen for proactive culling.
-     * @param t A pointer to the Tile to test.
-     * @return Whether or not the Tile is on screen.
+     * @brief Checks for instanced drawing support, and if it's there,
+     *        attaches the instance buffer to the Tile VAO.
      */
-    bool onScreenTest(Tile * t);
+    void initInstancing();
     
+    /**
+     * @brief Points the per-instance attributes of the Tile VAO at the
+     *        instance stream.
+     * @param offset Where in the stream the first instance starts.
+     */
+    void setInstanceAttribs(GLintptr offset);
+
     /**
      * @brief Draws the finished framebuffer onto a full screen Tile and
      *        renders it to the screen.
      */
     void renderFinalPass(Window * window);
     
+    /**
+     * @brief Fills the FrameBlock with this frame's values and uploads it.
+     */
+    void updateFrameBlock(Window * window);
+    
+    /**
+     * @brief Gives the stock shaders that scroll the camera and the parallax
+     *        factor of each plane. Since that's all parallax needs, moving
+     *        the camera costs nothing per Tile.
+     */
+    void updateScrollUniforms();
+    
+    /**
+     * @brief Draws every Tile in the current batch with a single instanced
+     *        draw call, then empties the batch.
+     */
+    void flushInstances();
+    
+    /**
+     * @brief Draws a StaticChunk gathered from a RenderQueue.
+     * @param q The RenderQueue it was gathered from.
+     * @param c The StaticChunk to draw.
+     */
+    void renderChunk(RenderQueue * q, StaticChunk * c);
+    
+    /**
+     * @brief Draws all the on-screen Tiles of a RenderQueue. Runs of Tiles
+     *        that can be instanced and share a Shader and Texture are drawn
+     *        together, everything else is drawn one at a time.
+     * @param q The RenderQueue to draw.
+     */
+    void renderQueue(RenderQueue * q);
+    
     /**
      * @brief Destroys the Tile VAO. This is useful for when context switching.
      */
@@ -324,8 +660,19 @@ public:
      * @brief Adds a Tile to the render queue. Whatever is in the render
      *        queue when Renderer::render() is called will be rendered.
      * @param tile The Tile to add to the render queue.
+     * @return A handle that can be used to remove the Tile in constant time.
+     */
+    TileHandle addToRenderQueue(tile_type type, Tile * tile);
+    
+    /**
+     * @brief Adds many Tiles of the same type to the render queue at once.
+     *        This is much cheaper than adding them one by one when loading
+     *        a level.
+     * @param type The type of every Tile being added.
+     * @param tiles An array of the Tiles to add.
+     * @param n The number of Tiles in the array.
      */
-    void addToRenderQueue(tile_type type, Tile * tile);
+    void addBatch(tile_type type, Tile ** tiles, unsigned int n);
     
     /**
      * @brief Removes a single Tile from the sorted rendering queue. This does
@@ -336,6 +683,15 @@ public:
      */
     bool removeFromRenderQueue(Tile* tile);
     
+    /**
+     * @brief Removes a single Tile from the rendering queue by the handle it
+     *        was given when added. This does not delete the Tile instance.
+     * @param handle The handle returned by addToRenderQueue().
+     * @return Whether or not the Tile could be removed. If false, the handle
+     *         was stale.
+     */
+    bool removeFromRenderQueue(TileHandle handle);
+    
     /**
      * @brief Clears the rendering queue. Note that this doesn't destroy
      *        the Tiles within. It just simply clears out the line of Tiles
@@ -343,6 +699,166 @@ public:
      */
     void flushRenderQueue();
     
+    /**
+     * @brief Tells the rendering queue that the plane, transparency, Shader
+     *        or Texture of a queued Tile has changed and it needs to re-sort.
+     */
+    void invalidateRenderQueue();
+    
+    /**
+     * @brief Moves and rotates a lot of Tiles at once, straight from flat
+     *        arrays (like the ones a physics step fills in). The results
+     *        are exactly those of calling setX(), setY() and setRotation()
+     *        on each, since both use TileStore::sinCos(), but here the
+     *        rotations are worked out several at a time, and the render
+     *        queues are told about all of it together.
+     * @param refs The TileStore references of the Tiles. (See Tile::getRef().)
+     * @param xs The new X position of each Tile.
+     * @param ys The new Y position of each Tile.
+     * @param rots The new rotation of each Tile, or NULL to only move them.
+     * @param n How many Tiles there are.
+     */
+    void updateTransforms(const TileRef * refs, const float * xs, const float * ys,
+                          const float * rots, size_t n);
+    
+    /**
+     * @brief Sets whether or not to draw BGTiles and SceneTiles through the
+     *        instanced path. This is on by default when the GL supports it,
+     *        and can't be turned on when it doesn't.
+     * @param instancing Whether or not to use instanced drawing.
+     */
+    void setInstancing(bool instancing);
+    
+    /**
+     * @brief Returns whether or not instanced drawing is being used.
+     * @return Whether or not instanced drawing is being used.
+     */
+    bool usesInstancing();
+    
+    /**
+     * @brief Returns how many draw calls the Tiles of the last frame took.
+     * @return How many draw calls the Tiles of the last frame took.
+     */
+    unsigned int getDrawCalls();
+    
+    /**
+     * @brief Returns the Tiles on a plane that were on screen last frame,
+     *        as found by the Renderer's own culling. (Including static ones,
+     *        and ones that ignore scroll.) This is there so that game code
+     *        doesn't have to go looking for on-screen Tiles itself. Tiles
+     *        removed since the last frame are still in it, so don't hold on
+     *        to it past removing any.
+     * @param plane The plane.
+     * @return The Tiles on that plane that were on screen, in drawing order.
+     */
+    const std::vector<Tile*> & getVisibleTiles(tile_plane plane);
+    
+    /**
+     * @brief Sets whether or not to skip Tiles that are completely hidden
+     *        behind opaque Tiles on nearer planes. This is on by default.
+     * @param occlusionCulling Whether or not to do occlusion culling.
+     */
+    void setOcclusionCulling(bool occlusionCulling);
+    
+    /**
+     * @brief Returns whether or not occlusion culling is being done.
+     * @return Whether or not occlusion culling is being done.
+     */
+    bool usesOcclusionCulling();
+    
+    /**
+     * @brief Returns how many on-screen Tiles were skipped last frame because
+     *        opaque Tiles on nearer planes hid them.
+     * @return How many Tiles were occluded last frame.
+     */
+    unsigned int getOccludedCount();
+    
+    /**
+     * @brief Sets whether or not to measure how many times each pixel gets
+     *        written. While measuring, Tiles aren't instanced (so each can
+     *        be counted on its own) and every frame stalls to read the
+     *        counts back, so frame times aren't to be trusted. Everything
+     *        still draws the same, though, so it works just as well with a
+     *        hidden Window.
+     * @param overdrawMode Whether or not to measure overdraw.
+     * @return Whether or not overdraw is being measured now. It can't be
+     *         where the framebuffers couldn't get stencil.
+     */
+    bool setOverdrawMode(bool overdrawMode);
+    
+    /**
+     * @brief Returns whether or not overdraw is being measured.
+     * @return Whether or not overdraw is being measured.
+     */
+    bool usesOverdrawMode();
+    
+    /**
+     * @brief Sets whether or not the final pass shows a heatmap of how
+     *        many times each pixel got written instead of the scene, while
+     *        measuring overdraw. This is on by default.
+     * @param overdrawHeatmap Whether or not to show the heatmap.
+     */
+    void setOverdrawHeatmap(bool overdrawHeatmap);
+    
+    /**
+     * @brief Returns how many times each pixel got written last frame, as
+     *        of the last frame overdraw was measured.
+     * @param pass Which pass to get the stats of, or both.
+     * @return The overdraw stats of that pass.
+     */
+    const OverdrawStats & getOverdrawStats(overdraw_pass pass);
+    
+    /**
+     * @brief Sets whether or not to only redraw what's changed. When the
+     *        Camera hasn't moved, only the parts of the framebuffers that
+     *        queued Tiles were added to, removed from or changed in (plus
+     *        wherever AnimTiles, FwdTiles and DefTiles are) get redrawn, and
+     *        when nothing's changed the last frame's are reused outright.
+     *        The final pass is always drawn. This is off by default.
+     *
+     *        Changes have to go through Tiles' setters (or the queues) to be
+     *        noticed. For anything else, like reloading a Texture, call
+     *        invalidate().
+     * @param dirtyTracking Whether or not to only redraw what's changed.
+     */
+    void setDirtyTracking(bool dirtyTracking);
+    
+    /**
+     * @brief Returns whether or not only what's changed gets redrawn.
+     * @return Whether or not only what's changed gets redrawn.
+     */
+    bool usesDirtyTracking();
+    
+    /**
+     * @brief Makes the next frame redraw everything.
+     */
+    void invalidate();
+    
+    /**
+     * @brief Returns how many pixels of the framebuffers were redrawn last
+     *        frame, both passes together.
+     * @return How many pixels were redrawn last frame.
+     */
+    unsigned int getRedrawnPixels();
+    
+    /**
+     * @brief Sets how many threads culling and filling in instances are
+     *        split between, counting the one rendering. The rendering
+     *        thread is left with nothing to do but issue draw calls, and
+     *        everything is drawn in the same order as with one thread.
+     *        This is one by default.
+     * @param threads How many threads to use, up to WORKER_POOL_MAX_THREADS.
+     * @return Whether or not all of them could be started.
+     */
+    bool setWorkerThreads(unsigned int threads);
+    
+    /**
+     * @brief Returns how many threads culling and filling in instances are
+     *        split between.
+     * @return How many threads are used.
+     */
+    unsigned int getWorkerThreads();
+    
     /**
      * @brief Renders everything in the rendering queue.
      * @param window The Window instance being rendered to. This is needed
@@ -495,6 +1011,35 @@ public:
                             GLfloat height, bool normalize, const char * texA, const char * texB,
                             const char * texC, const char * texD, const char * shader);
     
+    /**
+     * @brief A factory method used to create a TileMapLayer, with every cell
+     *        empty. Make sure that the tileset's texture asset is loaded first.
+     * @param x The X position of this TileMapLayer.
+     * @param y The Y position of this TileMapLayer.
+     * @param plane The scrolling plane to render this TileMapLayer on.
+     * @param width The width of the whole map.
+     * @param height The height of the whole map.
+     * @param normalize Normally X, Y, width and height are in the range [-1,1]. This
+     *        parameter specifies whether or not to divide these by the framebuffer
+     *        resolution in order to have a 1:1 pixel ratio. This remaps X and Y
+     *        to be in the range [0, FBO resolution]. Note though, calls to Tile::set()
+     *        will still evaluate in the [-1,1] range.
+     * @param texture The key to the tileset's texture in the Renderer's AssetManager.
+     * @param tilesetCols The number of tiles across the tileset.
+     * @param tilesetRows The number of tiles down the tileset.
+     * @param cols The number of cells across the map.
+     * @param rows The number of cells down the map.
+     * @return A pointer to a freshly created TileMapLayer.
+     */
+    TileMapLayer * makeTileMapLayer(GLfloat x, GLfloat y, tile_plane plane, GLfloat width,
+                                    GLfloat height, bool normalize, char * texture,
+                                    GLuint tilesetCols, GLuint tilesetRows,
+                                    GLuint cols, GLuint rows);
+    TileMapLayer * makeTileMapLayer(GLfloat x, GLfloat y, tile_plane plane, GLfloat width,
+                                    GLfloat height, bool normalize, const char * texture,
+                                    GLuint tilesetCols, GLuint tilesetRows,
+                                    GLuint cols, GLuint rows);
+    
     /**
      * @brief Helper function.
      *        Returns the Tile's X position in the range [0, FBO horizontal resolution].
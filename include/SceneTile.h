@@ -5,7 +5,7 @@ class SceneTile;
 #include "Shader.h"
 #include "Tile.h"
 #include "Renderer.h"
-#include "BasicMatrix.h"
+#include "Matrix.h"
 
 /**
  * @class SceneTile
@@ -59,6 +59,24 @@ public:
      */
     char * getTexture();
     
+    /**
+     * @brief Returns the key of the Shader this SceneTile is drawn with.
+     * @return The key of the Shader this SceneTile is drawn with.
+     */
+    const char * getShaderKey();
+    
+    /**
+     * @brief Returns the key of the Texture this SceneTile is drawn with.
+     * @return The key of the Texture this SceneTile is drawn with.
+     */
+    const char * getTextureKey();
+    
+    /**
+     * @brief Returns the key of the Shader that draws SceneTiles instanced.
+     * @return The key of the Shader that draws SceneTiles instanced.
+     */
+    const char * getInstanceShaderKey();
+    
     /**
 	 * @brief Prints out info to stdout about this Tile.
 	 */
@@ -6,9 +6,11 @@
 #include <string>
 #include <cstring>
 #include <map>
+#include <vector>
 #include <stdlib.h>
 #include "Asset.h"
 #include "ShaderUniform.h"
+#include "FrameBlock.h"
 
 /*
  * Error codes:
@@ -32,6 +34,8 @@ enum shader_error{
  * @brief Ties up all the boiler plate with setting up Shaders. Simply pass a shader
  *        two filenames, and it will be set up entirely automatically. Just call 
  *        setUniform() to set the value of uniform variables, and use() to use it.
+ *        Uniforms that are set often should be looked up once with uniform(),
+ *        then set with set(), which skips the name lookup.
  *        This is meant to target GLSL 1.2, but any shader without fixed position
  *        uniforms should work. (E.g., any shader that declares uniforms in this way:
  *        "uniform <type> <identifier>;"
@@ -45,9 +49,20 @@ private:
     GLuint id;
     
     /*
-     * A list of uniforms that we can populate.
+     * A list of uniforms that we can populate, indexed by UniformId.
+     * Removed uniforms leave a NULL behind so that handles stay valid.
      */
-    std::map<std::string, ShaderUniform*> uniforms;
+    std::vector<ShaderUniform*> uniforms;
+    
+    /*
+     * Maps the names of the uniforms to their handles.
+     */
+    std::map<std::string, UniformId> uniformIDs;
+    
+    /*
+     * Whether or not this Shader declares the T2DFrame uniform block.
+     */
+    bool frameBlock;
     
     /**
      * @brief Returns a string telling us what type of shader we're working with.
@@ -79,6 +94,12 @@ private:
      */
     void scanLineForUniforms(char* line);
     
+    /**
+     * @brief Binds this Shader's T2DFrame uniform block to the binding point
+     *        of the Renderer's FrameBlock.
+     */
+    void bindFrameBlock();
+    
     /**
      * @brief Scans all of a source file for uniforms.
      * @param source The array of strings that make up the source flie.
@@ -158,6 +179,15 @@ public:
     void addUniform(char * name, uniform_type type);
     void addUniform(const char * name, uniform_type type);
     
+    /**
+     * @brief Adds an array uniform. It's set all at once, with the values
+     *        of every element one after the other.
+     * @param name The name of the uniform as found in the shader source.
+     * @param type The data type of each element.
+     * @param count How many elements the array has.
+     */
+    void addUniform(char * name, uniform_type type, unsigned int count);
+    
     /**
      * @brief Removes a uniform. Main use case? Uniform adding didn't go well
      *        (as told by glGetError()), and you want to remove that baggage.
@@ -178,6 +208,14 @@ public:
     bool hasUniform(char * name);
     bool hasUniform(const char * name);
     
+    /**
+     * @brief Returns whether or not this Shader gets its per-frame values
+     *        from the T2DFrame uniform block, rather than from individual
+     *        uniforms.
+     * @return Whether or not this Shader uses the T2DFrame uniform block.
+     */
+    bool usesFrameBlock();
+    
     /**
      * @brief Sets the value of a ShaderUniform, and as such the uniform it
      *        represents.
@@ -186,12 +224,32 @@ public:
      *             data appropriate for the datatype of the uniform. Is the
      *             uniform an int? data points to an int. Is it a vec3? data
      *             points to a 3 element array of floats. Mat4? 16 element
-     *             array of floats. Additionally, any errors this function
-     *             may generate will by caught by glGetError().
+     *             array of floats. Array uniforms (those declared as
+     *             "uniform <type> <identifier>[N];") are set all at once,
+     *             so data must hold all N values one after the other. (Even
+     *             for floats and ints. Passing a single value to an array
+     *             uniform reads past it.) Additionally, any errors this
+     *             function may generate will by caught by glGetError().
      */
     void setUniform(char * name, void * data);
     void setUniform(const char * name, void * data);
     
+    /**
+     * @brief Returns the handle of a uniform, for use with set().
+     * @param name The name of the uniform.
+     * @return The handle of the uniform, or NO_UNIFORM if this Shader
+     *         doesn't have it.
+     */
+    UniformId uniform(const char * name);
+    
+    /**
+     * @brief Sets the value of a uniform by its handle. Works just like
+     *        setUniform(), minus looking the uniform up by name.
+     * @param id The handle of the uniform, from uniform().
+     * @param data The data to be sent to the uniform.
+     */
+    void set(UniformId id, void * data);
+    
     /**
      * @brief Setting texture uniforms takes a bit more than the other types.
      *        This swaps to the desired texture unit, binds the texture, then
@@ -202,6 +260,7 @@ public:
      */
     void setTextureUniform(char * name, GLuint texID, GLuint texUnit);
     void setTextureUniform(const char * name, GLuint texID, GLuint texUnit);
+    void setTextureUniform(UniformId id, GLuint texID, GLuint texUnit);
     
     /**
      * @brief Returns the ID of this shader.
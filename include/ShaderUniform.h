@@ -4,6 +4,7 @@
 #include <cstring>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "GLStateCache.h"
 
 /**
  * @class uniform_type
@@ -25,6 +26,19 @@ enum uniform_type
     UNI_MAT4,   // 4x4 floating point matrix.
 };
 
+/*
+ * A handle to a uniform of a particular Shader, given out by
+ * Shader::uniform(). Handles are dense indices, so setting a uniform by
+ * handle doesn't involve looking anything up by name.
+ */
+typedef int UniformId;
+
+/*
+ * The handle given for uniforms a Shader doesn't have. Setting it does
+ * nothing.
+ */
+#define NO_UNIFORM -1
+
 /**
  * @class ShaderUniform
  * @author Gerard Geer
@@ -40,11 +54,38 @@ private:
      * This ShaderUniform's data type.
      */
     uniform_type type;
+    
+    /*
+     * How many values there are, if this uniform's an array. (One if not.)
+     */
+    unsigned int count;
+    
     /*
      * This uniform's location in the shader program.
      */
     GLint location;
     
+    /*
+     * A copy of the last value sent to the uniform, big enough for a mat4,
+     * and whether or not there is one yet. If the same value is set again
+     * we don't bother OpenGL with it.
+     */
+    GLfloat shadow[16];
+    bool hasShadow;
+    
+    /*
+     * How many glUniform*() calls have been made and skipped, across every
+     * ShaderUniform.
+     */
+    static unsigned long issuedCount;
+    static unsigned long skippedCount;
+    
+    /**
+     * @brief Returns how many bytes a value of this uniform's type takes up.
+     * @return How many bytes a value of this uniform's type takes up.
+     */
+    unsigned int getValueSize();
+    
 public:
     /*
      * Constructor. Doesn't do much.
@@ -73,6 +114,19 @@ public:
      */
     void init(GLuint program, uniform_type type, char * name);
     
+    /**
+     * @brief Locates an array uniform within the shader program. Setting it
+     *        sets every element at once, so the values should be passed in
+     *        one after the other, just like the components of a vector.
+     *        (Even for floats, ints and textures: data is then a pointer to
+     *        count values, not just one.)
+     * @param program The shader program identifier given to us by OpenGL.
+     * @param type The data type of each element.
+     * @param name The name of this uniform as found in the shader source.
+     * @param count How many elements the array has.
+     */
+    void init(GLuint program, uniform_type type, char * name, unsigned int count);
+    
     /**
      * @brief Assign a value to the uniform. This requires extra care.
      *        No matter what uniform type, pass a pointer to it that has been
@@ -80,11 +134,37 @@ public:
      *        back to the correct type.
      *        Additionally, the multiple values required by vector and
      *        matrix types must be passed in as a pointer to a 1D list of
-     *        values.
+     *        values. If this is an array uniform, data has to hold a value
+     *        for every element, one after the other.
      * @param data The data to be assigned to the uniform.
      */
     void set(void * data);
     
+    /**
+     * @brief Forgets the last value sent, so that the next set() always goes
+     *        through to OpenGL.
+     */
+    void forget();
+    
+    /**
+     * @brief Returns how many glUniform*() calls have been made since the
+     *        counts were last reset.
+     * @return How many glUniform*() calls have been made.
+     */
+    static unsigned long getIssuedCount();
+    
+    /**
+     * @brief Returns how many glUniform*() calls have been skipped because
+     *        the value hadn't changed, since the counts were last reset.
+     * @return How many glUniform*() calls have been skipped.
+     */
+    static unsigned long getSkippedCount();
+    
+    /**
+     * @brief Resets the issued and skipped counts.
+     */
+    static void resetCounts();
+    
 };
 
 #endif // SHADERUNIFORM_H
@@ -0,0 +1,112 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <vector>
+#include <map>
+#include <cmath>
+
+// The width and height of a grid cell. Coordinates are normalized, so the
+// screen is two units across and a cell is a quarter of it.
+#define GRID_CELL_SIZE 0.5f
+
+// Items that would cover more cells than this go in a list that's checked
+// every time instead. (Big backgrounds and the like.)
+#define GRID_MAX_CELLS 64
+
+/*
+ * An inclusive rectangle of grid cells.
+ */
+struct CellRange
+{
+    int x0, y0;
+    int x1, y1;
+};
+
+/**
+ * @class SpatialGrid
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file SpatialGrid.h
+ * @brief A uniform grid that buckets items (RenderQueue slot indices) by the
+ *        cells their bounds overlap. Only the cells that have something in
+ *        them are stored, so it can be as big as it needs to be. Querying a
+ *        rectangle only visits the cells it covers, so finding what's on
+ *        screen costs about as much as what's on screen, not what's in the
+ *        whole level.
+ */
+class SpatialGrid
+{
+private:
+
+    /*
+     * The non-empty cells, keyed by their packed coordinates.
+     */
+    std::map< unsigned long long, std::vector<unsigned int> > cells;
+    
+    /*
+     * The items too big to be worth bucketing.
+     */
+    std::vector<unsigned int> oversized;
+    
+    /**
+     * @brief Packs a pair of cell coordinates into a single key. Both are
+     *        packed as unsigned, since negative ones are just as common and
+     *        shifting a negative number is undefined.
+     */
+    static unsigned long long cellKey(int x, int y);
+    
+    /**
+     * @brief Removes an item from a list by swapping it with the last one.
+     * @return Whether or not it was found.
+     */
+    static bool removeFrom(std::vector<unsigned int> & list, unsigned int item);
+
+public:
+
+    /**
+     * @brief Returns the range of cells a rectangle overlaps.
+     * @param minX The left edge of the rectangle.
+     * @param minY The bottom edge of the rectangle.
+     * @param maxX The right edge of the rectangle.
+     * @param maxY The top edge of the rectangle.
+     * @return The range of cells the rectangle overlaps.
+     */
+    static CellRange getRange(float minX, float minY, float maxX, float maxY);
+    
+    /**
+     * @brief Returns whether or not a range covers too many cells to bucket.
+     */
+    static bool isOversized(const CellRange & r);
+    
+    /**
+     * @brief Adds an item to every cell in a range.
+     * @param item The item.
+     * @param r The range of cells it overlaps.
+     */
+    void insert(unsigned int item, const CellRange & r);
+    
+    /**
+     * @brief Removes an item from every cell in a range. The range must be
+     *        the same one it was inserted with.
+     * @param item The item.
+     * @param r The range of cells it was inserted into.
+     */
+    void remove(unsigned int item, const CellRange & r);
+    
+    /**
+     * @brief Appends every item in the cells of a range to a list, along
+     *        with every oversized item. Items that span several of the
+     *        cells show up once for each, so the caller needs to weed out
+     *        the duplicates.
+     * @param r The range of cells to look in.
+     * @param out The list to append to.
+     */
+    void query(const CellRange & r, std::vector<unsigned int> & out);
+    
+    /**
+     * @brief Empties the grid.
+     */
+    void clear();
+};
+
+#endif // SPATIALGRID_H
@@ -0,0 +1,201 @@
+#ifndef STATICCHUNK_H
+#define STATICCHUNK_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <cstddef>
+#include "Tile.h"
+#include "SpatialGrid.h"
+#include "CullKernel.h"
+#include "GLStateCache.h"
+
+// How many grid cells across (and down) the area a StaticChunk bakes is,
+// and how wide that is in the parallax-scaled space of its plane.
+#define STATIC_CHUNK_CELLS 16
+#define STATIC_CHUNK_SIZE (STATIC_CHUNK_CELLS * GRID_CELL_SIZE)
+
+/*
+ * What a StaticChunk holds: the render state bits of the SortKey its Tiles
+ * share, the view it's seen through (a plane, or screen space) and which
+ * chunk-sized square of that view the Tiles' centers fall in.
+ */
+struct ChunkKey
+{
+    unsigned long long state;
+    int view;
+    int x, y;
+
+    bool operator<(const ChunkKey & rhs) const
+    {
+        if( state != rhs.state ) return state < rhs.state;
+        if( view != rhs.view ) return view < rhs.view;
+        if( x != rhs.x ) return x < rhs.x;
+        return y < rhs.y;
+    }
+};
+
+/**
+ * @class StaticChunk
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file StaticChunk.h
+ * @brief A bunch of static Tiles baked into one vertex buffer, so that they
+ *        can be culled as one and drawn with a single draw call. The
+ *        RenderQueue groups static Tiles into these by plane, render state
+ *        and where they are. When one of them changes or is removed the
+ *        chunk is rebaked, but otherwise its buffer is left alone.
+ */
+class StaticChunk
+{
+private:
+
+    /*
+     * Where this chunk is and what it holds.
+     */
+    ChunkKey key;
+
+    /*
+     * The key of the Texture every Tile in here is drawn with. (Or of one
+     * of them, if they share a TextureArray.)
+     */
+    const char * textureKey;
+
+    /*
+     * The plane every Tile in here is on.
+     */
+    tile_plane plane;
+
+    /*
+     * The baked Tiles, and the TextureArray layer of each one's Texture.
+     */
+    std::vector< Tile* > tiles;
+    std::vector< GLint > layers;
+
+    /*
+     * The baked vertices.
+     */
+    std::vector< ChunkVertex > verts;
+
+    /*
+     * The bounds of every Tile in here, in the chunk's view. Like a Tile's,
+     * the center is in the view's parallax-scaled space, but the half
+     * extents aren't scaled.
+     */
+    GLfloat centerX, centerY;
+    GLfloat halfW, halfH;
+
+    /*
+     * Whether or not the Tiles have changed since the chunk was last baked,
+     * and whether or not the vertex buffer has caught up with the bake.
+     */
+    bool baked;
+    bool uploaded;
+
+    /*
+     * The vertex buffer and the VAO that reads from it.
+     */
+    GLuint vbo;
+    GLuint vao;
+
+    /**
+     * @brief Copies the baked vertices into the vertex buffer, creating it
+     *        first if need be.
+     */
+    void upload();
+
+public:
+
+    /**
+     * @brief Constructs an empty StaticChunk.
+     * @param key Where the chunk is and what it holds.
+     * @param textureKey The key of the Texture its Tiles are drawn with.
+     * @param plane The plane its Tiles are on.
+     */
+    StaticChunk(const ChunkKey & key, const char * textureKey, tile_plane plane);
+
+    /**
+     * @brief Destructs this StaticChunk. Call destroy() first.
+     */
+    ~StaticChunk();
+
+    /**
+     * @brief Adds a Tile to this chunk.
+     * @param tile The Tile.
+     * @param layer The TextureArray layer of its Texture, or -1.
+     */
+    void add(Tile * tile, GLint layer);
+
+    /**
+     * @brief Takes a Tile out of this chunk.
+     * @param tile The Tile.
+     * @return Whether or not it was in here.
+     */
+    bool remove(Tile * tile);
+
+    /**
+     * @brief Returns how many Tiles are in this chunk.
+     * @return How many Tiles are in this chunk.
+     */
+    unsigned int getTileCount();
+
+    /**
+     * @brief Returns one of the Tiles in this chunk.
+     * @param i Its index, less than getTileCount().
+     * @return The Tile.
+     */
+    Tile * getTile(unsigned int i);
+
+    /**
+     * @brief Rebakes the Tiles' vertices and bounds if they've changed since
+     *        the last time. This doesn't touch the GL.
+     */
+    void bake();
+
+    /**
+     * @brief Tests the chunk's bounds against the view. Make sure it's been
+     *        baked first.
+     * @param view The view, set up the same way the RenderQueue culls Tiles.
+     * @return Whether or not any of the chunk might be on screen.
+     */
+    bool onScreenTest(const CullView & view);
+
+    /**
+     * @brief Works out where the chunk's bounds end up on screen. Make sure
+     *        it's been baked first.
+     * @param view The view, set up the same way the RenderQueue culls Tiles.
+     * @param rect Where to put the left, bottom, right and top edges.
+     */
+    void getScreenRect(const CullView & view, GLfloat * rect);
+
+    /**
+     * @brief Draws every Tile in the chunk. The Shader and Texture must
+     *        already be set up. This leaves the chunk's VAO bound.
+     */
+    void draw();
+
+    /**
+     * @brief Returns where this chunk is and what it holds.
+     * @return Where this chunk is and what it holds.
+     */
+    const ChunkKey & getKey();
+
+    /**
+     * @brief Returns the key of the Texture this chunk is drawn with.
+     * @return The key of the Texture this chunk is drawn with.
+     */
+    const char * getTextureKey();
+
+    /**
+     * @brief Returns the plane this chunk's Tiles are on.
+     * @return The plane this chunk's Tiles are on.
+     */
+    tile_plane getPlane();
+
+    /**
+     * @brief Frees the vertex buffer and VAO.
+     */
+    void destroy();
+};
+
+#endif // STATICCHUNK_H
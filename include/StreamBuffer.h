@@ -0,0 +1,137 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <cstring>
+
+// How many frames' worth of regions the ring is split into. The CPU can
+// be writing one while the GPU is still reading the other two.
+#define STREAM_BUFFER_REGIONS 3
+
+/**
+ * @class StreamBuffer
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file StreamBuffer.h
+ * @brief A vertex buffer for data that's rewritten every frame, like the
+ *        per-instance attributes of instanced Tiles. Where ARB_buffer_storage
+ *        is supported it's a ring of regions in a single persistently mapped
+ *        buffer, so data is copied straight into memory the GPU reads from.
+ *        Each frame gets its own region, and a fence keeps us from writing
+ *        into a region the GPU hasn't finished with. Where it isn't
+ *        supported, the buffer is orphaned at the start of each frame and
+ *        written with glBufferSubData().
+ */
+class StreamBuffer
+{
+private:
+
+    /*
+     * The handle to the buffer object.
+     */
+    GLuint buffer;
+
+    /*
+     * Whether or not we're using a persistently mapped buffer.
+     */
+    bool persistent;
+
+    /*
+     * Where the buffer is mapped, if it's persistent.
+     */
+    GLubyte * mapped;
+
+    /*
+     * The size of each region, in bytes.
+     */
+    GLsizeiptr regionSize;
+
+    /*
+     * The region being written to this frame, and how far into the buffer
+     * we've written.
+     */
+    unsigned int region;
+    GLintptr offset;
+
+    /*
+     * A fence for each region, placed after the last frame that used it.
+     */
+    GLsync fences[STREAM_BUFFER_REGIONS];
+
+    /**
+     * @brief Creates the buffer with regions of the given size.
+     * @param regionSize The size of each region, in bytes.
+     */
+    void allocate(GLsizeiptr regionSize);
+
+    /**
+     * @brief Frees the buffer and any fences.
+     */
+    void release();
+
+    /**
+     * @brief Waits for the GPU to finish with a region, if it hasn't yet.
+     * @param region The region to wait on.
+     */
+    void waitForRegion(unsigned int region);
+
+public:
+
+    /**
+     * @brief Constructs a new StreamBuffer. Use init() to create it.
+     */
+    StreamBuffer();
+
+    /**
+     * @brief Destructs this StreamBuffer. Call destroy() first.
+     */
+    ~StreamBuffer();
+
+    /**
+     * @brief Creates the buffer, persistently mapped if possible.
+     * @param regionSize How many bytes a single frame is expected to need.
+     *        The buffer grows if a frame needs more.
+     */
+    void init(GLsizeiptr regionSize);
+
+    /**
+     * @brief Moves on to the next frame's region, waiting for the GPU to be
+     *        done with it if need be.
+     */
+    void beginFrame();
+
+    /**
+     * @brief Marks the end of the current frame's writes, so that its region
+     *        isn't reused until the GPU is done reading it.
+     */
+    void endFrame();
+
+    /**
+     * @brief Copies data into the current region.
+     * @param data The data to copy.
+     * @param size How many bytes to copy.
+     * @return The offset into the buffer the data was copied to.
+     */
+    GLintptr write(const void * data, GLsizeiptr size);
+
+    /**
+     * @brief Returns the handle to the underlying buffer object. This can
+     *        change when the buffer grows.
+     * @return The handle to the underlying buffer object.
+     */
+    GLuint getID();
+
+    /**
+     * @brief Returns whether or not the buffer is persistently mapped.
+     * @return Whether or not the buffer is persistently mapped.
+     */
+    bool isPersistent();
+
+    /**
+     * @brief Frees the buffer.
+     */
+    void destroy();
+};
+
+#endif // STREAMBUFFER_H
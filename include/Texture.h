@@ -5,8 +5,12 @@
 #include <fstream>
 #include <stdlib.h>
 #include <png.h>
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Asset.h"
+#include "GLStateCache.h"
+
+class TextureArray;
 
 /**
  * @class Texture
@@ -77,6 +81,13 @@ private:
      */
     bool alpha;
     
+    /*
+     * The TextureArray a copy of this texture was placed in, if any, and
+     * the layer it was placed in.
+     */
+    TextureArray * array;
+    GLint layer;
+    
     /**
      * @brief Loads the PNG file.
      * @param filename The filename of the PNG file to load.
@@ -151,6 +162,34 @@ public:
      */
     bool hasAlpha();
     
+    /**
+     * @brief Returns the OpenGL pixel format of this texture.
+     * @return GL_RGB or GL_RGBA.
+     */
+    GLenum getFormat();
+    
+    /**
+     * @brief Returns the TextureArray a copy of this texture lives in.
+     * @return The TextureArray a copy of this texture lives in, or NULL
+     *         if it isn't in one.
+     */
+    TextureArray * getArray();
+    
+    /**
+     * @brief Returns the layer of its TextureArray this texture was
+     *        copied into.
+     * @return The layer this texture was copied into, or -1.
+     */
+    GLint getLayer();
+    
+    /**
+     * @brief Records which TextureArray layer a copy of this texture was
+     *        placed in. This is done by the AssetManager.
+     * @param array The TextureArray.
+     * @param layer The layer.
+     */
+    void setArrayLayer(TextureArray * array, GLint layer);
+    
     /**
      * @brief Frees texture resources. Call this when the GPU will no
      * longer need this texture data.
@@ -0,0 +1,160 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <stdlib.h>
+#include <stdio.h>
+#include "Asset.h"
+#include "GLStateCache.h"
+
+// The number of layers a TextureArray starts out with. It doubles from
+// there as layers are added, up to what the GL allows.
+#define TEXTURE_ARRAY_INITIAL_LAYERS 4
+
+/**
+ * @class TextureArray
+ * @author Gerard Geer
+ * @date 06/13/16
+ * @file TextureArray.h
+ * @brief Encapsulates an OpenGL 2D texture array (EXT_texture_array) whose
+ *        layers all share the same dimensions and format. The AssetManager
+ *        copies Textures into these when asked to, so that Tiles with
+ *        different same-sized Textures can still be drawn in one batch.
+ */
+class TextureArray : public Asset
+{
+private:
+
+    /*
+     * The texture ID given to us by OpenGL.
+     */
+    GLuint texID;
+
+    /*
+     * The width and height of every layer.
+     */
+    GLuint width;
+    GLuint height;
+
+    /*
+     * The pixel format of every layer. (GL_RGB or GL_RGBA.)
+     */
+    GLenum format;
+
+    /*
+     * How many layers are in use, and how many there's currently room for.
+     */
+    GLuint layers;
+    GLuint capacity;
+
+    /*
+     * The most layers the GL lets a texture array have.
+     */
+    GLuint maxLayers;
+
+    /*
+     * A unique name for this TextureArray, so that Tiles whose Textures are
+     * in it can be grouped together.
+     */
+    char key[64];
+
+    /**
+     * @brief Returns how many bytes a single layer takes up.
+     * @return How many bytes a single layer takes up.
+     */
+    GLuint getLayerSize();
+
+    /**
+     * @brief (Re)creates the texture with room for the given number of
+     *        layers, and fills it with the given data.
+     * @param capacity The number of layers to make room for.
+     * @param data The pixels of the layers in use, or NULL if there are none.
+     */
+    void allocate(GLuint capacity, GLubyte * data);
+
+    /**
+     * @brief Doubles the number of layers there's room for, keeping what's
+     *        already in them.
+     */
+    void grow();
+
+public:
+
+    /**
+     * @brief Constructs a new TextureArray. Use init() to create it on the GPU.
+     */
+    TextureArray();
+
+    /**
+     * @brief Destructs this TextureArray. Call destroy() first.
+     */
+    ~TextureArray();
+
+    /**
+     * @brief Creates an empty texture array on the GPU.
+     * @param width The width of every layer.
+     * @param height The height of every layer.
+     * @param format The pixel format of every layer. (GL_RGB or GL_RGBA.)
+     * @param index A number unique to this TextureArray, used to name it.
+     */
+    void init(GLuint width, GLuint height, GLenum format, unsigned int index);
+
+    /**
+     * @brief Returns whether or not a texture of the given dimensions and
+     *        format could be added to this TextureArray.
+     * @param width The width of the texture.
+     * @param height The height of the texture.
+     * @param format The pixel format of the texture.
+     * @return Whether or not there's a free layer for it.
+     */
+    bool accepts(GLuint width, GLuint height, GLenum format);
+
+    /**
+     * @brief Copies the contents of a 2D texture into the next free layer.
+     *        The texture must have the same dimensions and format as this
+     *        TextureArray.
+     * @param sourceID The ID of the 2D texture to copy.
+     * @return The layer it was copied to, or -1 if there wasn't room.
+     */
+    GLint addLayer(GLuint sourceID);
+
+    /**
+     * @brief Returns the texture ID given to us by OpenGL. This can change
+     *        as layers are added.
+     * @return The texture ID given to us by OpenGL.
+     */
+    GLuint getID();
+
+    /**
+     * @brief Returns the width of every layer.
+     * @return The width of every layer.
+     */
+    GLuint getWidth();
+
+    /**
+     * @brief Returns the height of every layer.
+     * @return The height of every layer.
+     */
+    GLuint getHeight();
+
+    /**
+     * @brief Returns the number of layers in use.
+     * @return The number of layers in use.
+     */
+    GLuint getLayerCount();
+
+    /**
+     * @brief Returns the unique name of this TextureArray.
+     * @return The unique name of this TextureArray.
+     */
+    const char * getKey();
+
+    /**
+     * @brief Frees this TextureArray's GPU resources.
+     */
+    void destroy();
+};
+
+#endif // TEXTUREARRAY_H
@@ -6,15 +6,18 @@
 #include <map>
 #include <utility>
 
-#include "BasicMatrix.h"
+#include "Matrix.h"
+#include "TileStore.h"
 
-// Number of planes.
+// Number of planes. (The stock shaders get this too. glsl-to-header.py
+// splices it into them where they're compiled.)
 #define NUM_PLANES 10
 
 // Forward definitions of Tile and Renderer since these two
 // classes are interdependent.
 class Tile;
 class Renderer;
+class RenderQueue;
 
 /**
  * @class Tile
@@ -55,7 +58,8 @@ enum tile_type
     SCENE_TILE,
     ANIM_TILE,
     DEF_TILE,
-    FWD_TILE
+    FWD_TILE,
+    MAP_TILE
 };
 
 /*
@@ -63,65 +67,107 @@ enum tile_type
  */
 typedef std::pair<tile_type, Tile*> TileWithType; 
 
+/*
+ * A generational handle to a Tile's slot in a RenderQueue. The queue member
+ * identifies which RenderQueue issued the handle (zero meaning none did), and
+ * the generation is bumped each time the slot is freed, so handles to removed
+ * Tiles can be told apart from handles to whatever reuses their slot.
+ */
+struct TileHandle
+{
+    unsigned int queue;
+    unsigned int slot;
+    unsigned int generation;
+};
+
+/*
+ * The per-instance attributes of a Tile drawn through the instanced path.
+ * The two rows are the top two rows of the Tile's compound matrix, in world
+ * space. (The third is always 0,0,1.) Parallax is applied in the vertex
+ * shader, from the plane: NUM_PLANES if the Tile ignores scroll. The animation
+ * members are only used by AnimTiles, which let the vertex shader work out
+ * their current frame: anim holds the start of the animation, the duration
+ * and number of frames, and the frame shown at the start. frame holds the
+ * pixel dimensions of a frame and whether or not timing is by frame count.
+ * The layer is the TextureArray layer of the Tile's Texture, if it's in one.
+ */
+struct TileInstance
+{
+    GLfloat row0[3];
+    GLfloat row1[3];
+    GLfloat depth;
+    GLfloat hFlip;
+    GLfloat vFlip;
+    GLfloat plane;
+    GLfloat anim[4];
+    GLfloat frame[3];
+    GLfloat layer;
+};
+
+/*
+ * A vertex of a Tile baked into a StaticChunk. The position holds the
+ * Tile's center, which gets parallax applied in the vertex shader, and the
+ * corner's offset from it, which doesn't. (Just like how a lone Tile's size
+ * and rotation aren't affected by parallax.) The texture coordinate holds
+ * the TextureArray layer in its third component.
+ */
+struct ChunkVertex
+{
+    GLfloat pos[4];
+    GLfloat uv[3];
+};
+
 class Tile
 {
+// The RenderQueue stores the handle of its slot in the Tile so that it
+// can be removed by pointer without a search.
+friend class RenderQueue;
 private:
     
     /*
 	 * A mapping of plane scrolling coefficients.
 	 */
-    static float scrollCoeffs[10];
-    
-    /*
-     * The plane of this Tile.
-     */
-    tile_plane plane;
+    static float scrollCoeffs[NUM_PLANES];
     
     /*
-     * A BasicMatrix that stores this Tile's position and dimensions
-     * for easy and efficient shader uniform assignment.
+     * Bumped whenever a scrolling coefficient changes, so that anything
+     * that depends on them knows to catch up.
      */
-    BasicMatrix * pd;
+    static unsigned int scrollVersion;
     
     /*
-     * A BasicMatrix that stores the rotation to be applied to this
-     * Tile.
+     * Where every Tile's position, size, rotation, plane and flags live.
      */
-    BasicMatrix * r;
+    static TileStore store;
     
     /*
-     * A swap-space BasicMatrix so we can multiply without having to
-     * create objects that must be deleted outside of this class.
+     * This Tile's entry in the store.
      */
-    BasicMatrix * mult;
+    TileRef ref;
     
     /*
-     * Whether or not this Tile has any transparent regions.
+     * The ID of this Tile.
      */
-    bool trans;
+    unsigned long id;
     
     /*
-     * Does this Tile ignore scroll?
+     * The handle of the RenderQueue slot this Tile was last added to.
      */
-    bool ignoreScroll;
+    TileHandle queueHandle;
     
     /*
-     * A reference value for the current rotation, since it is not
-     * trivial to extract the value from the rotation matrix.
+     * The RenderQueue this Tile is in, if any, so that it can be told when
+     * the Tile moves.
      */
-    GLfloat rotation;
+    RenderQueue * queue;
     
-    /*
-     * How to flip the texture, if at all.
-     */
-    GLuint texFlip;
+protected:
     
-    /*
-     * The ID of this Tile. Used for memoization in the Renderer,
-     * so a single Tile can be removed from the sorted render queue
-     * with 0(1) look-up time.
+    /**
+     * @brief Lets the RenderQueue this Tile is in know that it changed.
+     * @param resort Whether or not the change affects its drawing order.
      */
-    unsigned long id;
+    void notifyQueue(bool resort);
     
 public:
     
@@ -149,18 +195,27 @@ public:
      */
     static GLfloat getTileDepth(tile_plane plane);
     
+    /**
+     * @brief Returns a number that changes whenever a scrolling coefficient
+     *        does.
+     * @return The current version of the scrolling coefficients.
+     */
+    static unsigned int getScrollVersion();
+    
     /**
      * @brief Constructs a new Tile instance.
      */
     Tile();
     
     /**
-     * @brief That BasicMatrix pointer is kind of heavy. This makes sure that it is deleted.
+     * @brief Destructs this Tile, giving up its entry in the TileStore if
+     *        destroy() didn't already. It's virtual so that Tiles can be
+     *        deleted through a Tile pointer.
      */
-    ~Tile();
+    virtual ~Tile();
     
     /**
-     * @brief Initializes this Tile's underlying BasicMatrix.
+     * @brief Initializes this Tile, giving it an entry in the TileStore.
      * @param x The X position of this new Tile.
      * @param y The Y position of this new Tile.
      * @param plane The plane that this Tile is to be rendered on.
@@ -180,16 +235,16 @@ public:
     bool operator<(const Tile &rhs) const
     {
         // We need to render transparent objects last.
-        if(trans && !rhs.hasTrans()) return false;
-        if(!trans && rhs.hasTrans()) return true;
+        if(hasTrans() && !rhs.hasTrans()) return false;
+        if(!hasTrans() && rhs.hasTrans()) return true;
         
         // At this point both operands will have the same transparency status.
         
         // Now we're comparing rendering planes. We want to
         // draw the closest Tiles first, so we can take
         // advantage of depth testing and thusly minimize redraw.
-        if(plane <= rhs.getPlane()) return true;
-        if(plane > rhs.getPlane()) return false;
+        if(getPlane() <= rhs.getPlane()) return true;
+        if(getPlane() > rhs.getPlane()) return false;
         return true; // Just to get rid of the warnings.
     }
         
@@ -235,6 +290,19 @@ public:
      */
     bool ignoresScroll() const;
     
+    /**
+     * @brief Returns the plane the stock shaders scroll this Tile by. It's
+     *        NUM_PLANES if this Tile ignores scrolling.
+     * @return The plane to scroll by, ready to hand to a shader.
+     */
+    GLfloat getScrollPlane() const;
+    
+    /**
+     * @brief Returns whether or not this Tile is static.
+     * @return Whether or not this Tile is static.
+     */
+    bool isStatic() const;
+    
     /**
      * @brief Returns the current texture flip mode. This is a bitwise
      *        member however, so you might get FLIP_VERT | FLIP_HORIZ.
@@ -250,23 +318,62 @@ public:
     GLfloat getRotation() const;
     
     /**
-     * @brief Returns a reference to the product of this Tile's position
-     *		  and rotation matrices.
-     * @return A reference to this Tile's underlying BasicMatrix.
+     * @brief Returns half the width of the smallest axis-aligned box that
+     *        fits around this Tile as it's drawn, rotation and all.
+     * @return Half the width of this Tile's rotated bounds.
      */
-    BasicMatrix * getCompoundMat();
+    GLfloat getBoundsHalfWidth() const;
     
     /**
-     * @brief Returns a reference to this Tile's position matrix.
-     * @return A reference to this Tile's underlying BasicMatrix.
+     * @brief Returns half the height of the smallest axis-aligned box that
+     *        fits around this Tile as it's drawn, rotation and all.
+     * @return Half the height of this Tile's rotated bounds.
      */
-    BasicMatrix * getPositionMat();
+    GLfloat getBoundsHalfHeight() const;
     
     /**
-     * @brief Returns a reference to this Tile's rotation matrix.
-     * @return A reference to this Tile's underlying BasicMatrix.
+     * @brief Returns the product of this Tile's position and rotation
+     *        matrices.
+     * @return This Tile's transform.
      */
-    BasicMatrix * getRotationMat();
+    Matrix3 getCompoundMat() const;
+    
+    /**
+     * @brief Returns the product of this Tile's position and rotation
+     *        matrices, as if it were somewhere else. This is how the
+     *        render() functions put a Tile where it lands on screen without
+     *        moving it.
+     * @param x The X position to use instead.
+     * @param y The Y position to use instead.
+     * @return This Tile's transform, moved.
+     */
+    Matrix3 getCompoundMat(GLfloat x, GLfloat y) const;
+    
+    /**
+     * @brief Returns this Tile's position matrix. It's built from the
+     *        store, so changing it doesn't change the Tile.
+     * @return This Tile's position matrix.
+     */
+    Matrix3 getPositionMat() const;
+    
+    /**
+     * @brief Returns this Tile's rotation matrix. It's built from the
+     *        store, so changing it doesn't change the Tile.
+     * @return This Tile's rotation matrix.
+     */
+    Matrix3 getRotationMat() const;
+    
+    /**
+     * @brief Returns the TileStore every Tile keeps its state in.
+     * @return The TileStore.
+     */
+    static TileStore * getStore();
+    
+    /**
+     * @brief Returns this Tile's entry in the TileStore.
+     * @return The reference to this Tile's entry.
+     */
+    TileRef getRef() const;
     
     /**
      * @brief Returns the unique ID of this Tile.
@@ -274,6 +381,14 @@ public:
      */
     unsigned long getID() const;
     
+    /**
+     * @brief Returns the handle this Tile was given when it was last added
+     *        to a RenderQueue. If it was never added, the handle's queue
+     *        member is zero.
+     * @return The handle this Tile was last given by a RenderQueue.
+     */
+    TileHandle getQueueHandle() const;
+    
     /**
 	 * Returns the current scrolling coefficient of a parallax plane.
 	 * @param The plane to query.
@@ -323,6 +438,17 @@ public:
      */
     void setIgnoreScroll(bool ignoreScroll);
     
+    /**
+     * @brief Marks this Tile as static, or not. Static BGTiles and SceneTiles
+     *        are baked into a vertex buffer along with the other static
+     *        Tiles near them that share their plane and Texture, and the
+     *        whole lot is drawn in one go. Changing a static Tile is allowed,
+     *        but means rebaking everything it was baked with, so only mark
+     *        Tiles that (almost) never change.
+     * @param isStatic Whether or not this Tile is static.
+     */
+    void setStatic(bool isStatic);
+    
     /**
      * @brief Sets the Tile's rotation.
      * @param rotation How far to rotate the Tile. (In radians)
@@ -350,14 +476,55 @@ public:
      */
     virtual void render(Renderer* r) = 0;
     
+    /**
+     * @brief Returns the AssetManager key of the Shader this Tile is drawn
+     *        with. The RenderQueue uses this to group Tiles that share
+     *        render state.
+     * @return The key of this Tile's Shader, or NULL if it has none.
+     */
+    virtual const char * getShaderKey();
+    
+    /**
+     * @brief Returns the AssetManager key of the (first) Texture this Tile
+     *        is drawn with. The RenderQueue uses this to group Tiles that
+     *        share render state.
+     * @return The key of this Tile's Texture, or NULL if it has none.
+     */
+    virtual const char * getTextureKey();
+    
+    /**
+     * @brief Returns the key of the stock Shader that draws many of this kind
+     *        of Tile in one instanced draw call. Tiles that can't be drawn
+     *        that way return NULL and are rendered one at a time.
+     * @return The key of this Tile's instanced Shader, or NULL.
+     */
+    virtual const char * getInstanceShaderKey();
+    
+    /**
+     * @brief Fills out the per-instance attributes of this Tile for the
+     *        instanced path. Like render(), it leaves parallax scrolling to
+     *        the vertex shader.
+     * @param r The Renderer drawing this Tile.
+     * @param inst The TileInstance to fill out.
+     */
+    virtual void fillInstance(Renderer * r, TileInstance * inst);
+    
+    /**
+     * @brief Fills out the six vertices of this Tile for baking into a
+     *        StaticChunk.
+     * @param layer The TextureArray layer of this Tile's Texture.
+     * @param verts Where to write the vertices.
+     */
+    void fillChunkVertices(GLfloat layer, ChunkVertex * verts);
+    
     /**
 	 * @brief Prints out info to stdout about this Tile.
 	 */
     virtual void report();
     
     /**
-     * @brief Destroys this Tile's underlying BasicMatrix. Call this before
-     * deletion and destruction.
+     * @brief Gives up this Tile's entry in the TileStore. Call this before
+     * deletion and destruction. (Calling it twice is harmless.)
      */
     void destroy();
 };
@@ -0,0 +1,201 @@
+#ifndef TILEMAPLAYER_H
+#define TILEMAPLAYER_H
+
+class TileMapLayer;
+#include <vector>
+#include <cstring>
+#include "Shader.h"
+#include "Tile.h"
+#include "Renderer.h"
+#include "Matrix.h"
+#include "GLStateCache.h"
+
+// The most cells a TileMapLayer can have across or down. (If the GL can't
+// make textures this big, it's however big the GL can make them.)
+#define TILE_MAP_MAX_CELLS 4096
+
+/**
+ * @class TileMapLayer
+ * @author Gerard Geer
+ * @date 06/20/16
+ * @file TileMapLayer.h
+ * @brief A TileMapLayer is a whole grid of same-sized cells, each showing a
+ *        tile from a tileset, drawn as a single Tile. Instead of a Tile per
+ *        cell, the cells are kept in an index texture that the stock shader
+ *        looks up per fragment, so drawing one costs the same no matter how
+ *        many cells it has. (Up to TILE_MAP_MAX_CELLS on a side.)
+ *
+ *        Each cell holds the index of the tile it shows. Index zero is an
+ *        empty cell, and index i is the (i-1)th tile of the tileset, counting
+ *        left to right and then top to bottom. Row zero of the map is at its
+ *        top.
+ *
+ *        Changed cells are uploaded the next time the layer is drawn, all in
+ *        one go, so editing a handful of cells each frame is cheap.
+ */
+class TileMapLayer : public Tile
+{
+private:
+
+    /*
+     * The key to the tileset's texture asset.
+     */
+    char * texture;
+
+    /*
+     * How many tiles are across and down the tileset.
+     */
+    GLuint tilesetCols;
+    GLuint tilesetRows;
+
+    /*
+     * How many cells are across and down the map.
+     */
+    GLuint cols;
+    GLuint rows;
+
+    /*
+     * The tile index of each cell, row by row.
+     */
+    std::vector<GLushort> cells;
+
+    /*
+     * The index texture the cells are mirrored to.
+     */
+    GLuint cellTex;
+
+    /*
+     * The rectangle of cells changed since the last upload, from (x0,y0) up
+     * to but not including (x1,y1). Empty when x0 >= x1.
+     */
+    GLuint dirtyX0, dirtyY0;
+    GLuint dirtyX1, dirtyY1;
+
+    /*
+     * Somewhere to pack the cells into bytes before they're uploaded.
+     */
+    std::vector<GLubyte> staging;
+
+    /**
+     * @brief Grows the dirty rectangle to cover the given cells.
+     * @param x The column of the leftmost cell.
+     * @param y The row of the topmost cell.
+     * @param w How many columns of cells.
+     * @param h How many rows of cells.
+     */
+    void markDirty(GLuint x, GLuint y, GLuint w, GLuint h);
+
+    /**
+     * @brief Uploads the dirty rectangle of cells, if there is one.
+     */
+    void upload();
+
+public:
+
+    /**
+     * @brief Constructs a new, uninitialized TileMapLayer.
+     */
+    TileMapLayer();
+
+    /**
+     * @brief Destructs this TileMapLayer. Call destroy() first.
+     */
+    ~TileMapLayer();
+
+    /**
+     * @brief Initializes this TileMapLayer, with every cell empty. This
+     *        creates its index texture, so there needs to be a GL context.
+     * @param x The X position of this TileMapLayer.
+     * @param y The Y position of this TileMapLayer.
+     * @param plane The scrolling plane that this TileMapLayer will be rendered on.
+     * @param width The width of the whole map.
+     * @param height The height of the whole map.
+     * @param trans Whether or not the tileset has transparency.
+     * @param texture The key to the tileset's texture asset.
+     * @param tilesetCols The number of tiles across the tileset.
+     * @param tilesetRows The number of tiles down the tileset.
+     * @param cols The number of cells across the map.
+     * @param rows The number of cells down the map.
+     */
+    void init(GLfloat x, GLfloat y, tile_plane plane, GLfloat width, GLfloat height,
+              bool trans, char * texture, GLuint tilesetCols, GLuint tilesetRows,
+              GLuint cols, GLuint rows);
+
+    /**
+     * @brief Sets the tile index of a single cell. Cells outside the map are
+     *        ignored.
+     * @param x The column of the cell.
+     * @param y The row of the cell.
+     * @param index The tile index. (0 for empty.)
+     */
+    void setCell(GLuint x, GLuint y, GLushort index);
+
+    /**
+     * @brief Sets the tile indices of a rectangle of cells. The part of the
+     *        rectangle outside the map is ignored.
+     * @param x The column of the leftmost cell.
+     * @param y The row of the topmost cell.
+     * @param w How many columns of cells.
+     * @param h How many rows of cells.
+     * @param indices w*h tile indices, row by row.
+     */
+    void setCells(GLuint x, GLuint y, GLuint w, GLuint h, const GLushort * indices);
+
+    /**
+     * @brief Returns the tile index of a cell.
+     * @param x The column of the cell.
+     * @param y The row of the cell.
+     * @return The tile index of the cell, or 0 if it's outside the map.
+     */
+    GLushort getCell(GLuint x, GLuint y);
+
+    /**
+     * @brief Returns the number of cells across the map.
+     * @return The number of cells across the map.
+     */
+    GLuint getColumns();
+
+    /**
+     * @brief Returns the number of cells down the map.
+     * @return The number of cells down the map.
+     */
+    GLuint getRows();
+
+    /**
+     * @brief Called by the Renderer to render this TileMapLayer.
+     * @param r A copy of the Renderer to give this TileMapLayer access to its
+     *        Camera and AssetManager.
+     */
+    void render(Renderer * r);
+
+    /**
+     * @brief Returns the key used to access the tileset's texture.
+     * @return The tileset's texture key.
+     */
+    char * getTexture();
+
+    /**
+     * @brief Returns the key of the Shader this TileMapLayer is drawn with.
+     * @return The key of the Shader this TileMapLayer is drawn with.
+     */
+    const char * getShaderKey();
+
+    /**
+     * @brief Returns the key of the Texture this TileMapLayer is drawn with.
+     * @return The key of the Texture this TileMapLayer is drawn with.
+     */
+    const char * getTextureKey();
+
+    /**
+     * @brief Frees the index texture, along with everything Tile::destroy()
+     *        frees. Call this before deletion and destruction.
+     */
+    void destroy();
+
+    /**
+     * @brief Prints a short description of this TileMapLayer.
+     */
+    void report();
+};
+
+#endif // TILEMAPLAYER_H
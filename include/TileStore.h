@@ -0,0 +1,256 @@
+#ifndef TILESTORE_H
+#define TILESTORE_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <cmath>
+#include "CullKernel.h"
+
+class Tile;
+
+/*
+ * The bits of a TileStore entry's flags.
+ */
+#define TILE_STORE_ALIVE 1
+#define TILE_STORE_TRANS 2
+#define TILE_STORE_IGNORE_SCROLL 4
+#define TILE_STORE_STATIC 8
+
+/*
+ * How many entries setTransforms() works out the sines and cosines of
+ * at a time. They're done with sinCos(), eight (or four) lanes at once.
+ */
+#define TILE_STORE_BATCH 64
+
+/*
+ * The biggest angle (either way) sinCos()'s polynomial is good for. Past
+ * this the range reduction loses too much, so it uses the standard library.
+ */
+#define TILE_STORE_SINCOS_MAX 8192.0f
+
+/*
+ * A generational reference to a Tile's entry in the TileStore. Like a
+ * TileHandle, the generation is bumped whenever the entry is freed, so a
+ * reference to a destroyed Tile never matches whatever reuses its entry.
+ * Generation zero is never handed out.
+ */
+struct TileRef
+{
+    unsigned int index;
+    unsigned int generation;
+};
+
+/**
+ * @class TileStore
+ * @author Gerard Geer
+ * @date 06/26/16
+ * @file TileStore.h
+ * @brief Where the state every Tile has actually lives: position, size,
+ *        rotation, plane, flags and texture flip. Each is kept in its own
+ *        array, one entry per Tile, so that going over a lot of Tiles only
+ *        pulls in the values being looked at instead of a whole Tile object
+ *        apiece. Tiles themselves just hold a TileRef into here, plus what
+ *        their subclass needs to draw them.
+ *
+ *        Each entry's transform (its size and rotation, multiplied out) and
+ *        the bounds the RenderQueue culls with are kept here too. Only the
+ *        setters that change them work them out again, so a Tile that
+ *        hasn't been resized or rotated costs nothing to transform, no
+ *        matter how many frames it's drawn.
+ *
+ *        There's one store for every Tile there is (see Tile::getStore()).
+ *        It isn't locked, so Tiles should only be made, changed and
+ *        destroyed on one thread. Reading from several is fine as long as
+ *        nobody's writing.
+ */
+class TileStore
+{
+private:
+
+    /*
+     * The columns. Entry i of each belongs to the same Tile.
+     */
+    std::vector<GLfloat> x;
+    std::vector<GLfloat> y;
+    std::vector<GLfloat> width;
+    std::vector<GLfloat> height;
+    std::vector<GLfloat> rotation;
+    std::vector<GLfloat> cosR;
+    std::vector<GLfloat> sinR;
+    std::vector<GLfloat> halfW;
+    std::vector<GLfloat> halfH;
+    std::vector<unsigned char> plane;
+    std::vector<unsigned char> flags;
+    std::vector<unsigned char> texFlip;
+
+    /*
+     * Each entry's size and rotation multiplied out: the top left 2x2 of
+     * its compound matrix, row by row, four to an entry. The position's
+     * left out, since where a Tile ends up on screen depends on the camera.
+     */
+    std::vector<GLfloat> linear;
+
+    /*
+     * The Tile each entry belongs to, and the current generation of each.
+     */
+    std::vector<Tile*> owner;
+    std::vector<unsigned int> generation;
+
+    /*
+     * The indices of the entries free for reuse, and how many aren't.
+     */
+    std::vector<unsigned int> freeEntries;
+    unsigned int live;
+
+    /**
+     * @brief Works out an entry's transform and the half width and height
+     *        of its rotated bounds again.
+     * @param i The entry.
+     */
+    void updateTransform(unsigned int i);
+
+    /*
+     * The sinCos() implementation in use, and whether or not it's been
+     * picked yet. These share the CullKernel's names for them.
+     */
+    static cull_path sinCosPath;
+    static bool sinCosDetected;
+
+    /**
+     * @brief The sinCos() implementations. Each does the angles from first
+     *        to n. Every lane of the vectorized ones does exactly the same
+     *        math as the plain one, so they all give the same bits back.
+     */
+    static void sinCosScalar(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t first, size_t n);
+    static size_t sinCosSSE2(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n);
+    static size_t sinCosAVX2(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n);
+
+public:
+
+    /**
+     * @brief Constructs an empty TileStore.
+     */
+    TileStore();
+
+    /**
+     * @brief Makes a new entry for a Tile. It starts out unrotated, opaque,
+     *        not static, unflipped, and scrolling.
+     * @param owner The Tile.
+     * @param x The X position of the Tile.
+     * @param y The Y position of the Tile.
+     * @param plane The plane of the Tile.
+     * @param width The width of the Tile.
+     * @param height The height of the Tile.
+     * @return A reference to the new entry.
+     */
+    TileRef create(Tile * owner, GLfloat x, GLfloat y, unsigned char plane,
+                   GLfloat width, GLfloat height);
+
+    /**
+     * @brief Frees an entry for reuse. Freeing a stale reference does
+     *        nothing.
+     * @param ref The reference to the entry.
+     */
+    void release(TileRef ref);
+
+    /**
+     * @brief Returns whether or not a reference is to a live entry.
+     * @param ref The reference.
+     * @return Whether or not it's still good.
+     */
+    bool isValid(TileRef ref) const;
+
+    /**
+     * @brief Returns how many entries there are, free ones included. Every
+     *        column is this long.
+     * @return How many entries there are.
+     */
+    unsigned int capacity() const;
+
+    /**
+     * @brief Returns how many entries are in use.
+     * @return How many entries are in use.
+     */
+    unsigned int size() const;
+
+    /**
+     * @brief Returns how many bytes each entry takes up, across all the
+     *        columns.
+     * @return The size of an entry.
+     */
+    static size_t getEntryBytes();
+
+    /**
+     * @brief Works out the sine and cosine of a whole array of angles. It's
+     *        a range-reduced polynomial, done eight angles at a time with
+     *        AVX2 or four with SSE2 if the CPU has them (and T2D_NO_SIMD
+     *        isn't defined), with the leftovers done one at a time. Every
+     *        rotation in the store goes through here, so they all agree.
+     * @param angles The angles, in radians.
+     * @param s Where to put the sines.
+     * @param c Where to put the cosines.
+     * @param n How many angles there are.
+     */
+    static void sinCos(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n);
+
+    /**
+     * @brief Returns the Tile an entry belongs to.
+     * @param i The index of the entry.
+     * @return Its Tile, or NULL if the entry's free.
+     */
+    Tile * getOwner(unsigned int i) const
+    {
+        return ( this->flags[i] & TILE_STORE_ALIVE ) ? this->owner[i] : NULL;
+    }
+
+    /*
+     * Reading an entry. These are called for every Tile, every frame, so
+     * they're here where they can be inlined.
+     */
+    GLfloat getX(unsigned int i) const        { return this->x[i]; }
+    GLfloat getY(unsigned int i) const        { return this->y[i]; }
+    GLfloat getWidth(unsigned int i) const    { return this->width[i]; }
+    GLfloat getHeight(unsigned int i) const   { return this->height[i]; }
+    GLfloat getRotation(unsigned int i) const { return this->rotation[i]; }
+    GLfloat getCos(unsigned int i) const      { return this->cosR[i]; }
+    GLfloat getSin(unsigned int i) const      { return this->sinR[i]; }
+    const GLfloat * getLinear(unsigned int i) const { return &this->linear[4*i]; }
+    GLfloat getHalfW(unsigned int i) const    { return this->halfW[i]; }
+    GLfloat getHalfH(unsigned int i) const    { return this->halfH[i]; }
+    unsigned char getPlane(unsigned int i) const   { return this->plane[i]; }
+    unsigned char getFlags(unsigned int i) const   { return this->flags[i]; }
+    unsigned char getTexFlip(unsigned int i) const { return this->texFlip[i]; }
+
+    /*
+     * Changing an entry. The ones that change its size or rotation keep its
+     * transform and bounds up to date.
+     */
+    void setX(unsigned int i, GLfloat x)               { this->x[i] = x; }
+    void setY(unsigned int i, GLfloat y)               { this->y[i] = y; }
+    void setPlane(unsigned int i, unsigned char plane) { this->plane[i] = plane; }
+    void setTexFlip(unsigned int i, unsigned char f)   { this->texFlip[i] = f; }
+    void setWidth(unsigned int i, GLfloat width);
+    void setHeight(unsigned int i, GLfloat height);
+    void setRotation(unsigned int i, GLfloat rotation);
+    void setFlag(unsigned int i, unsigned char flag, bool on);
+
+    /**
+     * @brief Moves (and maybe rotates) a lot of entries at once, straight
+     *        from arrays of new positions and rotations. The sines and
+     *        cosines are worked out TILE_STORE_BATCH at a time by sinCos()
+     *        before any of those entries are touched. The results are the
+     *        same as setX(), setY() and setRotation() on each.
+     * @param refs The references to the entries.
+     * @param xs The new X position of each.
+     * @param ys The new Y position of each.
+     * @param rots The new rotation of each, or NULL to leave them be.
+     * @param n How many entries there are.
+     * @param changed Where to put the Tile of each entry that was changed.
+     *        Needs room for n.
+     * @return How many entries were changed. Stale references are skipped.
+     */
+    unsigned int setTransforms(const TileRef * refs, const GLfloat * xs, const GLfloat * ys,
+                               const GLfloat * rots, size_t n, Tile ** changed);
+};
+
+#endif // TILESTORE_H
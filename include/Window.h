@@ -59,6 +59,11 @@ private:
      */
     bool fullscreen;
     
+    /*
+     * Whether or not the window is created hidden.
+     */
+    bool hidden;
+    
     /*
      * The current framecount.
      */
@@ -100,6 +105,15 @@ public:
      */
     ~Window();
     
+    /**
+     * @brief Sets whether or not the window is created hidden, for when
+     *        nobody's going to be looking at it (like when measuring things
+     *        on a build machine). Rendering goes on as usual. Call this
+     *        before create().
+     * @param hidden Whether or not to create the window hidden.
+     */
+    void setHidden(bool hidden);
+    
     /**
      * @brief Initializes GLFW and creates the window.
      * @param windowW Horizontal resolution of the window.
@@ -0,0 +1,123 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <pthread.h>
+
+// The most threads a WorkerPool can have, counting the one that runs jobs.
+#define WORKER_POOL_MAX_THREADS 8
+
+/*
+ * A job the WorkerPool splits up: it's called once for each part of the
+ * range [0, count), with the bounds of the part and which part it is.
+ */
+typedef void (*worker_job)(void * arg, unsigned int begin, unsigned int end, unsigned int part);
+
+/**
+ * @class WorkerPool
+ * @author Gerard Geer
+ * @date 06/24/16
+ * @file WorkerPool.h
+ * @brief A handful of threads that split a range of work between them. The
+ *        range is cut into contiguous parts, one per thread at most, and
+ *        the thread that calls run() does one of them itself before waiting
+ *        on the rest. Since part i always covers the range right before
+ *        part i+1, anything written out per part can be put back together
+ *        in order afterwards.
+ *
+ *        A pool of one thread (or one that hasn't been initialized) just
+ *        runs the whole range on the calling thread.
+ */
+class WorkerPool
+{
+private:
+
+    /*
+     * The threads, not counting the caller, and what they share with it.
+     * The lock guards running and everything about the current job.
+     */
+    pthread_t threads[WORKER_POOL_MAX_THREADS];
+    unsigned int threadCount;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    bool running;
+
+    /*
+     * The current job, how many parts it's in and how long each is, the
+     * next part nobody's started on, and how many parts aren't done.
+     */
+    worker_job job;
+    void * arg;
+    unsigned int count;
+    unsigned int parts;
+    unsigned int partSize;
+    unsigned int nextPart;
+    unsigned int remaining;
+
+    /**
+     * @brief The entry point of the threads.
+     * @param pool The WorkerPool that started the thread.
+     * @return NULL.
+     */
+    static void * work(void * pool);
+
+    /**
+     * @brief Does parts of the current job until there are none left.
+     *        Called (and returns) with the lock held.
+     */
+    void doParts();
+
+public:
+
+    /**
+     * @brief Constructs a new WorkerPool of one thread: the caller's.
+     */
+    WorkerPool();
+
+    /**
+     * @brief Destructs this WorkerPool. Call destroy() first.
+     */
+    ~WorkerPool();
+
+    /**
+     * @brief Starts the threads.
+     * @param threads How many threads to split work between, counting the
+     *        one that calls run(). At most WORKER_POOL_MAX_THREADS.
+     * @return Whether or not all of them could be started. If not, the pool
+     *         has however many could.
+     */
+    bool init(unsigned int threads);
+
+    /**
+     * @brief Returns how many threads work is split between, counting the
+     *        one that calls run().
+     * @return How many threads work is split between.
+     */
+    unsigned int getThreadCount();
+
+    /**
+     * @brief Splits a range into parts and runs a job on each, returning
+     *        once they're all done. Only call this from one thread at a time.
+     * @param job The job.
+     * @param arg What to pass the job.
+     * @param count How long the range is.
+     * @param grain The smallest a part can be. Parts are a multiple of this
+     *        long, except the last.
+     * @return How many parts it was split into.
+     */
+    unsigned int run(worker_job job, void * arg, unsigned int count, unsigned int grain);
+
+    /**
+     * @brief Returns where a part of the last job started.
+     * @param part The part.
+     * @return Where in the range it started.
+     */
+    unsigned int getPartBegin(unsigned int part);
+
+    /**
+     * @brief Stops the threads, leaving a pool of one.
+     */
+    void destroy();
+};
+
+#endif // WORKERPOOL_H
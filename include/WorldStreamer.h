@@ -0,0 +1,360 @@
+#ifndef WORLDSTREAMER_H
+#define WORLDSTREAMER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <pthread.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cstdlib>
+#include "Tile.h"
+#include "BGTile.h"
+#include "SceneTile.h"
+#include "Renderer.h"
+
+// What's at the start of every chunk file, and which version of the format
+// it's in.
+#define WORLD_CHUNK_MAGIC 0x43443254u
+#define WORLD_CHUNK_VERSION 1
+
+// The most worker threads a WorldStreamer can have.
+#define WORLD_STREAMER_MAX_WORKERS 8
+
+/*
+ * A Tile as it's stored in a chunk file. Only BGTiles and SceneTiles can be
+ * streamed. The texture is only a key; the Texture itself has to be in the
+ * Renderer's AssetManager by the time the chunk is streamed in.
+ */
+struct StreamedTile
+{
+    tile_type type;
+    tile_plane plane;
+    bool isStatic;
+    GLfloat x, y;
+    GLfloat width, height;
+    const char * texture;
+};
+
+/*
+ * Where a chunk is in its life.
+ */
+enum world_chunk_state
+{
+    WORLD_CHUNK_QUEUED,     // Waiting for a worker.
+    WORLD_CHUNK_LOADING,    // A worker's reading it.
+    WORLD_CHUNK_LOADED,     // Read, waiting to be put in the render queues.
+    WORLD_CHUNK_RESIDENT,   // Its Tiles are in the render queues.
+    WORLD_CHUNK_CANCELLED   // Not wanted anymore, but a worker still has it.
+};
+
+/*
+ * A single square of the world, from when it's requested until it's evicted.
+ */
+struct WorldChunk
+{
+    int x, y;
+    world_chunk_state state;
+
+    /*
+     * The Tiles read from its file, and the texture keys they point into.
+     */
+    std::vector<StreamedTile> records;
+    std::vector<char> keys;
+
+    /*
+     * The Tiles made from those, and their render queue handles.
+     */
+    std::vector<Tile*> tiles;
+    std::vector<TileHandle> handles;
+
+    /*
+     * How big those Tiles are, going by their types.
+     */
+    size_t tileBytes;
+
+    /*
+     * How far it is from where the Camera is (or is headed), in chunks.
+     * Nearer chunks are loaded first.
+     */
+    GLfloat priority;
+
+    /*
+     * When it was requested, so we know how long it took to show up.
+     */
+    double requested;
+};
+
+/**
+ * @class WorldStreamer
+ * @author Gerard Geer
+ * @date 06/21/16
+ * @file WorldStreamer.h
+ * @brief Streams a world too big to keep in memory as Tiles in and out of the
+ *        Renderer around its Camera. The world is cut into square chunks, each
+ *        stored in its own file (see writeWorld()). Worker threads read the
+ *        chunks within a radius of the Camera, plus the ones around where
+ *        it's headed, and update() puts them in the render queues and takes
+ *        far away ones back out. That's the only place Tiles are made or
+ *        destroyed, so call it once a frame, before rendering.
+ *
+ *        Chunks are picked by the Camera's position, so Tiles on planes that
+ *        scroll much slower or faster than the playfield should be stored
+ *        by where they'll appear, not where they are.
+ */
+class WorldStreamer
+{
+private:
+
+    /*
+     * The Renderer we feed Tiles to.
+     */
+    Renderer * renderer;
+
+    /*
+     * The directory the chunk files are in.
+     */
+    char directory[512];
+
+    /*
+     * The width and height of each chunk.
+     */
+    GLfloat chunkSize;
+
+    /*
+     * How many chunks out from the Camera's chunk are kept resident, and
+     * how many seconds ahead of the Camera we prefetch.
+     */
+    unsigned int radius;
+    GLfloat prefetchTime;
+
+    /*
+     * The most chunks put into the render queues in one update().
+     */
+    unsigned int insertBudget;
+
+    /*
+     * Where the Camera was at the last update(), and how fast it's going.
+     */
+    GLfloat lastX, lastY;
+    GLfloat velX, velY;
+    double lastTime;
+
+    /*
+     * Every chunk we know about, by position. Only touched by the main thread.
+     */
+    std::map< std::pair<int,int>, WorldChunk* > chunks;
+
+    /*
+     * The worker threads, and what they share with us. The lock guards the
+     * two lists below, running, and the state of every chunk.
+     */
+    pthread_t workers[WORLD_STREAMER_MAX_WORKERS];
+    unsigned int workerCount;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool running;
+
+    /*
+     * Chunks waiting to be read, with the most urgent at the back, and
+     * chunks that have been read.
+     */
+    std::vector<WorldChunk*> requests;
+    std::vector<WorldChunk*> loaded;
+
+    /*
+     * Stats.
+     */
+    unsigned int residentChunks;
+    unsigned int residentTiles;
+    size_t residentBytes;
+    unsigned int loadCount;
+    double totalLatency;
+    double maxLatency;
+
+    /**
+     * @brief The entry point of the worker threads.
+     * @param streamer The WorldStreamer that started the thread.
+     * @return NULL.
+     */
+    static void * work(void * streamer);
+
+    /**
+     * @brief Reads chunks until told to stop.
+     */
+    void workLoop();
+
+    /**
+     * @brief Reads a chunk's file. A missing file is an empty chunk.
+     * @param c The chunk to read.
+     */
+    void read(WorldChunk * c);
+
+    /**
+     * @brief Returns the path of a chunk's file.
+     * @param directory The directory the chunk files are in.
+     * @param x The X coordinate of the chunk.
+     * @param y The Y coordinate of the chunk.
+     * @param path Where to put the path.
+     * @param size How big that is.
+     */
+    static void chunkPath(const char * directory, int x, int y, char * path, size_t size);
+
+    /**
+     * @brief Makes the Tiles of a chunk that's been read and adds them to the
+     *        render queues.
+     * @param c The chunk.
+     * @param now The current time.
+     */
+    void insert(WorldChunk * c, double now);
+
+    /**
+     * @brief Takes a resident chunk's Tiles out of the render queues and
+     *        destroys them.
+     * @param c The chunk.
+     */
+    void evict(WorldChunk * c);
+
+    /**
+     * @brief Returns roughly how much memory a resident chunk takes up. That's
+     *        its Tiles (each its own size), their TileStore entries and
+     *        handles, and what's left of the records it was read from. What
+     *        the allocator and the render queues spend on top isn't counted.
+     * @param c The chunk.
+     * @return Roughly how many bytes it takes up.
+     */
+    static size_t chunkBytes(WorldChunk * c);
+
+public:
+
+    /**
+     * @brief Constructs a new WorldStreamer. Use init() to start it.
+     */
+    WorldStreamer();
+
+    /**
+     * @brief Destructs this WorldStreamer. Call destroy() first.
+     */
+    ~WorldStreamer();
+
+    /**
+     * @brief Starts the worker threads.
+     * @param r The Renderer to stream Tiles into.
+     * @param directory The directory the chunk files are in.
+     * @param chunkSize The width and height of each chunk. This has to match
+     *        what the world was written with.
+     * @param radius How many chunks out from the Camera's chunk to keep
+     *        resident.
+     * @param workers How many worker threads to read chunks with.
+     * @return Whether or not the workers could be started.
+     */
+    bool init(Renderer * r, const char * directory, GLfloat chunkSize,
+              unsigned int radius, unsigned int workers);
+
+    /**
+     * @brief Requests the chunks around the Camera, puts the ones that have
+     *        been read into the render queues, and evicts ones that are too
+     *        far away. Call this once a frame, before rendering.
+     */
+    void update();
+
+    /**
+     * @brief Sets how many chunks out from the Camera's chunk to keep
+     *        resident.
+     * @param radius The new radius, in chunks.
+     */
+    void setRadius(unsigned int radius);
+
+    /**
+     * @brief Sets how far ahead of the Camera to prefetch chunks.
+     * @param seconds How many seconds ahead of the Camera, at its current
+     *        velocity.
+     */
+    void setPrefetchTime(GLfloat seconds);
+
+    /**
+     * @brief Sets the most chunks that update() puts in the render queues at
+     *        once. The rest wait for the next frame, so that a burst of
+     *        loads doesn't make for one long frame.
+     * @param chunks The most chunks to insert per update().
+     */
+    void setInsertBudget(unsigned int chunks);
+
+    /**
+     * @brief Returns the number of chunks whose Tiles are in the render queues.
+     * @return The number of resident chunks.
+     */
+    unsigned int getResidentChunks();
+
+    /**
+     * @brief Returns the number of streamed Tiles in the render queues.
+     * @return The number of resident Tiles.
+     */
+    unsigned int getResidentTiles();
+
+    /**
+     * @brief Returns roughly how much memory the resident chunks take up.
+     * @return Roughly how many bytes the resident chunks take up.
+     */
+    size_t getResidentBytes();
+
+    /**
+     * @brief Returns the number of chunks requested but not yet resident.
+     * @return The number of chunks in flight.
+     */
+    unsigned int getPendingChunks();
+
+    /**
+     * @brief Returns the average time between a chunk being requested and
+     *        its Tiles being put in the render queues.
+     * @return The average load latency, in seconds.
+     */
+    double getAverageLatency();
+
+    /**
+     * @brief Returns the longest time between a chunk being requested and
+     *        its Tiles being put in the render queues.
+     * @return The worst load latency, in seconds.
+     */
+    double getMaxLatency();
+
+    /**
+     * @brief Prints the stats to stdout.
+     */
+    void report();
+
+    /**
+     * @brief Writes a single chunk's file.
+     * @param directory The directory to write it to.
+     * @param x The X coordinate of the chunk.
+     * @param y The Y coordinate of the chunk.
+     * @param tiles The chunk's Tiles.
+     * @param n How many Tiles there are.
+     * @return Whether or not it could be written.
+     */
+    static bool writeChunk(const char * directory, int x, int y,
+                           const StreamedTile * tiles, unsigned int n);
+
+    /**
+     * @brief Sorts a whole world's Tiles into chunks by their centers, and
+     *        writes each chunk's file.
+     * @param directory The directory to write them to.
+     * @param chunkSize The width and height of each chunk.
+     * @param tiles The world's Tiles.
+     * @param n How many Tiles there are.
+     * @return Whether or not they could all be written.
+     */
+    static bool writeWorld(const char * directory, GLfloat chunkSize,
+                           const StreamedTile * tiles, unsigned int n);
+
+    /**
+     * @brief Stops the workers, and evicts and frees every chunk.
+     */
+    void destroy();
+};
+
+#endif // WORLDSTREAMER_H
@@ -18,6 +18,8 @@
 #include "AnimTile.h"
 #include "DefTile.h"
 #include "FwdTile.h"
+#include "TileMapLayer.h"
+#include "WorldStreamer.h"
 #include "Texture.h"
 #include "Framebuffer.h"
 
@@ -22,27 +22,35 @@ usage:
     
 Note: It is highly recommended that you differ your vertex and fragment
 shaders by file extension alone, e.g., use .frag and .vert.
+
+Shaders can also pull in code they share with
+    #include "filename"
+(relative to the shader), and use the engine's own macros listed in
+ENGINE_MACROS below. Those are spliced in from the C++ side when the
+source is compiled, so they can never disagree with the engine.
 """	
 
 """
-Opens a given filename, and stores its contents as a #define macro
-within a returned String. This also gets rid of whitespace and
-documentation. If you're looking at this as the shader source instead
-of the shader source itself, you deserve to have a bad time. This also
-propends each line with a $ for easy newline replacement after strtok
-deletes them all.
+The C++ macros shaders are allowed to use. Each one is replaced with its
+value, stringified, wherever it appears in the shader source.
+"""
+ENGINE_MACROS = ["NUM_PLANES"]
+
+"""
+Reads the lines of source out of a given file, minus whitespace and
+documentation, with any files it #includes read in where they're
+included.
 
 Parameters:
-    name (String): The name of the directive.
-    file (String): The filepath of the file to #define-ify.
+    file (String): The filepath of the file to read.
     
 Returns:
-    The directive as a Python String.
+    The lines of source as a list of Python Strings.
 """
-def createDefineDirective(name, file):
+def readSourceLines(file):
 
-    # Start off the define macro.
-    result = "#define " + str(name) + " "
+    # Where what we've read goes.
+    lines = []
     
     # Open the file.
     f = open(file)
@@ -96,6 +104,45 @@ def createDefineDirective(name, file):
         if( len(line) == 0 ):
             continue
         
+        # GLSL 1.2 doesn't have #include, so we do it ourselves.
+        if( line.startswith('#include') ):
+            included = line[line.index('"')+1:line.rindex('"')]
+            lines += readSourceLines(os.path.join(os.path.dirname(file), included))
+            continue
+        
+        lines.append(line)
+    
+    f.close()
+    return lines
+    
+"""
+Opens a given filename, and stores its contents as a #define macro
+within a returned String. This also gets rid of whitespace and
+documentation. If you're looking at this as the shader source instead
+of the shader source itself, you deserve to have a bad time. This also
+propends each line with a $ for easy newline replacement after strtok
+deletes them all.
+
+Parameters:
+    name (String): The name of the directive.
+    file (String): The filepath of the file to #define-ify.
+    
+Returns:
+    The directive as a Python String.
+"""
+def createDefineDirective(name, file):
+
+    # Start off the define macro.
+    result = "#define " + str(name) + " "
+    
+    for line in readSourceLines(file):
+        
+        # Engine macros are closed out of the string, stringified, and
+        # the string picked back up again. The C++ compiler glues it all
+        # back together.
+        for macro in ENGINE_MACROS:
+            line = line.replace(macro, '" T2D_GLSL_XSTR(' + macro + ') "')
+        
         # Finally we append the line of source to the macro we're creating.
         # We encase in quotation, with a newline thrown in there at the end.
         # There's also a $ at the end of the line. Why? That's a character
@@ -185,6 +232,8 @@ def main():
     output = '// Shader source headerfile generated by glsl-to-header.py, written by Gerard Geer\n\n'
     output += '#ifndef '+guard+'\n'
     output += '#define '+guard+'\n\n'
+    output += '#define T2D_GLSL_STR(x) #x\n'
+    output += '#define T2D_GLSL_XSTR(x) T2D_GLSL_STR(x)\n\n'
     for filename in sys.argv[2:]:
         print('  -'+str(filename))
         output += createDefineDirective(filenameToMacroName(filename),filename)
@@ -24,9 +24,13 @@ uniform vec2 fractFrameDim;
 // The index of the current frame.
 uniform int curFrame;
 
-// The transformation matrix common to all the Tiles.
+// The transformation matrix common to all the Tiles. This puts the
+// AnimTile where it is in the world, before parallax scrolling.
 uniform mat3 transform;
 
+// The plane this Tile is on, or NUM_PLANES if it ignores scroll.
+uniform float plane;
+
 // The depth of this AnimTile.
 uniform float depth;
 
@@ -37,13 +41,18 @@ uniform int vFlip;
 // The texture coordinates we're going to send to the fragment stage.
 varying vec2 fragUV;
 
+// Parallax scrolling: the camera and scrollCoeffs uniforms, and scroll().
+#include "scroll.glsl"
+
 /**
  * The entrypoint into the shader.
  */
 void main(void)
 {
-    // First we do the usual setup of the vertex.
-    gl_Position = vec4( (transform*vertPos).xy, depth, 1.0 );
+    // First we do the usual setup of the vertex, scrolling its center.
+    vec2 center = transform[2].xy;
+    vec2 pos = (transform*vertPos).xy - center + scroll(center, plane);
+    gl_Position = vec4( pos, depth, 1.0 );
     
     // Now we do the texture coordinates.
     fragUV = vertUV * fractFrameDim;
@@ -0,0 +1,90 @@
+#version 120
+/**
+ * File: anim_tile_shader_inst.vert
+ * Author: Gerard Geer
+ * License: GPL v3.0
+ *
+ * This is the instanced version of the AnimTile vertex shader. Instead
+ * of being told which frame to show, each instance is given when its
+ * animation started, how long each frame lasts and how many frames there
+ * are, and works out the current frame from the time (or frame count)
+ * shared by the whole batch.
+ */
+ 
+// The VAO's idea of a vertex position. It's a pretty solid idea.
+attribute vec3 vertPos;
+
+// The VAO's interpretation of a texture coordinate. Also solid.
+attribute vec2 vertUV;
+
+// The top two rows of this instance's transformation matrix, placing it
+// where it is in the world.
+attribute vec3 instRow0;
+attribute vec3 instRow1;
+
+// The depth of this instance, followed by its horizontal and vertical
+// texture flip requests, then its plane. (NUM_PLANES if it ignores
+// scroll.)
+attribute vec4 instParams;
+
+// When the animation started (relative to the batch's epoch), how long
+// each frame lasts, how many frames there are, and which frame was shown
+// when it started.
+attribute vec4 instAnim;
+
+// The pixel dimensions of a single frame, and whether or not the
+// animation is timed by frame count rather than time.
+attribute vec3 instFrame;
+
+// The pixel dimensions of the whole texture.
+uniform vec2 texDim;
+
+// The time the current frame started, relative to the batch's epoch.
+uniform float time;
+
+// The number of frames drawn so far, relative to the batch's epoch.
+uniform float frameCount;
+
+// The layer of the texture array this instance's texture is in, if
+// its texture is in one.
+attribute float instLayer;
+
+// The texture coordinates we're going to send to the fragment stage.
+varying vec2 fragUV;
+
+// The texture array layer, passed along to the fragment stage.
+varying float fragLayer;
+
+// Parallax scrolling: the camera and scrollCoeffs uniforms, and scroll().
+#include "scroll.glsl"
+
+/**
+ * The entrypoint into the shader.
+ */
+void main(void)
+{
+    // First we do the usual setup of the vertex, scrolling its center.
+    vec2 center = vec2( instRow0.z, instRow1.z );
+    vec2 pos = vec2( dot(instRow0, vertPos), dot(instRow1, vertPos) ) - center;
+    gl_Position = vec4( pos + scroll(center, instParams.w), instParams.x, 1.0 );
+    
+    // Figure out which frame we're on.
+    float now = ( instFrame.z > 0.0 ) ? frameCount : time;
+    // (A frame time of zero means the frame never changes.)
+    float steps = ( instAnim.y > 0.0 ) ? floor( (now - instAnim.x) / instAnim.y ) : 0.0;
+    float curFrame = mod( instAnim.w + steps, instAnim.z );
+    
+    // Now we do the texture coordinates.
+    vec2 fractFrameDim = instFrame.xy / texDim;
+    fragUV = vertUV * fractFrameDim;
+    fragUV.x += fractFrameDim.x * curFrame;
+    
+    // Pass the texture array layer along.
+    fragLayer = instLayer;
+    
+    // If we've got horizontal flip, we need to flip.
+    if( instParams.y > 0.0 ) fragUV.x = 1.0-fragUV.x;
+    
+    // Do the same for vertical.
+    if( instParams.z > 0.0 ) fragUV.y = 1.0-fragUV.y;
+}
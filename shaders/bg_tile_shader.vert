@@ -16,10 +16,13 @@ attribute vec3 vertPos;
 attribute vec2 vertUV;
 
 // The transformation matrix. This scales the tile to the
-// appropriate size and moves it to the correct position. This
-// matrix also does parallax scrolling passively.
+// appropriate size and moves it to where it is in the world. Parallax
+// scrolling is applied on top of that, below.
 uniform mat3 transform;
 
+// The plane this Tile is on, or NUM_PLANES if it ignores scroll.
+uniform float plane;
+
 // The depth of this BGTile. Since it's a BGTile, this value will
 // always be the same.
 uniform float depth;
@@ -32,13 +35,20 @@ uniform int vFlip;
 // and passed to the fragment stage.
 varying vec2 fragUV;
 
+// Parallax scrolling: the camera and scrollCoeffs uniforms, and scroll().
+#include "scroll.glsl"
+
 /**
  * The entry point to this shader.
  */
 void main(void)
 {
-    // Transform the vertex position, casting it to the correct type.
-    gl_Position = vec4( transform*vertPos, 1.0 );
+    // Transform the vertex position, then scroll it. Only the center of
+    // the Tile gets scrolled; its size and rotation aren't affected by
+    // parallax.
+    vec2 center = transform[2].xy;
+    vec2 pos = (transform*vertPos).xy - center + scroll(center, plane);
+    gl_Position = vec4( pos, 0.0, 1.0 );
     
     // Now once we set the Z coordinate, we're done. Since the negative
     // Z axis goes into the screen, a Z coordinate <depth> away would be
@@ -0,0 +1,30 @@
+#version 120
+#extension GL_EXT_texture_array : require
+/**
+ * File: bg_tile_shader_array.frag
+ * Author: Gerard Geer
+ * License: GPL v3.0
+ *
+ * This is the fragment shader for instanced BGTiles whose textures have
+ * been copied into a texture array. It samples the layer it was told to
+ * by the vertex stage.
+ */
+
+// A sampler bound to the texture unit that we sent the texture
+// array to.
+uniform sampler2DArray texture;
+
+// The interpolated texture coordinate we get from the 
+// vertex shader.
+varying vec2 fragUV;
+
+// The layer of the texture array to sample.
+varying float fragLayer;
+
+/**
+ * The fragment shader entry point.
+ */
+void main(void)
+{
+    gl_FragColor = texture2DArray(texture, vec3(fragUV, fragLayer));
+}
@@ -0,0 +1,22 @@
+#version 120
+
+// Interpolated texture coordinates.
+varying vec2 fragUV;
+
+// How many times each pixel got written, over 255.
+uniform sampler2D counts;
+
+void main(void)
+{
+    float n = floor(texture2D(counts, fragUV).r * 255.0 + 0.5);
+
+    // Never written is black, once is blue, then green, yellow, red, and
+    // anything eight or more times over is white.
+    vec3 color;
+    if( n < 1.0 )      color = vec3(0.0);
+    else if( n < 2.0 ) color = vec3(0.0, 0.0, 1.0);
+    else if( n < 3.0 ) color = vec3(0.0, 1.0, 0.0);
+    else if( n < 4.0 ) color = vec3(1.0, 1.0, 0.0);
+    else               color = mix(vec3(1.0, 0.0, 0.0), vec3(1.0), clamp((n-4.0)/4.0, 0.0, 1.0));
+    gl_FragColor = vec4(color, 1.0);
+}
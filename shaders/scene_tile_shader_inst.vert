@@ -0,0 +1,65 @@
+#version 120
+/**
+ * File: scene_tile_shader_inst.vert
+ * Author: Gerard Geer
+ * License: GPL v3.0
+ *
+ * This is the instanced version of the stock SceneTile vertex shader. Rather
+ * than getting its transform, depth and texture flip from uniforms, it gets
+ * them from per-instance attributes, so that a whole run of SceneTiles sharing
+ * a texture can be drawn at once.
+ */
+
+// The vertex position taken from the VAO.
+attribute vec3 vertPos;
+
+// The vertex texture coorinate, also taken from the VAO.
+attribute vec2 vertUV;
+
+// The top two rows of this instance's transformation matrix, placing it
+// where it is in the world. The
+// bottom row is always (0, 0, 1), so there's no point sending it.
+attribute vec3 instRow0;
+attribute vec3 instRow1;
+
+// The depth of this instance, followed by its horizontal and vertical
+// texture flip requests, then its plane. (NUM_PLANES if it ignores
+// scroll.)
+attribute vec4 instParams;
+
+// The layer of the texture array this instance's texture is in, if
+// its texture is in one.
+attribute float instLayer;
+
+// The texture coordinate that we'll send off to get interpolated
+// and passed to the fragment stage.
+varying vec2 fragUV;
+
+// The texture array layer, passed along to the fragment stage.
+varying float fragLayer;
+
+// Parallax scrolling: the camera and scrollCoeffs uniforms, and scroll().
+#include "scroll.glsl"
+
+/**
+ * The entry point to this shader.
+ */
+void main(void)
+{
+    // Transform the vertex position, scroll its center, then set the depth.
+    vec2 center = vec2( instRow0.z, instRow1.z );
+    vec2 pos = vec2( dot(instRow0, vertPos), dot(instRow1, vertPos) ) - center;
+    gl_Position = vec4( pos + scroll(center, instParams.w), instParams.x, 1.0 );
+    
+    // Get the texture coordinate squared away.
+    fragUV = vertUV;
+    
+    // Pass the texture array layer along.
+    fragLayer = instLayer;
+    
+    // If we've got horizontal flip, we need to flip.
+    if( instParams.y > 0.0 ) fragUV.x = 1.0-fragUV.x;
+    
+    // Do the same for vertical.
+    if( instParams.z > 0.0 ) fragUV.y = 1.0-fragUV.y;
+}
@@ -0,0 +1,27 @@
+/**
+ * File: scroll.glsl
+ * Author: Gerard Geer
+ * License: GPL v3.0
+ *
+ * Parallax scrolling, shared by the stock tile vertex shaders. This isn't
+ * a shader on its own; glsl-to-header.py pastes it in wherever one
+ * #includes it, and fills in NUM_PLANES from Tile.h.
+ */
+
+// The camera's position, followed by its parallax offset.
+uniform vec4 camera;
+
+// The parallax factor of each plane.
+uniform float scrollCoeffs[NUM_PLANES];
+
+/**
+ * Applies parallax scrolling to a point in the world, for a Tile on the
+ * given plane. Tiles that ignore scroll have a plane past the last one,
+ * and stay put.
+ */
+vec2 scroll(vec2 p, float tilePlane)
+{
+    if( tilePlane > float(NUM_PLANES) - 0.5 ) return p;
+    float Fp = scrollCoeffs[int(tilePlane)];
+    return (p - camera.xy)*Fp - camera.zw*(1.0-Fp);
+}
@@ -0,0 +1,47 @@
+#version 120
+/**
+ * File: static_chunk_shader.vert
+ * Author: Gerard Geer
+ * License: GPL v3.0
+ *
+ * This is the vertex shader for StaticChunks, which hold a bunch of static
+ * BGTiles and SceneTiles baked into one vertex buffer. Each vertex knows the
+ * center of its Tile and its offset from it, so all that's left to do here
+ * is apply the chunk's parallax to the center.
+ */
+
+// The center of this vertex's Tile, followed by the vertex's offset from
+// that center. (Already scaled and rotated.)
+attribute vec4 vertPos;
+
+// The vertex texture coordinate, already flipped, followed by the texture
+// array layer of the Tile's texture, if it's in one.
+attribute vec3 vertUV;
+
+// The parallax factor of the chunk's plane, followed by the center of the
+// view in the plane's parallax-scaled space.
+uniform vec3 parallax;
+
+// The depth of the chunk's plane.
+uniform float depth;
+
+// The texture coordinate that we'll send off to get interpolated
+// and passed to the fragment stage.
+varying vec2 fragUV;
+
+// The texture array layer, passed along to the fragment stage.
+varying float fragLayer;
+
+/**
+ * The entry point to this shader.
+ */
+void main(void)
+{
+    // Scroll the center, but not the offset.
+    vec2 pos = vertPos.xy*parallax.x - parallax.yz + vertPos.zw;
+    gl_Position = vec4( pos, depth, 1.0 );
+    
+    // Pass the rest along.
+    fragUV = vertUV.xy;
+    fragLayer = vertUV.z;
+}
@@ -0,0 +1,51 @@
+#version 120
+/**
+ * File: tile_map_shader.frag
+ * Author: Gerard Geer
+ * License: GPL v3.0
+ *
+ * The fragment shader for TileMapLayers. Each fragment figures out which
+ * cell of the map it's in, looks up that cell's tile index, and samples
+ * that tile out of the tileset. This way the whole map is one quad, and
+ * costs the same to draw no matter how many cells it has.
+ */
+
+// The tileset, with its tiles laid out in a grid, left to right and then
+// top to bottom.
+uniform sampler2D texture;
+
+// The cells of the map, one texel each. Each index is 16 bits, split into
+// a low byte in the luminance channel and a high byte in alpha, since
+// GLSL 1.20 doesn't have integer textures.
+uniform sampler2D cells;
+
+// The number of cells across and down the map.
+uniform vec2 mapSize;
+
+// The number of tiles across and down the tileset.
+uniform vec2 tilesetSize;
+
+// The interpolated texture coordinate we get from the vertex shader.
+varying vec2 fragUV;
+
+/**
+ * The fragment shader entry point.
+ */
+void main(void)
+{
+    // Find the cell we're in, and where in it we are.
+    vec2 cell = fragUV*mapSize;
+    vec2 cellIndex = min(floor(cell), mapSize-1.0);
+    
+    // Put the index back together from its two bytes.
+    vec4 texel = texture2D(cells, (cellIndex+0.5)/mapSize);
+    float index = floor(texel.r*255.0+0.5) + 256.0*floor(texel.a*255.0+0.5);
+    
+    // Index zero is an empty cell.
+    if( index < 0.5 ) discard;
+    index -= 1.0;
+    
+    // Find the tile in the tileset and sample it.
+    vec2 tile = vec2( mod(index, tilesetSize.x), floor(index/tilesetSize.x) );
+    gl_FragColor = texture2D(texture, (tile+fract(cell))/tilesetSize);
+}
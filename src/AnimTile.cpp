@@ -25,17 +25,33 @@ void AnimTile::init(GLfloat x, GLfloat y, tile_plane plane, GLfloat width,
     this->lastChange =0.0;
     this->frameBased = frameBased;
     this->texture = texture;
+    this->animStart = -1.0;
+    this->startFrame = 0;
+    this->lastSeen = 0.0;
+}
+
+void AnimTile::syncFrame()
+{
+    this->curFrame = this->getCurFrame();
+    this->animStart = -1.0;
 }
 
 void AnimTile::render(Renderer* r)
 {
+    // If we were last drawn instanced, pick up where the shader left off.
+    if( this->animStart >= 0.0 ) this->syncFrame();
         
     // First things first: Let's make sure we're drawing the correct frame.
-    if( this->frameBased )
+    // (A frame time of zero means the frame never changes.)
+    if( this->frameTime <= 0.0f )
+    {
+        // Nothing to step.
+    }
+    else if( this->frameBased )
     {
         unsigned long t = this->frameTime;
         unsigned long c = r->getFrameCount();
-        if( c % t == 0 )
+        if( t != 0 && c % t == 0 )
         {
             this->curFrame = (this->curFrame + 1)%this->numFrames;
         }
@@ -50,61 +66,41 @@ void AnimTile::render(Renderer* r)
     }
     
     // Now let's get some stuff from the asset Manager.
-    Shader * program = (Shader*)r->vitalAssets->get("anim_tile_shader");
+    StockShader * sh = &r->animShader;
+    Shader * program = sh->program;
     Texture * frames = (Texture*)r->getAssetManager()->get(texture);
     
     // Start using the program.
-    glUseProgram(program->getID());
+    program->use();
     
     // Send the fractional dimensions of each frame.
     AnimTile::fractFrameDim[0] = ((GLfloat)this->frameWidth/(GLfloat)frames->getWidth());
     AnimTile::fractFrameDim[1] = ((GLfloat)this->frameHeight/(GLfloat)frames->getHeight());
-    program->setUniform("fractFrameDim", (float**)(&(AnimTile::fractFrameDim)));
+    program->set(sh->fractFrameDim, (float**)(&(AnimTile::fractFrameDim)));
     
     // Send the current frame index.
-    program->setUniform("curFrame", &this->curFrame);
-
-    // Now let's get the parallax factor.
-    float Fp = Tile::getParallaxFactor(this->getPlane());
-    
-    // Now habitually preserve the current X and Y position of the AnimTile.
-    GLfloat x = this->getX();
-    GLfloat y = this->getY();
-    
-	// Now we set up the matrix. There's documentation on how this works.
-    BasicMatrix *pm = this->getPositionMat();
-    if( this->ignoresScroll() )
-    {
-		pm->set(0,2, x );
-		pm->set(1,2, y );
-	}
-    else
-    {	
-        Camera *c = r->getCamera();
-		pm->set(0,2, ( x - c->getX() )*Fp - c->getOffX()*(1.0-Fp) );
-		pm->set(1,2, ( y - c->getY() )*Fp - c->getOffY()*(1.0-Fp) );
-	}
-    
-    // Hand it over to the GPU.
-    float * lm = this->getCompoundMat()->getLinear();
-    program->setUniform("transform", &lm);
-    
-    // Reset the BasicMatrix.
-    this->setX(x);
-    this->setY(y);
+    program->set(sh->curFrame, &this->curFrame);
+
+    // Hand it over to the GPU, unscrolled. The shader works out parallax
+    // from the plane.
+    Matrix3 transform = this->getCompoundMat();
+    float * lm = transform.getLinear();
+    program->set(sh->transform, &lm);
+    GLfloat plane = this->getScrollPlane();
+    program->set(sh->plane, &plane);
     
     // Feed this tile's depth information to the shader.
     float depth = Tile::getTileDepth(this->getPlane());
-    program->setUniform("depth", &depth);
+    program->set(sh->depth, &depth);
     
     // Now we set up this texture.
-    program->setTextureUniform("texture", frames->getID(), 0);   
+    program->setTextureUniform(sh->texture, frames->getID(), 0);   
     
     // Let's not forget about texture flip!
     GLuint hFlip = (GLuint)(this->getTextureFlip() & Tile::FLIP_HORIZ);
     GLuint vFlip = (GLuint)(this->getTextureFlip() & Tile::FLIP_VERT);
-    program->setUniform("hFlip", &hFlip);
-    program->setUniform("vFlip", &vFlip);
+    program->set(sh->hFlip, &hFlip);
+    program->set(sh->vFlip, &vFlip);
     
     
     // Draw the vertex arrays. We want the primitives drawn to be
@@ -116,6 +112,38 @@ void AnimTile::render(Renderer* r)
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+void AnimTile::fillInstance(Renderer * r, TileInstance * inst)
+{
+    // The transform, depth and flip are the same as any other Tile's.
+    Tile::fillInstance(r, inst);
+    
+    // Start the animation if need be.
+    double now = this->frameBased ? (double) r->getFrameCount() : r->getCurFrameTime();
+    if( this->animStart < 0.0 )
+    {
+        this->animStart = now;
+        this->startFrame = this->curFrame;
+    }
+    this->lastSeen = now;
+    
+    // Then hand over everything the shader needs to step through the frames
+    // itself. The start goes relative to the epoch the batch is drawn at,
+    // since after a long enough run a float can't tell one frame's time
+    // from the next. Whole cycles don't change the frame, so those are
+    // dropped too.
+    double epoch = this->frameBased ? (double) r->instanceEpochFrame : r->instanceEpoch;
+    double since = epoch - this->animStart;
+    double cycle = (double) this->frameTime * this->numFrames;
+    since = ( cycle > 0.0 ) ? fmod(since, cycle) : 0.0;
+    inst->anim[0] = (GLfloat)( -since );
+    inst->anim[1] = this->frameTime;
+    inst->anim[2] = this->numFrames;
+    inst->anim[3] = this->startFrame;
+    inst->frame[0] = this->frameWidth;
+    inst->frame[1] = this->frameHeight;
+    inst->frame[2] = this->frameBased ? 1.0 : 0.0;
+}
+
 float AnimTile::getFrameTime() const 
 {
     return this->frameTime;
@@ -123,7 +151,12 @@ float AnimTile::getFrameTime() const
 
 unsigned int AnimTile::getCurFrame() const 
 {
-    return this->curFrame;
+    // If the animation is being done on the GPU we have to work out
+    // where it's at.
+    if( this->animStart < 0.0 ) return this->curFrame;
+    if( this->frameTime <= 0.0f ) return this->startFrame;
+    unsigned long steps = (unsigned long)( (this->lastSeen - this->animStart)/this->frameTime );
+    return (this->startFrame + steps) % this->numFrames;
 }
 
 unsigned int AnimTile::getFrameHeight() const 
@@ -148,19 +181,37 @@ char* AnimTile::getTexture()
 
 void AnimTile::setFrameTime(float frameTime) 
 {
+    this->syncFrame();
     this->frameTime = frameTime;
 }
 
 void AnimTile::setCurFrame(unsigned int curFrame) 
 {
+    this->animStart = -1.0;
     this->curFrame = curFrame;
 }
 
 void AnimTile::setNumFrames(unsigned int numFrames) 
 {
+    this->syncFrame();
     this->numFrames = numFrames;
 }
 
+const char * AnimTile::getShaderKey()
+{
+    return "anim_tile_shader";
+}
+
+const char * AnimTile::getTextureKey()
+{
+    return this->texture;
+}
+
+const char * AnimTile::getInstanceShaderKey()
+{
+    return "anim_tile_shader_inst";
+}
+
 void AnimTile::report()
 {
     std::cout << "AnimTile:\t" << this->getID()  
@@ -2,6 +2,7 @@
 
 AssetManager::AssetManager()
 {
+    this->useTextureArrays = false;
 }
 
 AssetManager::~AssetManager()
@@ -35,7 +36,13 @@ tex_error AssetManager::addNewTexture(char * key, char * filepath)
     else e = t->load(filepath);
     
     // If no errors happened, then we add the Texture to the hash.
-    if( e == TEX_NO_ERROR ) this->add(key,(Asset*)t);
+    if( e == TEX_NO_ERROR ) 
+    {
+        this->add(key,(Asset*)t);
+        
+        // Real textures also get copied into a texture array if asked.
+        if( this->useTextureArrays && filepath != NULL ) this->addToTextureArray(t);
+    }
     
     // Otherwise it's time to alert the user to the problems.
     else  std::cout << "Error: " << key << ": " << Texture::getErrorDesc(e) << std::endl;
@@ -85,6 +92,43 @@ shader_error AssetManager::addNewShaderStrings(const char * key, const char * ve
 }
 	
 
+void AssetManager::addToTextureArray(Texture * t)
+{
+    // Look for an array that has room for this Texture.
+    TextureArray * a = NULL;
+    for( unsigned int i = 0; i < this->textureArrays.size(); ++i )
+    {
+        if( this->textureArrays[i]->accepts(t->getWidth(), t->getHeight(), t->getFormat()) )
+        {
+            a = this->textureArrays[i];
+            break;
+        }
+    }
+    
+    // If there isn't one, make one.
+    if( a == NULL )
+    {
+        a = new TextureArray();
+        a->init(t->getWidth(), t->getHeight(), t->getFormat(), this->textureArrays.size());
+        this->textureArrays.push_back(a);
+    }
+    
+    // Copy it in.
+    GLint layer = a->addLayer(t->getID());
+    if( layer >= 0 ) t->setArrayLayer(a, layer);
+}
+
+bool AssetManager::setUseTextureArrays(bool use)
+{
+    this->useTextureArrays = use && glewIsSupported("GL_EXT_texture_array");
+    return this->useTextureArrays;
+}
+
+bool AssetManager::usesTextureArrays()
+{
+    return this->useTextureArrays;
+}
+
 bool AssetManager::contains(char * key)
 {    
     // The ol' annoying iterator check.
@@ -137,4 +181,12 @@ void AssetManager::clear()
     // Now that all the asset hash contains has been deleted, we can
     // clear out the underlying map.
     this->assetHash.erase(this->assetHash.begin(), this->assetHash.end());
+    
+    // Same goes for the texture arrays.
+    for( unsigned int i = 0; i < this->textureArrays.size(); ++i )
+    {
+        this->textureArrays[i]->destroy();
+        delete this->textureArrays[i];
+    }
+    this->textureArrays.clear();
 }
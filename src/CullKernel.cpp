@@ -0,0 +1,335 @@
+#include "CullKernel.h"
+#include <cmath>
+
+// Only x86 compilers that let individual functions target AVX2 get the
+// vectorized versions.
+#if !defined(T2D_NO_SIMD) && defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+    #include <immintrin.h>
+    #if defined(__SSE2__)
+        #define CULL_HAVE_SSE2
+    #endif
+    #define CULL_HAVE_AVX2
+#endif
+
+// For each mask of visible lanes, the lanes that are visible, packed to
+// the front. Adding the index of the first lane and writing all of them out
+// compacts the visible indices without branching on each one.
+static int compact4[16][4];
+static int compact8[256][8];
+static unsigned int compactCount[256];
+
+cull_path CullKernel::path = CULL_SCALAR;
+cull_path CullKernel::best = CULL_SCALAR;
+bool CullKernel::detected = false;
+
+void CullKernel::detect()
+{
+    CullKernel::best = CULL_SCALAR;
+    for( int m = 0; m < 256; ++m )
+    {
+        int n = 0;
+        for( int bit = 0; bit < 8; ++bit )
+        {
+            if( m & (1 << bit) ) compact8[m][n++] = bit;
+        }
+        compactCount[m] = n;
+        while( n < 8 ) compact8[m][n++] = 0;
+        for( int j = 0; j < 4; ++j ) compact4[m & 15][j] = compact8[m & 15][j];
+    }
+    #ifdef CULL_HAVE_SSE2
+    CullKernel::best = CULL_SSE2;
+    #endif
+    #ifdef CULL_HAVE_AVX2
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("avx2") ) CullKernel::best = CULL_AVX2;
+    #endif
+    CullKernel::path = CullKernel::best;
+    CullKernel::detected = true;
+}
+
+unsigned short CullKernel::packExtent(float f)
+{
+    // Extents aren't negative, so rounding the bits up rounds the value up.
+    // (Carrying into the exponent is fine, and the biggest floats round up
+    // to infinity. NaN stays NaN, which never passes, same as before.)
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    if( ( bits & 0x7F800000 ) != 0x7F800000 ) bits += 0xFFFF;
+    return (unsigned short)( bits >> 16 );
+}
+
+float CullKernel::unpackExtent(unsigned short h)
+{
+    // The low half of the mantissa just comes back as zero.
+    unsigned int bits = (unsigned int) h << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+unsigned int CullKernel::cullScalar(const CullBounds & b, const CullView & v, unsigned int first, unsigned int * out)
+{
+    // Pull everything into locals, so the compiler knows the writes to out
+    // can't change any of it.
+    const float * x = b.x, * y = b.y;
+    const unsigned short * hw = b.halfW, * hh = b.halfH;
+    const unsigned char * view = b.view;
+    const unsigned int count = b.count;
+    const float ex = v.extentX, ey = v.extentY;
+    
+    unsigned int n = 0;
+    for( unsigned int i = first; i < count; ++i )
+    {
+        unsigned char w = view[i];
+        float dx = fabsf( x[i]*v.scale[w] - v.centerX[w] );
+        float dy = fabsf( y[i]*v.scale[w] - v.centerY[w] );
+        
+        // Write the index no matter what, and only keep it if it's visible.
+        // That way there's no branch to mispredict.
+        out[n] = i;
+        n += ( dx <= ex + CullKernel::unpackExtent(hw[i]) )
+           & ( dy <= ey + CullKernel::unpackExtent(hh[i]) );
+    }
+    return n;
+}
+
+#ifdef CULL_HAVE_SSE2
+/*
+ * Unpacks four half extents the same way unpackExtent() does. Interleaving
+ * them with zeros puts each in the top half of a float.
+ */
+static inline __m128 unpackExtents4(const unsigned short * h)
+{
+    return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i*) h)));
+}
+
+unsigned int CullKernel::cullSSE2(const CullBounds & b, const CullView & v, unsigned int * out)
+{
+    unsigned int n = 0, i = 0;
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 ex = _mm_set1_ps(v.extentX);
+    const __m128 ey = _mm_set1_ps(v.extentY);
+    
+    const float * x = b.x, * y = b.y;
+    const unsigned short * hw = b.halfW, * hh = b.halfH;
+    const unsigned char * view = b.view;
+    const unsigned int count = b.count;
+    
+    for( ; i + 4 <= count; i += 4 )
+    {
+        // SSE2 can't look values up by index, so there's no quick way to
+        // get four different views. Luckily the RenderQueue hands Tiles over
+        // grouped by view, so most of the time all four are the same and we
+        // can just broadcast it.
+        const unsigned char * w = view + i;
+        __m128 s, cx, cy;
+        unsigned int w4;
+        memcpy(&w4, w, sizeof(w4));
+        if( w4 == w[0] * 0x01010101U )
+        {
+            s  = _mm_set1_ps(v.scale[w[0]]);
+            cx = _mm_set1_ps(v.centerX[w[0]]);
+            cy = _mm_set1_ps(v.centerY[w[0]]);
+        }
+        else
+        {
+            s  = _mm_setr_ps(v.scale[w[0]], v.scale[w[1]], v.scale[w[2]], v.scale[w[3]]);
+            cx = _mm_setr_ps(v.centerX[w[0]], v.centerX[w[1]], v.centerX[w[2]], v.centerX[w[3]]);
+            cy = _mm_setr_ps(v.centerY[w[0]], v.centerY[w[1]], v.centerY[w[2]], v.centerY[w[3]]);
+        }
+        
+        __m128 dx = _mm_and_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(x + i), s), cx), absMask);
+        __m128 dy = _mm_and_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(y + i), s), cy), absMask);
+        __m128 in = _mm_and_ps(_mm_cmple_ps(dx, _mm_add_ps(ex, unpackExtents4(hw + i))),
+                               _mm_cmple_ps(dy, _mm_add_ps(ey, unpackExtents4(hh + i))));
+        
+        // Compact the visible ones. This always writes four indices, but
+        // there's room since n can't be past i.
+        int mask = _mm_movemask_ps(in);
+        __m128i lanes = _mm_loadu_si128((const __m128i*) compact4[mask]);
+        _mm_storeu_si128((__m128i*)(out + n), _mm_add_epi32(lanes, _mm_set1_epi32(i)));
+        n += compactCount[mask];
+    }
+    
+    // Finish off whatever didn't fill a whole vector.
+    return n + CullKernel::cullScalar(b, v, i, out + n);
+}
+#else
+unsigned int CullKernel::cullSSE2(const CullBounds & b, const CullView & v, unsigned int * out)
+{
+    return CullKernel::cullScalar(b, v, 0, out);
+}
+#endif
+
+#ifdef CULL_HAVE_AVX2
+/*
+ * Unpacks eight half extents the same way unpackExtent() does.
+ */
+__attribute__((target("avx2")))
+static inline __m256 unpackExtents8(const unsigned short * h)
+{
+    __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*) h));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(w, 16));
+}
+
+__attribute__((target("avx2")))
+unsigned int CullKernel::cullAVX2(const CullBounds & b, const CullView & v, unsigned int * out)
+{
+    unsigned int n = 0, i = 0;
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 ex = _mm256_set1_ps(v.extentX);
+    const __m256 ey = _mm256_set1_ps(v.extentY);
+    
+    // Keep the views in registers, eight to a register. Permuting these is
+    // a lot quicker than gathering from memory.
+    const __m256 sLo  = _mm256_loadu_ps(v.scale),   sHi  = _mm256_loadu_ps(v.scale + 8);
+    const __m256 cxLo = _mm256_loadu_ps(v.centerX), cxHi = _mm256_loadu_ps(v.centerX + 8);
+    const __m256 cyLo = _mm256_loadu_ps(v.centerY), cyHi = _mm256_loadu_ps(v.centerY + 8);
+    const __m256i seven = _mm256_set1_epi32(7);
+    
+    const float * x = b.x, * y = b.y;
+    const unsigned short * hw = b.halfW, * hh = b.halfH;
+    const unsigned char * view = b.view;
+    const unsigned int count = b.count;
+    
+    for( ; i + 8 <= count; i += 8 )
+    {
+        // Tiles come grouped by view, so usually all eight share one and
+        // it can just be broadcast, like in the SSE2 kernel.
+        __m256 s, cx, cy;
+        unsigned long long w8;
+        memcpy(&w8, view + i, sizeof(w8));
+        if( w8 == view[i] * 0x0101010101010101ULL )
+        {
+            s  = _mm256_set1_ps(v.scale[view[i]]);
+            cx = _mm256_set1_ps(v.centerX[view[i]]);
+            cy = _mm256_set1_ps(v.centerY[view[i]]);
+        }
+        else
+        {
+            // Otherwise widen the eight view indices, look each up in both
+            // halves of the tables, and take the high half's for views past
+            // the eighth.
+            __m256i w = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(view + i)));
+            __m256 hi = _mm256_castsi256_ps(_mm256_cmpgt_epi32(w, seven));
+            s  = _mm256_blendv_ps(_mm256_permutevar8x32_ps(sLo, w),  _mm256_permutevar8x32_ps(sHi, w),  hi);
+            cx = _mm256_blendv_ps(_mm256_permutevar8x32_ps(cxLo, w), _mm256_permutevar8x32_ps(cxHi, w), hi);
+            cy = _mm256_blendv_ps(_mm256_permutevar8x32_ps(cyLo, w), _mm256_permutevar8x32_ps(cyHi, w), hi);
+        }
+        
+        __m256 dx = _mm256_and_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i), s), cx), absMask);
+        __m256 dy = _mm256_and_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(y + i), s), cy), absMask);
+        __m256 in = _mm256_and_ps(
+            _mm256_cmp_ps(dx, _mm256_add_ps(ex, unpackExtents8(hw + i)), _CMP_LE_OQ),
+            _mm256_cmp_ps(dy, _mm256_add_ps(ey, unpackExtents8(hh + i)), _CMP_LE_OQ));
+        
+        int mask = _mm256_movemask_ps(in);
+        __m256i lanes = _mm256_loadu_si256((const __m256i*) compact8[mask]);
+        _mm256_storeu_si256((__m256i*)(out + n), _mm256_add_epi32(lanes, _mm256_set1_epi32(i)));
+        n += compactCount[mask];
+    }
+    
+    return n + CullKernel::cullScalar(b, v, i, out + n);
+}
+#else
+unsigned int CullKernel::cullAVX2(const CullBounds & b, const CullView & v, unsigned int * out)
+{
+    return CullKernel::cullSSE2(b, v, out);
+}
+#endif
+
+unsigned int CullKernel::cull(const CullBounds & b, const CullView & v, unsigned int * out)
+{
+    if( !CullKernel::detected ) CullKernel::detect();
+    switch( CullKernel::path )
+    {
+        case CULL_AVX2: return CullKernel::cullAVX2(b, v, out);
+        case CULL_SSE2: return CullKernel::cullSSE2(b, v, out);
+        default:        return CullKernel::cullScalar(b, v, 0, out);
+    }
+}
+
+/*
+ * What each part of a split up cull needs, and how many Tiles each part
+ * found on screen.
+ */
+struct CullJob
+{
+    const CullBounds * b;
+    const CullView * v;
+    unsigned int * out;
+    unsigned int found[WORKER_POOL_MAX_THREADS];
+};
+
+void CullKernel::cullPart(void * job, unsigned int begin, unsigned int end, unsigned int part)
+{
+    CullJob * j = (CullJob*) job;
+
+    // The part is just a shorter set of bounds...
+    CullBounds b;
+    b.x = j->b->x + begin;
+    b.y = j->b->y + begin;
+    b.halfW = j->b->halfW + begin;
+    b.halfH = j->b->halfH + begin;
+    b.view = j->b->view + begin;
+    b.count = end - begin;
+    unsigned int * out = j->out + begin;
+    unsigned int n = CullKernel::cull(b, *j->v, out);
+
+    // ...whose indices start over at zero.
+    for( unsigned int i = 0; i < n; ++i ) out[i] += begin;
+    j->found[part] = n;
+}
+
+unsigned int CullKernel::cull(const CullBounds & b, const CullView & v, unsigned int * out,
+                              WorkerPool * pool)
+{
+    // Work out the path before anyone else gets a chance to.
+    if( !CullKernel::detected ) CullKernel::detect();
+    if( pool == NULL || pool->getThreadCount() < 2 || b.count < 2*CULL_GRAIN )
+        return CullKernel::cull(b, v, out);
+
+    CullJob j;
+    j.b = &b;
+    j.v = &v;
+    j.out = out;
+    unsigned int parts = pool->run(CullKernel::cullPart, &j, b.count, CULL_GRAIN);
+
+    // Each part wrote its indices at its own beginning, so they just need
+    // sliding down to meet the ones before.
+    unsigned int n = j.found[0];
+    for( unsigned int p = 1; p < parts; ++p )
+    {
+        memmove(out + n, out + pool->getPartBegin(p), j.found[p]*sizeof(unsigned int));
+        n += j.found[p];
+    }
+    return n;
+}
+
+cull_path CullKernel::getPath()
+{
+    if( !CullKernel::detected ) CullKernel::detect();
+    return CullKernel::path;
+}
+
+void CullKernel::setPath(cull_path p)
+{
+    if( !CullKernel::detected ) CullKernel::detect();
+    CullKernel::path = ( p > CullKernel::best ) ? CullKernel::best : p;
+}
+
+cull_path CullKernel::getBestPath()
+{
+    if( !CullKernel::detected ) CullKernel::detect();
+    return CullKernel::best;
+}
+
+const char * CullKernel::getPathName(cull_path p)
+{
+    switch(p)
+    {
+        case CULL_AVX2: return "AVX2";
+        case CULL_SSE2: return "SSE2";
+        default:        return "scalar";
+    }
+}
@@ -73,7 +73,7 @@ void DefTile::render(Renderer * r)
     Texture * d = (Texture*)r->getAssetManager()->get(this->texD);
     
     // Start using this DefTile's shader.
-    glUseProgram(program->getID());
+    program->use();
     
     // Set the texture unit uniforms.
     program->setTextureUniform("texA", a->getID(), 0);
@@ -85,31 +85,43 @@ void DefTile::render(Renderer * r)
     program->setTextureUniform("fwdColor", r->getFwdPass()->getRenderTexture(), 4);
     program->setTextureUniform("fwdDepth", r->getFwdPass()->getDepthTexture(), 5);
     
-    // Send in the resolution.
-    DefTile::resolution[0] = (GLfloat)(r->getDefPass()->getWidth());
-    DefTile::resolution[1] = (GLfloat)(r->getDefPass()->getHeight());
-    program->setUniform("resolution", &(DefTile::resolution));
+    // The resolution, camera and time are the same for the whole frame. If
+    // the shader reads them from the frame block they're already there.
+    if( !program->usesFrameBlock() )
+    {
+        // Send in the resolution.
+        DefTile::resolution[0] = (GLfloat)(r->getDefPass()->getWidth());
+        DefTile::resolution[1] = (GLfloat)(r->getDefPass()->getHeight());
+        program->setUniform("resolution", &(DefTile::resolution));
     
-    // Send in the camera position.
-    DefTile::camPosition[0] = (GLfloat)(r->getCamera()->getX());
-    DefTile::camPosition[1] = (GLfloat)(r->getCamera()->getY());
-    program->setUniform("camera", &(DefTile::camPosition));
+        // Send in the camera position.
+        DefTile::camPosition[0] = (GLfloat)(r->getCamera()->getX());
+        DefTile::camPosition[1] = (GLfloat)(r->getCamera()->getY());
+        program->setUniform("camera", &(DefTile::camPosition));
 
-    // Send in the parallax center offset.
-    // Optimize all of this later.
-    DefTile::pOffset[0] = (GLfloat)(r->getCamera()->getOffX());
-    DefTile::pOffset[1] = (GLfloat)(r->getCamera()->getOffY());
-    program->setUniform("pOffset", &(DefTile::pOffset));
+        // Send in the parallax center offset.
+        DefTile::pOffset[0] = (GLfloat)(r->getCamera()->getOffX());
+        DefTile::pOffset[1] = (GLfloat)(r->getCamera()->getOffY());
+        program->setUniform("pOffset", &(DefTile::pOffset));
+    
+        // Let's not forget the time. (The frame's time, so every Tile agrees.)
+        float time = (float) r->getCurFrameTime();
+        program->setUniform("time", &time);
+        
+        // And the parallax factor of every plane, so the shader can look up
+        // its own.
+        GLfloat coeffs[NUM_PLANES];
+        for( unsigned int i = 0; i < NUM_PLANES; ++i )
+            coeffs[i] = Tile::getParallaxFactor((tile_plane)i);
+        program->setUniform("scrollCoeffs", coeffs);
+    }
     
     // Since DefTiles do the parallax effect entirely in the vertex shader,
     // we can send them a virgin matrix.
-    float * lm = this->getCompoundMat()->getLinear();
+    Matrix3 transform = this->getCompoundMat();
+    float * lm = transform.getLinear();
     program->setUniform("transform", &lm);
     
-    // Let's not forget the time.
-    float time = glfwGetTime();
-    program->setUniform("time", &time);
-    
     // Get the parallax factor and send it in.
     float Fp = this->getParallaxFactor(this->getPlane());
     program->setUniform("pFactor", &Fp);
@@ -118,6 +130,10 @@ void DefTile::render(Renderer * r)
     float is = (float) this->ignoresScroll();
     program->setUniform("ignoreScroll", &is);
     
+    // Or the plane, for shaders that look the parallax factor up.
+    GLfloat plane = this->getScrollPlane();
+    program->setUniform("plane", &plane);
+    
     // Send in the depth of this Tile as well.
     float depth = Tile::getTileDepth(this->getPlane());
     program->setUniform("depth", &depth);
@@ -132,6 +148,16 @@ void DefTile::render(Renderer * r)
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+const char * DefTile::getShaderKey()
+{
+    return this->shader;
+}
+
+const char * DefTile::getTextureKey()
+{
+    return this->texA;
+}
+
 void DefTile::report()
 {
     std::cout << "DefTile:\t" << this->getID()  
@@ -0,0 +1,74 @@
+#include "FrameBlock.h"
+
+FrameBlock::FrameBlock()
+{
+    this->buffer = 0;
+    this->supported = false;
+    memset(&this->data, 0, sizeof(FrameBlockData));
+}
+
+FrameBlock::~FrameBlock()
+{
+}
+
+void FrameBlock::init()
+{
+    this->supported = glewIsSupported("GL_ARB_uniform_buffer_object");
+    if( !this->supported ) return;
+    
+    // Make the buffer and leave it bound to its binding point. Nothing else
+    // uses that binding point, so it can stay there for good.
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlockData), &this->data, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, this->buffer);
+}
+
+bool FrameBlock::isSupported()
+{
+    return this->supported;
+}
+
+void FrameBlock::setCamera(GLfloat x, GLfloat y, GLfloat offX, GLfloat offY)
+{
+    this->data.camera[0] = x;
+    this->data.camera[1] = y;
+    this->data.camera[2] = offX;
+    this->data.camera[3] = offY;
+}
+
+void FrameBlock::setResolution(GLfloat fbWidth, GLfloat fbHeight, GLfloat winWidth, GLfloat winHeight)
+{
+    this->data.resolution[0] = fbWidth;
+    this->data.resolution[1] = fbHeight;
+    this->data.resolution[2] = winWidth;
+    this->data.resolution[3] = winHeight;
+}
+
+void FrameBlock::setScroll(unsigned int plane, GLfloat coeff)
+{
+    if( plane < FRAME_BLOCK_SCROLL_COEFFS ) this->data.scroll[plane] = coeff;
+}
+
+void FrameBlock::setTime(GLfloat time, GLfloat frameCount)
+{
+    this->data.time[0] = time;
+    this->data.time[1] = frameCount;
+}
+
+void FrameBlock::upload()
+{
+    if( !this->supported ) return;
+    
+    // The whole thing's rewritten every frame, so just replace it.
+    glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlockData), &this->data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameBlock::destroy()
+{
+    if( this->buffer ) glDeleteBuffers(1, &this->buffer);
+    this->buffer = 0;
+}
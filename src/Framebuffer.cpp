@@ -7,6 +7,7 @@ Framebuffer::Framebuffer()
     this->framebuffer = 0;
     this->renderbuffer = 0;
     this->depthbuffer = 0;
+    this->stencil = false;
 }
 
 Framebuffer::~Framebuffer()
@@ -46,9 +47,25 @@ bool Framebuffer::init(GLuint width, GLuint height)
     this->width = width;
     this->height = height;
     
+    // Try for stencil where we can get it, and do without where the driver
+    // turns the packed format down.
+    bool stencil = glewIsSupported("GL_EXT_packed_depth_stencil") ||
+                   glewIsSupported("GL_ARB_framebuffer_object");
+    if( stencil )
+    {
+        if( this->create(true) ) return true;
+        this->destroy();
+    }
+    return this->create(false);
+}
+
+bool Framebuffer::create(bool stencil)
+{
+    this->stencil = stencil;
+    
     // Create the color attachment.
     glGenTextures(1, &this->renderbuffer);
-    glBindTexture(GL_TEXTURE_2D, this->renderbuffer);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->renderbuffer);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -58,39 +75,48 @@ bool Framebuffer::init(GLuint width, GLuint height)
     
     // Create the depth attachment.
     glGenTextures(1, &this->depthbuffer);
-    glBindTexture(GL_TEXTURE_2D, this->depthbuffer);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->depthbuffer);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, this->width, this->height,
-                 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, NULL);
+    if( stencil )
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8_EXT, this->width, this->height,
+                     0, GL_DEPTH_STENCIL_EXT, GL_UNSIGNED_INT_24_8_EXT, NULL);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, this->width, this->height,
+                     0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, NULL);
                  
     // Create the framebuffer.
     glGenFramebuffers(1, &this->framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    GLStateCache::bindFramebuffer(this->framebuffer);
+    GLStateCache::setDepthTest(true);
+    GLStateCache::depthFunc(GL_LESS);
     
-    glBindTexture(GL_TEXTURE_2D, this->renderbuffer);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->renderbuffer);
     // Attach the color texture as the framebuffer's color attachment.
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                            GL_TEXTURE_2D, this->renderbuffer, 0);
     
     // Attach the depth texture as the framebuffer's depth attachment.
-    glBindTexture(GL_TEXTURE_2D, this->depthbuffer);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->depthbuffer);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, 
                            GL_TEXTURE_2D, this->depthbuffer, 0);
     
+    // And as its stencil attachment, if it has that too.
+    if( stencil )
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                               GL_TEXTURE_2D, this->depthbuffer, 0);
+    
     // Enable depth testing.
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    GLStateCache::setDepthTest(true);
+    GLStateCache::depthFunc(GL_LESS);
     
     // Best practice to check framebuffer completeness.
     GLenum e = glCheckFramebufferStatusEXT(GL_FRAMEBUFFER);
     
     // Go ahead and set the render target back to the window's backbuffer.
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache::bindFramebuffer(0);
     return e == GL_FRAMEBUFFER_COMPLETE;
 }
 
@@ -106,10 +132,10 @@ bool Framebuffer::resize(GLuint width, GLuint height)
 void Framebuffer::setAsRenderTarget()
 {
     // Tell OpenGL to do what we want.
-    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+    GLStateCache::bindFramebuffer(this->framebuffer);
     
     // Make sure that we're rendering to the framebuffer's dimensions.
-    glViewport(0,0, this->width, this->height);
+    GLStateCache::viewport(0,0, this->width, this->height);
     
 }
 
@@ -133,12 +159,20 @@ GLuint Framebuffer::getDepthTexture()
     return this->depthbuffer;
 }
 
+bool Framebuffer::hasStencil()
+{
+    return this->stencil;
+}
+
 void Framebuffer::destroy()
 {
     // Delete everything we had on the GPU.
     glDeleteFramebuffers(1, &this->framebuffer);
-    glDeleteRenderbuffers(1, &this->depthbuffer);
+    glDeleteTextures(1, &this->depthbuffer);
     glDeleteTextures(1, &this->renderbuffer);
+    GLStateCache::forgetFramebuffer(this->framebuffer);
+    GLStateCache::forgetTexture(this->depthbuffer);
+    GLStateCache::forgetTexture(this->renderbuffer);
 }
 
 
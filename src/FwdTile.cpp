@@ -73,7 +73,7 @@ void FwdTile::render(Renderer * r)
     Texture * d = (Texture*)r->getAssetManager()->get(this->texD);
     
     // Start using this FwdTile's shader.
-    glUseProgram(program->getID());
+    program->use();
     
     // Set the texture unit uniforms.
     program->setTextureUniform("texA", a->getID(), 0);
@@ -81,30 +81,43 @@ void FwdTile::render(Renderer * r)
     program->setTextureUniform("texC", c->getID(), 2);
     program->setTextureUniform("texD", d->getID(), 3);
     
-    // Send in the resolution.
-    FwdTile::resolution[0] = (GLfloat)(r->getDefPass()->getWidth());
-    FwdTile::resolution[1] = (GLfloat)(r->getDefPass()->getHeight());
-    program->setUniform("resolution", &(FwdTile::resolution));
+    // The resolution, camera and time are the same for the whole frame. If
+    // the shader reads them from the frame block they're already there.
+    if( !program->usesFrameBlock() )
+    {
+        // Send in the resolution.
+        FwdTile::resolution[0] = (GLfloat)(r->getDefPass()->getWidth());
+        FwdTile::resolution[1] = (GLfloat)(r->getDefPass()->getHeight());
+        program->setUniform("resolution", &(FwdTile::resolution));
     
-    // Send in the camera position.
-    FwdTile::camPosition[0] = (GLfloat)(r->getCamera()->getX());
-    FwdTile::camPosition[1] = (GLfloat)(r->getCamera()->getY());
-    program->setUniform("camera", &(FwdTile::camPosition));
+        // Send in the camera position.
+        FwdTile::camPosition[0] = (GLfloat)(r->getCamera()->getX());
+        FwdTile::camPosition[1] = (GLfloat)(r->getCamera()->getY());
+        program->setUniform("camera", &(FwdTile::camPosition));
 
-    // Send in the parallax offset center as well.
-    FwdTile::pOffset[0] = (GLfloat)(r->getCamera()->getOffX());
-    FwdTile::pOffset[1] = (GLfloat)(r->getCamera()->getOffY());
-    program->setUniform("pOffset", &(FwdTile::pOffset));
+        // Send in the parallax offset center as well.
+        FwdTile::pOffset[0] = (GLfloat)(r->getCamera()->getOffX());
+        FwdTile::pOffset[1] = (GLfloat)(r->getCamera()->getOffY());
+        program->setUniform("pOffset", &(FwdTile::pOffset));
+    
+        // Let's not forget the time. (The frame's time, so every Tile agrees.)
+        float time = (float) r->getCurFrameTime();
+        program->setUniform("time", &time);
+        
+        // And the parallax factor of every plane, so the shader can look up
+        // its own.
+        GLfloat coeffs[NUM_PLANES];
+        for( unsigned int i = 0; i < NUM_PLANES; ++i )
+            coeffs[i] = Tile::getParallaxFactor((tile_plane)i);
+        program->setUniform("scrollCoeffs", coeffs);
+    }
     
     // Since FwdTiles do the parallax effect entirely in the vertex shader,
     // we can send them a virgin matrix.
-    float * lm = this->getCompoundMat()->getLinear();
+    Matrix3 transform = this->getCompoundMat();
+    float * lm = transform.getLinear();
     program->setUniform("transform", &lm);
     
-    // Let's not forget the time.
-    float time = glfwGetTime();
-    program->setUniform("time", &time);
-    
     // Get the parallax factor and send it in.
     float Fp = this->getParallaxFactor(this->getPlane());
     program->setUniform("pFactor", &Fp);
@@ -113,6 +126,10 @@ void FwdTile::render(Renderer * r)
     float is = (float) this->ignoresScroll();
     program->setUniform("ignoreScroll", &is);
     
+    // Or the plane, for shaders that look the parallax factor up.
+    GLfloat plane = this->getScrollPlane();
+    program->setUniform("plane", &plane);
+    
     // Send in the depth of this Tile as well.
     float depth = Tile::getTileDepth(this->getPlane());
     program->setUniform("depth", &depth);
@@ -127,6 +144,16 @@ void FwdTile::render(Renderer * r)
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+const char * FwdTile::getShaderKey()
+{
+    return this->shader;
+}
+
+const char * FwdTile::getTextureKey()
+{
+    return this->texA;
+}
+
 void FwdTile::report()
 {
     std::cout << "FwdTile:\t" << this->getID()  
@@ -0,0 +1,187 @@
+#include "GLStateCache.h"
+
+// What we store for state we don't know. (No sane GL hands out these names.)
+#define UNKNOWN_NAME 0xFFFFFFFF
+#define UNKNOWN_ENUM 0xFFFFFFFF
+#define UNKNOWN_FLAG -1
+
+GLuint GLStateCache::program = UNKNOWN_NAME;
+GLuint GLStateCache::activeUnit = UNKNOWN_NAME;
+GLuint GLStateCache::textures2D[GL_STATE_CACHE_UNITS];
+GLuint GLStateCache::texturesArray[GL_STATE_CACHE_UNITS];
+GLuint GLStateCache::framebuffer = UNKNOWN_NAME;
+GLint GLStateCache::viewportRect[4] = {-1, -1, -1, -1};
+GLuint GLStateCache::vertexArray = UNKNOWN_NAME;
+int GLStateCache::blend = UNKNOWN_FLAG;
+GLenum GLStateCache::blendSrc = UNKNOWN_ENUM;
+GLenum GLStateCache::blendDst = UNKNOWN_ENUM;
+int GLStateCache::depthTest = UNKNOWN_FLAG;
+GLenum GLStateCache::depthFuncValue = UNKNOWN_ENUM;
+unsigned long GLStateCache::issuedCount = 0;
+unsigned long GLStateCache::filteredCount = 0;
+
+GLuint * GLStateCache::getTextureSlot(GLuint unit, GLenum target)
+{
+    if( unit >= GL_STATE_CACHE_UNITS ) return NULL;
+    switch(target)
+    {
+        case GL_TEXTURE_2D: return &GLStateCache::textures2D[unit];
+        case GL_TEXTURE_2D_ARRAY_EXT: return &GLStateCache::texturesArray[unit];
+        default: return NULL;
+    }
+}
+
+bool GLStateCache::count(bool changed)
+{
+    if( changed ) ++ GLStateCache::issuedCount;
+    else ++ GLStateCache::filteredCount;
+    return changed;
+}
+
+void GLStateCache::invalidate()
+{
+    GLStateCache::program = UNKNOWN_NAME;
+    GLStateCache::activeUnit = UNKNOWN_NAME;
+    for( unsigned int i = 0; i < GL_STATE_CACHE_UNITS; ++i )
+    {
+        GLStateCache::textures2D[i] = UNKNOWN_NAME;
+        GLStateCache::texturesArray[i] = UNKNOWN_NAME;
+    }
+    GLStateCache::framebuffer = UNKNOWN_NAME;
+    for( unsigned int i = 0; i < 4; ++i ) GLStateCache::viewportRect[i] = -1;
+    GLStateCache::vertexArray = UNKNOWN_NAME;
+    GLStateCache::blend = UNKNOWN_FLAG;
+    GLStateCache::blendSrc = UNKNOWN_ENUM;
+    GLStateCache::blendDst = UNKNOWN_ENUM;
+    GLStateCache::depthTest = UNKNOWN_FLAG;
+    GLStateCache::depthFuncValue = UNKNOWN_ENUM;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if( !GLStateCache::count(program != GLStateCache::program) ) return;
+    glUseProgram(program);
+    GLStateCache::program = program;
+}
+
+void GLStateCache::activeTexture(GLuint unit)
+{
+    if( !GLStateCache::count(unit != GLStateCache::activeUnit) ) return;
+    glActiveTexture(GL_TEXTURE0+unit);
+    GLStateCache::activeUnit = unit;
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    // Only bother switching units if the binding is actually going to change.
+    GLuint * slot = GLStateCache::getTextureSlot(unit, target);
+    if( slot != NULL && !GLStateCache::count(*slot != texture) ) return;
+    GLStateCache::activeTexture(unit);
+    glBindTexture(target, texture);
+    if( slot != NULL ) *slot = texture;
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+    // If we don't know which unit's active we can't know what's bound to it.
+    if( GLStateCache::activeUnit == UNKNOWN_NAME )
+    {
+        glBindTexture(target, texture);
+        ++ GLStateCache::issuedCount;
+        return;
+    }
+    GLStateCache::bindTexture(GLStateCache::activeUnit, target, texture);
+}
+
+void GLStateCache::bindFramebuffer(GLuint framebuffer)
+{
+    if( !GLStateCache::count(framebuffer != GLStateCache::framebuffer) ) return;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    GLStateCache::framebuffer = framebuffer;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    GLint * v = GLStateCache::viewportRect;
+    if( !GLStateCache::count(v[0] != x || v[1] != y || v[2] != width || v[3] != height) ) return;
+    glViewport(x, y, width, height);
+    v[0] = x; v[1] = y; v[2] = width; v[3] = height;
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray)
+{
+    if( !GLStateCache::count(vertexArray != GLStateCache::vertexArray) ) return;
+    glBindVertexArray(vertexArray);
+    GLStateCache::vertexArray = vertexArray;
+}
+
+void GLStateCache::setBlend(bool enabled)
+{
+    if( !GLStateCache::count((int)enabled != GLStateCache::blend) ) return;
+    if( enabled ) glEnable(GL_BLEND);
+    else glDisable(GL_BLEND);
+    GLStateCache::blend = enabled;
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+    if( !GLStateCache::count(src != GLStateCache::blendSrc || dst != GLStateCache::blendDst) ) return;
+    glBlendFunc(src, dst);
+    GLStateCache::blendSrc = src;
+    GLStateCache::blendDst = dst;
+}
+
+void GLStateCache::setDepthTest(bool enabled)
+{
+    if( !GLStateCache::count((int)enabled != GLStateCache::depthTest) ) return;
+    if( enabled ) glEnable(GL_DEPTH_TEST);
+    else glDisable(GL_DEPTH_TEST);
+    GLStateCache::depthTest = enabled;
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if( !GLStateCache::count(func != GLStateCache::depthFuncValue) ) return;
+    glDepthFunc(func);
+    GLStateCache::depthFuncValue = func;
+}
+
+void GLStateCache::forgetProgram(GLuint program)
+{
+    if( GLStateCache::program == program ) GLStateCache::program = UNKNOWN_NAME;
+}
+
+void GLStateCache::forgetTexture(GLuint texture)
+{
+    for( unsigned int i = 0; i < GL_STATE_CACHE_UNITS; ++i )
+    {
+        if( GLStateCache::textures2D[i] == texture ) GLStateCache::textures2D[i] = UNKNOWN_NAME;
+        if( GLStateCache::texturesArray[i] == texture ) GLStateCache::texturesArray[i] = UNKNOWN_NAME;
+    }
+}
+
+void GLStateCache::forgetFramebuffer(GLuint framebuffer)
+{
+    if( GLStateCache::framebuffer == framebuffer ) GLStateCache::framebuffer = UNKNOWN_NAME;
+}
+
+void GLStateCache::forgetVertexArray(GLuint vertexArray)
+{
+    if( GLStateCache::vertexArray == vertexArray ) GLStateCache::vertexArray = UNKNOWN_NAME;
+}
+
+unsigned long GLStateCache::getIssuedCount()
+{
+    return GLStateCache::issuedCount;
+}
+
+unsigned long GLStateCache::getFilteredCount()
+{
+    return GLStateCache::filteredCount;
+}
+
+void GLStateCache::resetCounts()
+{
+    GLStateCache::issuedCount = 0;
+    GLStateCache::filteredCount = 0;
+}
@@ -0,0 +1,58 @@
+#include "OcclusionBuffer.h"
+
+OcclusionBuffer::OcclusionBuffer()
+{
+    this->clear();
+}
+
+void OcclusionBuffer::clear()
+{
+    // Nothing's nearer than everything.
+    for( unsigned int i = 0; i < OCCLUSION_ROWS * OCCLUSION_COLS; ++i ) this->depth[i] = HUGE_VALF;
+    this->empty = true;
+}
+
+void OcclusionBuffer::addOccluder(float x0, float y0, float x1, float y1, float d)
+{
+    // Only the cells the occluder covers all of. (Round inwards.)
+    int cx0 = (int) ceilf( (x0 + 1.0f) * (OCCLUSION_COLS * .5f) );
+    int cy0 = (int) ceilf( (y0 + 1.0f) * (OCCLUSION_ROWS * .5f) );
+    int cx1 = (int) floorf( (x1 + 1.0f) * (OCCLUSION_COLS * .5f) );
+    int cy1 = (int) floorf( (y1 + 1.0f) * (OCCLUSION_ROWS * .5f) );
+    if( cx0 < 0 ) cx0 = 0;
+    if( cy0 < 0 ) cy0 = 0;
+    if( cx1 > OCCLUSION_COLS ) cx1 = OCCLUSION_COLS;
+    if( cy1 > OCCLUSION_ROWS ) cy1 = OCCLUSION_ROWS;
+    if( cx0 >= cx1 || cy0 >= cy1 ) return;
+
+    for( int y = cy0; y < cy1; ++y )
+    {
+        float * row = &this->depth[y * OCCLUSION_COLS];
+        for( int x = cx0; x < cx1; ++x ) if( d < row[x] ) row[x] = d;
+    }
+    this->empty = false;
+}
+
+bool OcclusionBuffer::isOccluded(float x0, float y0, float x1, float y1, float d)
+{
+    if( this->empty ) return false;
+
+    // Every cell it touches, even a little. (Round outwards.) What's off
+    // screen doesn't matter, so that gets clipped off.
+    int cx0 = (int) floorf( (x0 + 1.0f) * (OCCLUSION_COLS * .5f) );
+    int cy0 = (int) floorf( (y0 + 1.0f) * (OCCLUSION_ROWS * .5f) );
+    int cx1 = (int) ceilf( (x1 + 1.0f) * (OCCLUSION_COLS * .5f) );
+    int cy1 = (int) ceilf( (y1 + 1.0f) * (OCCLUSION_ROWS * .5f) );
+    if( cx0 < 0 ) cx0 = 0;
+    if( cy0 < 0 ) cy0 = 0;
+    if( cx1 > OCCLUSION_COLS ) cx1 = OCCLUSION_COLS;
+    if( cy1 > OCCLUSION_ROWS ) cy1 = OCCLUSION_ROWS;
+    if( cx0 >= cx1 || cy0 >= cy1 ) return false;
+
+    for( int y = cy0; y < cy1; ++y )
+    {
+        const float * row = &this->depth[y * OCCLUSION_COLS];
+        for( int x = cx0; x < cx1; ++x ) if( !( row[x] < d ) ) return false;
+    }
+    return true;
+}
@@ -0,0 +1,204 @@
+#include "OverdrawMeter.h"
+#include "Tile.h"
+#include "StaticChunk.h"
+
+/**
+ * @brief Orders draws by how many pixels they wrote, most first.
+ */
+static bool morePixels(const OverdrawDraw & a, const OverdrawDraw & b)
+{
+    return a.pixels > b.pixels;
+}
+
+OverdrawMeter::OverdrawMeter()
+{
+    this->width = 0;
+    this->height = 0;
+    this->heatmap = 0;
+    this->heatmapW = 0;
+    this->heatmapH = 0;
+    this->pass = OVERDRAW_FWD;
+    memset(this->stats, 0, sizeof(this->stats));
+}
+
+OverdrawMeter::~OverdrawMeter()
+{
+}
+
+bool OverdrawMeter::isSupported()
+{
+    return glewIsSupported("GL_VERSION_1_5") &&
+           ( glewIsSupported("GL_EXT_packed_depth_stencil") ||
+             glewIsSupported("GL_ARB_framebuffer_object") );
+}
+
+void OverdrawMeter::beginFrame(GLuint width, GLuint height)
+{
+    this->width = width;
+    this->height = height;
+    this->stencil.resize(width * height);
+    this->counts.assign(width * height, 0);
+    this->frameDraws.clear();
+}
+
+void OverdrawMeter::beginPass(overdraw_pass pass)
+{
+    this->pass = pass;
+    this->draws.clear();
+
+    // Every fragment that makes it past the depth test bumps its pixel's
+    // stencil. Nothing's ever rejected by it, so what gets drawn doesn't
+    // change.
+    glClearStencil(0);
+    glClear(GL_STENCIL_BUFFER_BIT);
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, 0, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+}
+
+void OverdrawMeter::beginDraw(Tile * t, StaticChunk * c)
+{
+    // Grab another query if we've run out.
+    if( this->draws.size() == this->queries.size() )
+    {
+        GLuint q = 0;
+        glGenQueries(1, &q);
+        this->queries.push_back(q);
+    }
+
+    OverdrawDraw d;
+    d.tile = t;
+    d.chunk = c;
+    d.pixels = 0;
+    glBeginQuery(GL_SAMPLES_PASSED, this->queries[this->draws.size()]);
+    this->draws.push_back(d);
+}
+
+void OverdrawMeter::endDraw()
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void OverdrawMeter::endPass()
+{
+    glDisable(GL_STENCIL_TEST);
+
+    // Collect how much each draw wrote. (This waits on the GPU.)
+    for( unsigned int i = 0; i < this->draws.size(); ++i )
+        glGetQueryObjectuiv(this->queries[i], GL_QUERY_RESULT, &this->draws[i].pixels);
+    this->frameDraws.insert(this->frameDraws.end(), this->draws.begin(), this->draws.end());
+
+    // And how much each pixel got.
+    if( this->stencil.empty() ) return;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, this->width, this->height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE,
+                 &this->stencil[0]);
+    OverdrawMeter::tally(this->stencil, this->draws, &this->stats[this->pass]);
+
+    // Add this pass onto the frame's counts, without wrapping around.
+    for( unsigned int i = 0; i < this->stencil.size(); ++i )
+    {
+        GLuint n = this->counts[i] + this->stencil[i];
+        this->counts[i] = (GLubyte)( n > 255 ? 255 : n );
+    }
+}
+
+void OverdrawMeter::endFrame()
+{
+    OverdrawMeter::tally(this->counts, this->frameDraws, &this->stats[OVERDRAW_TOTAL]);
+    if( this->counts.empty() ) return;
+
+    if( this->heatmap == 0 )
+    {
+        glGenTextures(1, &this->heatmap);
+        GLStateCache::bindTexture(GL_TEXTURE_2D, this->heatmap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // Only reallocate it when the framebuffers change size.
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->heatmap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if( this->heatmapW != this->width || this->heatmapH != this->height )
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, this->width, this->height, 0,
+                     GL_LUMINANCE, GL_UNSIGNED_BYTE, &this->counts[0]);
+        this->heatmapW = this->width;
+        this->heatmapH = this->height;
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->width, this->height,
+                        GL_LUMINANCE, GL_UNSIGNED_BYTE, &this->counts[0]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void OverdrawMeter::tally(const std::vector<GLubyte> & counts,
+                          std::vector<OverdrawDraw> & draws, OverdrawStats * s)
+{
+    memset(s, 0, sizeof(OverdrawStats));
+    s->pixels = counts.size();
+    for( unsigned int i = 0; i < counts.size(); ++i )
+    {
+        GLuint n = counts[i];
+        s->fragments += n;
+        if( n > s->max ) s->max = n;
+        ++ s->histogram[ n < OVERDRAW_BUCKETS ? n : OVERDRAW_BUCKETS - 1 ];
+    }
+    s->mean = s->pixels ? (GLfloat)s->fragments / (GLfloat)s->pixels : 0.0;
+
+    // We only want the top few, so there's no need to sort the rest.
+    s->worstCount = std::min( (GLuint)draws.size(), (GLuint)OVERDRAW_WORST_DRAWS );
+    std::partial_sort(draws.begin(), draws.begin() + s->worstCount, draws.end(), morePixels);
+    for( unsigned int i = 0; i < s->worstCount; ++i ) s->worst[i] = draws[i];
+}
+
+const OverdrawStats & OverdrawMeter::getStats(overdraw_pass pass)
+{
+    return this->stats[pass % NUM_OVERDRAW_PASSES];
+}
+
+GLuint OverdrawMeter::getHeatmap()
+{
+    return this->heatmap;
+}
+
+void OverdrawMeter::report()
+{
+    const char * names[NUM_OVERDRAW_PASSES] = { "fwd", "def", "total" };
+    for( unsigned int p = 0; p < NUM_OVERDRAW_PASSES; ++p )
+    {
+        const OverdrawStats & s = this->stats[p];
+        std::cout << "Overdraw (" << names[p] << "): mean " << s.mean
+                  << "\tmax: " << s.max
+                  << "\tfragments: " << s.fragments << std::endl;
+        std::cout << "  histogram:";
+        for( unsigned int i = 0; i < OVERDRAW_BUCKETS; ++i )
+            std::cout << " " << s.histogram[i];
+        std::cout << std::endl;
+        for( unsigned int i = 0; i < s.worstCount; ++i )
+        {
+            const OverdrawDraw & d = s.worst[i];
+            if( d.chunk ) std::cout << "  chunk of " << d.chunk->getTileCount() << " Tiles";
+            else std::cout << "  Tile " << d.tile->getID();
+            std::cout << ": " << d.pixels << " pixels" << std::endl;
+        }
+    }
+}
+
+void OverdrawMeter::destroy()
+{
+    if( !this->queries.empty() )
+        glDeleteQueries(this->queries.size(), &this->queries[0]);
+    this->queries.clear();
+    if( this->heatmap )
+    {
+        glDeleteTextures(1, &this->heatmap);
+        GLStateCache::forgetTexture(this->heatmap);
+    }
+    this->heatmap = 0;
+    this->heatmapW = this->heatmapH = 0;
+}
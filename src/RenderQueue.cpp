@@ -1,104 +1,781 @@
 #include "RenderQueue.h"
 
-void RenderQueue::memoize()
-{
-    // Clear the old memoization first.
-    this->memo.clear();
-    
-    // Iterate over each item in the queue, and hash its index.
-    unsigned int i = 0;
-    for(std::vector<TileWithType>::iterator it = this->queue.begin(); it != this->queue.end(); ++it)
-    {
-        /* it->first: TileType
-         * it->second: Tile* */
-        this->memo.insert(IdAndIndex(it->second->getID(), i));
-        ++i;
-    }
-}
-
-bool RenderQueue::tileSortingPredicate(TileWithType lhs, TileWithType rhs)
-{
-    Tile * a = lhs.second;
-    Tile * b = rhs.second;
-    
-    // Let's first split things up into fwd and def tiles.
-    if( lhs.first == DEF_TILE && rhs.first != DEF_TILE ) return false;
-    if( lhs.first != DEF_TILE && rhs.first == DEF_TILE ) return true;
-    
-    // We need to render transparent objects last.
-    if(  a->hasTrans() && !b->hasTrans() ) return false;
-    if( !a->hasTrans() &&  b->hasTrans() ) return true;
-    
-    // At this point both operands will have the same transparency status.
-    
-    // When Tiles don't have transparency, we can draw them from front to
-    // back and take advantage of z-culling.
-    if( !a->hasTrans() )
-    {
-        // Now we're comparing rendering planes. We want to
-        // draw the closest Tiles first, so we can take
-        // advantage of depth testing and thusly minimize redraw.
-        if( a->getPlane() <= b->getPlane() ) return true;
-        if( a->getPlane() >  b->getPlane() ) return false;
-    }
-    
-    // Otherwise we need to draw from back to front in order for transparency
-    // to work right.
+// Zero is reserved to mean "no queue".
+unsigned int RenderQueue::nextID = 1;
+
+RenderQueue::RenderQueue()
+{
+    this->id = RenderQueue::nextID++;
+    this->nextSeq = 0;
+    this->dirty = false;
+    this->assets = NULL;
+    this->workers = NULL;
+    this->gridScrollVersion = Tile::getScrollVersion();
+    this->visit = 0;
+    this->damagedAll = true;
+}
+
+unsigned int RenderQueue::getID() const
+{
+    return this->id;
+}
+
+unsigned int RenderQueue::intern(std::map< std::string, unsigned int > & table, const char * key)
+{
+    // No key, no ID.
+    if( key == NULL ) return 0;
+
+    // If we've seen this key before we already know its ID.
+    std::map< std::string, unsigned int >::iterator it = table.find(key);
+    if( it != table.end() ) return it->second;
+
+    // Otherwise it gets the next one. (Zero's taken by NULL.)
+    unsigned int newID = table.size() + 1;
+    table.insert(std::pair<std::string, unsigned int>(key, newID));
+    return newID;
+}
+
+SortKey RenderQueue::makeKey(QueueSlot & s)
+{
+    Tile * t = s.tile.second;
+
+    // Re-intern the render state keys only if they've changed.
+    const char * shaderKey = t->getShaderKey();
+    const char * textureKey = t->getTextureKey();
+    if( shaderKey != s.shaderKey )
+    {
+        s.shaderKey = shaderKey;
+        s.shaderID = RenderQueue::intern(this->shaderIDs, shaderKey);
+    }
+    if( textureKey != s.textureKey )
+    {
+        s.textureKey = textureKey;
+        s.layer = -1;
+
+        // Textures that live in a TextureArray go by the array's name.
+        Texture * tex = NULL;
+        if( this->assets != NULL && textureKey != NULL )
+            tex = (Texture*) this->assets->get(textureKey);
+        if( tex != NULL && tex->getArray() != NULL )
+        {
+            s.textureID = RenderQueue::intern(this->textureIDs, tex->getArray()->getKey());
+            s.layer = tex->getLayer();
+        }
+        else s.textureID = RenderQueue::intern(this->textureIDs, textureKey);
+    }
+
+    // Opaque Tiles are drawn front to back so we can take advantage of
+    // depth testing and thusly minimize redraw. Transparent ones need to be
+    // drawn back to front in order for blending to work right.
+    const TileStore * store = Tile::getStore();
+    bool trans = store->getFlags(t->ref.index) & TILE_STORE_TRANS;
+    SortKey plane = store->getPlane(t->ref.index) % NUM_PLANES;
+    if( trans ) plane = (NUM_PLANES-1) - plane;
+
+    return  ( (SortKey)( s.tile.first == DEF_TILE ) << 63 )
+          | ( (SortKey)( trans ) << 62 )
+          | ( plane << 58 )
+          | ( (SortKey)( s.shaderID & ((1<<SORT_KEY_SHADER_BITS)-1) ) << 48 )
+          | ( (SortKey)( s.textureID & ((1<<SORT_KEY_TEXTURE_BITS)-1) ) << 32 )
+          | (SortKey)s.seq;
+}
+
+void RenderQueue::radixSort(std::vector< SortKey > & k, std::vector< unsigned int > & s)
+{
+    unsigned int n = k.size();
+    this->keyScratch.resize(n);
+    this->slotScratch.resize(n);
+
+    // Build the histograms of all eight digits in a single pass.
+    unsigned int counts[8][256] = {{0}};
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        SortKey key = k[i];
+        for( unsigned int d = 0; d < 8; ++d ) ++counts[d][(key >> (d*8)) & 0xFF];
+    }
+
+    SortKey * srcKeys = &k[0];
+    unsigned int * srcSlots = &s[0];
+    SortKey * dstKeys = &this->keyScratch[0];
+    unsigned int * dstSlots = &this->slotScratch[0];
+
+    for( unsigned int d = 0; d < 8; ++d )
+    {
+        // If every key has the same digit here, this pass wouldn't move
+        // anything.
+        if( counts[d][(srcKeys[0] >> (d*8)) & 0xFF] == n ) continue;
+
+        // Turn the counts into starting offsets.
+        unsigned int offsets[256];
+        unsigned int total = 0;
+        for( unsigned int b = 0; b < 256; ++b )
+        {
+            offsets[b] = total;
+            total += counts[d][b];
+        }
+
+        // Scatter, which keeps things stable.
+        for( unsigned int i = 0; i < n; ++i )
+        {
+            unsigned int b = (srcKeys[i] >> (d*8)) & 0xFF;
+            dstKeys[offsets[b]] = srcKeys[i];
+            dstSlots[offsets[b]] = srcSlots[i];
+            ++offsets[b];
+        }
+
+        // Ping-pong.
+        SortKey * tk = srcKeys; srcKeys = dstKeys; dstKeys = tk;
+        unsigned int * ts = srcSlots; srcSlots = dstSlots; dstSlots = ts;
+    }
+
+    // If the last pass left the results in the scratch space, swap it in.
+    if( srcKeys != &k[0] )
+    {
+        k.swap(this->keyScratch);
+        s.swap(this->slotScratch);
+    }
+}
+
+int RenderQueue::locate(Tile * t, CellRange & cells)
+{
+    // Tiles that ignore scroll live in screen space. Everything else lives
+    // in its plane's parallax-scaled space, where the position is scaled by
+    // the plane's parallax factor but the size isn't. (That's how they're
+    // drawn.) In that space the whole plane scrolls as one, so a Tile never
+    // has to move cells just because the camera did.
+    int grid = SCREEN_SPACE_GRID;
+    GLfloat x = t->getX(), y = t->getY();
+    if( !t->ignoresScroll() )
+    {
+        grid = t->getPlane() % NUM_PLANES;
+        GLfloat Fp = Tile::getParallaxFactor(t->getPlane());
+        x *= Fp;
+        y *= Fp;
+    }
+    GLfloat hw = t->getBoundsHalfWidth(), hh = t->getBoundsHalfHeight();
+    cells = SpatialGrid::getRange(x-hw, y-hh, x+hw, y+hh);
+    return grid;
+}
+
+void RenderQueue::updateBounds(unsigned int slot)
+{
+    if( slot >= this->boundsX.size() )
+    {
+        unsigned int n = this->slots.size();
+        this->boundsX.resize(n);
+        this->boundsY.resize(n);
+        this->boundsHW.resize(n);
+        this->boundsHH.resize(n);
+        this->boundsView.resize(n);
+    }
+    // Straight out of the TileStore, which already has the bounds worked out.
+    const TileStore * store = Tile::getStore();
+    unsigned int i = this->slots[slot].tile.second->ref.index;
+    this->boundsX[slot] = store->getX(i);
+    this->boundsY[slot] = store->getY(i);
+    this->boundsHW[slot] = store->getHalfW(i);
+    this->boundsHH[slot] = store->getHalfH(i);
+    this->boundsView[slot] = ( store->getFlags(i) & TILE_STORE_IGNORE_SCROLL )
+                           ? SCREEN_SPACE_GRID : store->getPlane(i) % NUM_PLANES;
+}
+
+bool RenderQueue::bakes(const TileWithType & tile)
+{
+    return tile.second->isStatic() && ( tile.first == BG_TILE || tile.first == SCENE_TILE );
+}
+
+void RenderQueue::damage(unsigned int slot)
+{
+    if( this->damagedAll ) return;
+    if( this->damaged.size() >= QUEUE_MAX_DAMAGE )
+    {
+        this->damageAll();
+        return;
+    }
+    DamageBox b;
+    b.view = this->boundsView[slot];
+    b.x = this->boundsX[slot];
+    b.y = this->boundsY[slot];
+    b.hw = this->boundsHW[slot];
+    b.hh = this->boundsHH[slot];
+    this->damaged.push_back(b);
+}
+
+void RenderQueue::index(unsigned int slot)
+{
+    this->updateBounds(slot);
+    this->damage(slot);
+    QueueSlot & s = this->slots[slot];
+
+    // Static Tiles skip the grid. Which chunk they go in depends on their
+    // key, so they have to wait until the next sort to be placed.
+    if( RenderQueue::bakes(s.tile) )
+    {
+        s.grid = -1;
+        s.chunk = CHUNK_PENDING;
+        this->pendingChunks.push_back(slot);
+        return;
+    }
+    s.chunk = -1;
+    s.grid = RenderQueue::locate(s.tile.second, s.cells);
+    this->grids[s.grid].insert(slot, s.cells);
+}
+
+void RenderQueue::unindex(unsigned int slot)
+{
+    QueueSlot & s = this->slots[slot];
+    this->damage(slot);
+
+    // Take it out of its chunk, and if that was the last Tile in there, get
+    // rid of the chunk. (Pending slots are skipped once they're no longer
+    // pending, so there's nothing to do for those.)
+    if( s.chunk >= 0 )
+    {
+        StaticChunk * c = this->chunks[s.chunk];
+        c->remove(s.tile.second);
+        if( c->getTileCount() == 0 )
+        {
+            this->chunkIDs.erase(c->getKey());
+            c->destroy();
+            delete c;
+            this->chunks[s.chunk] = NULL;
+            this->freeChunks.push_back(s.chunk);
+        }
+    }
+    s.chunk = -1;
+
+    if( s.grid < 0 ) return;
+    this->grids[s.grid].remove(slot, s.cells);
+    s.grid = -1;
+}
+
+void RenderQueue::placePending()
+{
+    for( unsigned int i = 0; i < this->pendingChunks.size(); ++i )
+    {
+        unsigned int slot = this->pendingChunks[i];
+        QueueSlot & s = this->slots[slot];
+        if( !s.alive || s.chunk != CHUNK_PENDING ) continue;
+
+        // Chunks are squares of the Tile's view, keyed by where its center
+        // is, so each Tile is in exactly one.
+        ChunkKey k;
+        k.state = s.key & 0xFFFFFFFF00000000ULL;
+        k.view = this->boundsView[slot];
+        GLfloat Fp = ( k.view == SCREEN_SPACE_GRID ) ? 1.0 : Tile::getParallaxFactor((tile_plane)k.view);
+        k.x = (int) floor( this->boundsX[slot]*Fp / STATIC_CHUNK_SIZE );
+        k.y = (int) floor( this->boundsY[slot]*Fp / STATIC_CHUNK_SIZE );
+
+        // Find the chunk, or make it.
+        std::map< ChunkKey, unsigned int >::iterator it = this->chunkIDs.find(k);
+        unsigned int c;
+        if( it != this->chunkIDs.end() ) c = it->second;
+        else
+        {
+            if( !this->freeChunks.empty() )
+            {
+                c = this->freeChunks.back();
+                this->freeChunks.pop_back();
+            }
+            else
+            {
+                c = this->chunks.size();
+                this->chunks.push_back(NULL);
+            }
+            this->chunks[c] = new StaticChunk(k, s.tile.second->getTextureKey(), s.tile.second->getPlane());
+            this->chunkIDs.insert(std::pair<ChunkKey, unsigned int>(k, c));
+        }
+        this->chunks[c]->add(s.tile.second, s.layer);
+        s.chunk = c;
+    }
+    this->pendingChunks.clear();
+}
+
+void RenderQueue::destroyChunks()
+{
+    for( unsigned int i = 0; i < this->chunks.size(); ++i )
+    {
+        if( this->chunks[i] == NULL ) continue;
+        this->chunks[i]->destroy();
+        delete this->chunks[i];
+    }
+    this->chunks.clear();
+    this->freeChunks.clear();
+    this->chunkIDs.clear();
+    this->pendingChunks.clear();
+}
+
+void RenderQueue::reindexAll()
+{
+    this->damageAll();
+    for( unsigned int i = 0; i <= NUM_PLANES; ++i ) this->grids[i].clear();
+    this->destroyChunks();
+    for( unsigned int i = 0; i < this->slots.size(); ++i )
+    {
+        this->slots[i].grid = -1;
+        this->slots[i].chunk = -1;
+        if( this->slots[i].alive ) this->index(i);
+    }
+    this->gridScrollVersion = Tile::getScrollVersion();
+}
+
+TileHandle RenderQueue::insert(tile_type type, Tile * tile)
+{
+    // Grab a free slot if there is one, otherwise make a new one.
+    unsigned int slot;
+    if( !this->freeSlots.empty() )
+    {
+        slot = this->freeSlots.back();
+        this->freeSlots.pop_back();
+    }
     else
     {
-        if( a->getPlane() <= b->getPlane() ) return false;
-        if( a->getPlane() >  b->getPlane() ) return true;
+        slot = this->slots.size();
+        QueueSlot s;
+        s.generation = 0;
+        this->slots.push_back(s);
+    }
+
+    // Move the Tile in. Its render state IDs get interned when its key
+    // is first made.
+    QueueSlot & s = this->slots[slot];
+    s.tile = TileWithType(type, tile);
+    s.alive = true;
+    s.seq = this->nextSeq++;
+    s.shaderKey = NULL;
+    s.textureKey = NULL;
+    s.shaderID = 0;
+    s.textureID = 0;
+    s.layer = -1;
+    s.key = 0;
+    s.visit = 0;
+    s.grid = -1;
+    s.chunk = -1;
+    this->index(slot);
+
+    // Create the handle.
+    TileHandle h;
+    h.queue = this->id;
+    h.slot = slot;
+    h.generation = s.generation;
+
+    // Let the Tile know where it is so it can be removed by pointer, and so
+    // it can tell us when it moves.
+    tile->queueHandle = h;
+    tile->queue = this;
+    return h;
+}
+
+bool RenderQueue::isValid(TileHandle handle) const
+{
+    return handle.queue == this->id
+        && handle.slot < this->slots.size()
+        && this->slots[handle.slot].alive
+        && this->slots[handle.slot].generation == handle.generation;
+}
+
+void RenderQueue::flatten()
+{
+    // Nothing's changed, so what we have is still good.
+    if( !this->dirty ) return;
+
+    // Make a key for every live slot. The dead ones are just skipped.
+    this->keys.clear();
+    this->keySlots.clear();
+    for( unsigned int i = 0; i < this->slots.size(); ++i )
+    {
+        if( !this->slots[i].alive ) continue;
+        this->slots[i].key = this->makeKey(this->slots[i]);
+        this->keys.push_back(this->slots[i].key);
+        this->keySlots.push_back(i);
     }
-    return true; // Just to get rid of the warnings.
+
+    // Sort them.
+    if( !this->keys.empty() ) this->radixSort(this->keys, this->keySlots);
+
+    // Then lay out the Tiles in the order of their keys.
+    this->queue.resize(this->keys.size());
+    for( unsigned int i = 0; i < this->keys.size(); ++i )
+    {
+        this->queue[i] = this->slots[this->keySlots[i]].tile;
+    }
+    this->dirty = false;
 }
 
-void RenderQueue::addToRenderQueue(tile_type type, Tile * tile)
+TileHandle RenderQueue::addToRenderQueue(tile_type type, Tile * tile)
 {
-    // Just tack the Tile on the end since it'll be sorted.
-    this->queue.push_back(TileWithType(type,tile));
-    
-    // Sort the Tiles to cut down on overdraw.
-    std::sort(this->queue.begin(), this->queue.end(), tileSortingPredicate);
-    
-    // Now that it's sorted, we need to re-memoize.
-    this->memoize();
+    // Just stick the Tile in a slot. Sorting waits until the next traversal.
+    this->dirty = true;
+    return this->insert(type, tile);
+}
+
+void RenderQueue::addBatch(tile_type type, Tile ** tiles, unsigned int n)
+{
+    // Make room for everyone up front.
+    if( n > this->freeSlots.size() ) this->slots.reserve(this->slots.size() + n - this->freeSlots.size());
+    for( unsigned int i = 0; i < n; ++i ) this->insert(type, tiles[i]);
+    if( n > 0 ) this->dirty = true;
 }
 
 TileWithType RenderQueue::get(unsigned int index)
 {
+    this->flatten();
     return this->queue.at(index);
 }
 
+SortKey RenderQueue::getKey(unsigned int index)
+{
+    this->flatten();
+    return this->keys.at(index);
+}
+
+GLint RenderQueue::getLayer(unsigned int index)
+{
+    this->flatten();
+    return this->slots[this->keySlots.at(index)].layer;
+}
+
 unsigned int RenderQueue::size()
 {
+    this->flatten();
     return this->queue.size();
 }
 
+bool RenderQueue::removeFromRenderQueue(TileHandle handle)
+{
+    // Stale handles, or handles from some other queue, don't get to
+    // remove anything.
+    if( !this->isValid(handle) ) return false;
+
+    // Free the slot. Bumping the generation keeps the handle from ever
+    // matching again.
+    QueueSlot & s = this->slots[handle.slot];
+    this->unindex(handle.slot);
+    if( s.tile.second->queue == this ) s.tile.second->queue = NULL;
+    s.alive = false;
+    ++s.generation;
+    this->freeSlots.push_back(handle.slot);
+    this->dirty = true;
+    return true;
+}
 
 bool RenderQueue::removeFromRenderQueue(Tile* tile)
 {
-    // Check to make sure the Tile is in the memoization.
-    if ( this->memo.find(tile->getID()) != this->memo.end() )
+    // The Tile knows its own handle. We just need to make sure that the
+    // slot it points to really does still hold this Tile.
+    TileHandle h = tile->queueHandle;
+    if( !this->isValid(h) || this->slots[h.slot].tile.second != tile ) return false;
+    return this->removeFromRenderQueue(h);
+}
+
+void RenderQueue::setAssetManager(AssetManager * assets)
+{
+    this->assets = assets;
+
+    // Every Texture needs to be looked up again, and since that can change
+    // their keys, every static Tile needs to be rebaked.
+    for( unsigned int i = 0; i < this->slots.size(); ++i ) this->slots[i].textureKey = NULL;
+    this->dirty = true;
+    this->reindexAll();
+}
+
+void RenderQueue::setWorkerPool(WorkerPool * workers)
+{
+    this->workers = workers;
+}
+
+void RenderQueue::invalidate()
+{
+    this->dirty = true;
+    this->damageAll();
+}
+
+void RenderQueue::tileChanged(Tile * tile, bool resort)
+{
+    TileHandle h = tile->queueHandle;
+    if( !this->isValid(h) || this->slots[h.slot].tile.second != tile ) return;
+    if( resort ) this->dirty = true;
+    QueueSlot & s = this->slots[h.slot];
+
+    // Static Tiles (or ones that just stopped or started being static) get
+    // taken out of their chunk and put back, which rebakes it. (And the one
+    // they end up in, if it's a different one.) Changes that affect the
+    // key, and so which chunk they belong in, wait for the next sort.
+    if( s.chunk != -1 || RenderQueue::bakes(s.tile) )
+    {
+        this->unindex(h.slot);
+        this->index(h.slot);
+        return;
+    }
+
+    // The bounds always need updating, but only bother the grid if the Tile
+    // actually changed cells. Where it was and where it is both need
+    // redrawing.
+    this->damage(h.slot);
+    this->updateBounds(h.slot);
+    this->damage(h.slot);
+    CellRange cells;
+    int grid = RenderQueue::locate(tile, cells);
+    if( grid == s.grid && cells.x0 == s.cells.x0 && cells.y0 == s.cells.y0
+                       && cells.x1 == s.cells.x1 && cells.y1 == s.cells.y1 ) return;
+    this->unindex(h.slot);
+    this->index(h.slot);
+}
+
+void RenderQueue::tilesChanged(Tile * const * tiles, unsigned int n)
+{
+    // Count the ones that are ours first. Each one damages where it was and
+    // where it is, so if that's going to overflow the damage list anyway,
+    // just damage everything now and skip making boxes nobody will read.
+    unsigned int ours = 0;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        TileHandle h = tiles[i]->queueHandle;
+        if( this->isValid(h) && this->slots[h.slot].tile.second == tiles[i] ) ++ours;
+    }
+    if( ours == 0 ) return;
+    if( this->damaged.size() + 2*ours > QUEUE_MAX_DAMAGE ) this->damageAll();
+
+    for( unsigned int i = 0; i < n; ++i ) this->tileChanged(tiles[i], false);
+}
+
+void RenderQueue::gatherVisible(GLfloat camX, GLfloat camY, GLfloat offX, GLfloat offY)
+{
+    // Make sure the keys are current, that the grids were built with the
+    // current scroll coefficients, and that every static Tile is baked.
+    this->flatten();
+    if( this->gridScrollVersion != Tile::getScrollVersion() ) this->reindexAll();
+    this->placePending();
+
+    // Ask each grid for what's in the cells overlapping the view. In a
+    // plane's space the view is centered on the camera's position times the
+    // plane's parallax factor, pushed over by the offset. (Screen space is
+    // just centered on zero.)
+    CullView & view = this->view;
+    view.extentX = 1.0;
+    view.extentY = 1.0;
+    this->candidates.clear();
+    for( unsigned int g = 0; g <= NUM_PLANES; ++g )
+    {
+        GLfloat Fp = 1.0, cx = 0.0, cy = 0.0;
+        if( g != SCREEN_SPACE_GRID )
+        {
+            Fp = Tile::getParallaxFactor((tile_plane)g);
+            cx = camX*Fp + offX*(1.0-Fp);
+            cy = camY*Fp + offY*(1.0-Fp);
+        }
+        view.scale[g] = Fp;
+        view.centerX[g] = cx;
+        view.centerY[g] = cy;
+        CellRange cells = SpatialGrid::getRange(cx-1.0, cy-1.0, cx+1.0, cy+1.0);
+        this->grids[g].query(cells, this->candidates);
+    }
+
+    // Weed out the duplicates, and pack the bounds of the rest together.
+    ++ this->visit;
+    this->visibleSlots.clear();
+    this->packX.clear();
+    this->packY.clear();
+    this->packHW.clear();
+    this->packHH.clear();
+    this->packView.clear();
+    for( unsigned int i = 0; i < this->candidates.size(); ++i )
+    {
+        unsigned int slot = this->candidates[i];
+        if( this->slots[slot].visit == this->visit ) continue;
+        this->slots[slot].visit = this->visit;
+        this->visibleSlots.push_back(slot);
+        this->packX.push_back(this->boundsX[slot]);
+        this->packY.push_back(this->boundsY[slot]);
+        this->packHW.push_back(CullKernel::packExtent(this->boundsHW[slot]));
+        this->packHH.push_back(CullKernel::packExtent(this->boundsHH[slot]));
+        this->packView.push_back(this->boundsView[slot]);
+    }
+
+    // Then cull them all in one go, and keep what's on screen.
+    this->visibleKeys.clear();
+    unsigned int n = this->visibleSlots.size();
+    if( n > 0 )
+    {
+        CullBounds b;
+        b.x = &this->packX[0];
+        b.y = &this->packY[0];
+        b.halfW = &this->packHW[0];
+        b.halfH = &this->packHH[0];
+        b.view = &this->packView[0];
+        b.count = n;
+        this->onScreen.resize(n);
+        unsigned int visible = CullKernel::cull(b, view, &this->onScreen[0], this->workers);
+
+        // (Compacting in place is fine, since onScreen[i] >= i.)
+        for( unsigned int i = 0; i < visible; ++i )
+        {
+            unsigned int slot = this->visibleSlots[this->onScreen[i]];
+            this->visibleSlots[i] = slot;
+            this->visibleKeys.push_back(this->slots[slot].key);
+        }
+        this->visibleSlots.resize(visible);
+    }
+
+    // Whole StaticChunks are tested on their own. There aren't many of
+    // them, so there's no need for anything clever.
+    for( unsigned int i = 0; i < this->chunks.size(); ++i )
+    {
+        StaticChunk * c = this->chunks[i];
+        if( c == NULL ) continue;
+        c->bake();
+        if( !c->onScreenTest(view) ) continue;
+        this->visibleSlots.push_back(i | VISIBLE_CHUNK_BIT);
+        this->visibleKeys.push_back(c->getKey().state);
+    }
+
+    // Then put them in drawing order.
+    if( !this->visibleKeys.empty() ) this->radixSort(this->visibleKeys, this->visibleSlots);
+}
+
+unsigned int RenderQueue::visibleSize()
+{
+    return this->visibleSlots.size();
+}
+
+TileWithType RenderQueue::getVisible(unsigned int index)
+{
+    unsigned int slot = this->visibleSlots.at(index);
+    if( slot & VISIBLE_CHUNK_BIT ) return TileWithType(SCENE_TILE, (Tile*)NULL);
+    return this->slots[slot].tile;
+}
+
+StaticChunk * RenderQueue::getVisibleChunk(unsigned int index)
+{
+    unsigned int slot = this->visibleSlots.at(index);
+    if( !(slot & VISIBLE_CHUNK_BIT) ) return NULL;
+    return this->chunks[slot & ~VISIBLE_CHUNK_BIT];
+}
+
+const CullView & RenderQueue::getView()
+{
+    return this->view;
+}
+
+SortKey RenderQueue::getVisibleKey(unsigned int index)
+{
+    return this->visibleKeys.at(index);
+}
+
+GLint RenderQueue::getVisibleLayer(unsigned int index)
+{
+    unsigned int slot = this->visibleSlots.at(index);
+    if( slot & VISIBLE_CHUNK_BIT ) return -1;
+    return this->slots[slot].layer;
+}
+
+void RenderQueue::getVisibleRect(unsigned int index, GLfloat * rect)
+{
+    unsigned int slot = this->visibleSlots.at(index);
+    if( slot & VISIBLE_CHUNK_BIT )
     {
-        // If it is we get the index of the item from the memoization.
-        unsigned int index = this->memo[tile->getID()];
-        
-        // Use that index to erase.
-        this->queue.erase(this->queue.begin()+index);
-        
-        // Re-memoize the list.
-        this->memoize();
-        
-        // Oh hey we did it! Return true as a reward.
-        return true;
+        this->chunks[slot & ~VISIBLE_CHUNK_BIT]->getScreenRect(this->view, rect);
+        return;
+    }
+
+    // The same thing the CullKernel works out, only kept this time.
+    unsigned char w = this->boundsView[slot];
+    GLfloat x = this->boundsX[slot]*this->view.scale[w] - this->view.centerX[w];
+    GLfloat y = this->boundsY[slot]*this->view.scale[w] - this->view.centerY[w];
+    rect[0] = x - this->boundsHW[slot];
+    rect[1] = y - this->boundsHH[slot];
+    rect[2] = x + this->boundsHW[slot];
+    rect[3] = y + this->boundsHH[slot];
+}
+
+queue_damage RenderQueue::getDamage(GLfloat * rect)
+{
+    if( this->damagedAll ) return DAMAGE_ALL;
+    if( this->damaged.empty() ) return DAMAGE_NONE;
+
+    // Put every box where getVisibleRect() would, and add them all up.
+    const CullView & v = this->view;
+    rect[0] = rect[1] = 1e30f;
+    rect[2] = rect[3] = -1e30f;
+    for( unsigned int i = 0; i < this->damaged.size(); ++i )
+    {
+        const DamageBox & b = this->damaged[i];
+        GLfloat x = b.x*v.scale[b.view] - v.centerX[b.view];
+        GLfloat y = b.y*v.scale[b.view] - v.centerY[b.view];
+        rect[0] = std::min(rect[0], x - b.hw);
+        rect[1] = std::min(rect[1], y - b.hh);
+        rect[2] = std::max(rect[2], x + b.hw);
+        rect[3] = std::max(rect[3], y + b.hh);
+    }
+    return DAMAGE_PARTIAL;
+}
+
+void RenderQueue::damageAll()
+{
+    this->damagedAll = true;
+    this->damaged.clear();
+}
+
+void RenderQueue::clearDamage()
+{
+    this->damagedAll = false;
+    this->damaged.clear();
+}
+
+void RenderQueue::collectVisibleTiles(std::vector<Tile*> * planes)
+{
+    const CullView & v = this->view;
+    for( unsigned int i = 0; i < this->visibleSlots.size(); ++i )
+    {
+        unsigned int slot = this->visibleSlots[i];
+        if( !(slot & VISIBLE_CHUNK_BIT) )
+        {
+            Tile * t = this->slots[slot].tile.second;
+            planes[t->getPlane() % NUM_PLANES].push_back(t);
+            continue;
+        }
+
+        // The chunk was on screen, but that doesn't mean all of its Tiles
+        // are. Their slots' bounds are kept up to date all the same, so
+        // give each the test the CullKernel would have. (Minus its rounding
+        // up of the extents.)
+        StaticChunk * c = this->chunks[slot & ~VISIBLE_CHUNK_BIT];
+        for( unsigned int j = 0; j < c->getTileCount(); ++j )
+        {
+            Tile * t = c->getTile(j);
+            unsigned int s = t->getQueueHandle().slot;
+            unsigned char w = this->boundsView[s];
+            if( fabs( this->boundsX[s]*v.scale[w] - v.centerX[w] ) > v.extentX + this->boundsHW[s] ) continue;
+            if( fabs( this->boundsY[s]*v.scale[w] - v.centerY[w] ) > v.extentY + this->boundsHH[s] ) continue;
+            planes[t->getPlane() % NUM_PLANES].push_back(t);
+        }
     }
-    
-    // Didn't exist in the queue! Return false to say so.
-    return false;
 }
 
 void RenderQueue::flush()
 {
+    // Free every live slot. We keep the slots themselves around so their
+    // generations keep outdated handles from matching in the future.
+    this->freeSlots.clear();
+    for( unsigned int i = 0; i < this->slots.size(); ++i )
+    {
+        if( this->slots[i].alive )
+        {
+            if( this->slots[i].tile.second->queue == this ) this->slots[i].tile.second->queue = NULL;
+            this->slots[i].grid = -1;
+            this->slots[i].chunk = -1;
+            this->slots[i].alive = false;
+            ++this->slots[i].generation;
+        }
+        this->freeSlots.push_back(i);
+    }
+    this->keys.clear();
+    this->keySlots.clear();
     this->queue.clear();
-    this->memo.clear();
+    this->visibleKeys.clear();
+    this->visibleSlots.clear();
+    for( unsigned int i = 0; i <= NUM_PLANES; ++i ) this->grids[i].clear();
+    this->destroyChunks();
+    this->dirty = false;
+    this->damageAll();
 }
@@ -1,14 +1,38 @@
 #include "Renderer.h"
 #include <algorithm>
+#include <cstddef>
 
 Renderer::Renderer()
 {
     this->tileVertVBO = 0;
     this->tileUvVBO = 0;
+    this->instanceStream = NULL;
+    this->frameBlock = NULL;
+    this->instancingSupported = false;
+    this->instancing = false;
+    this->batchShader = NULL;
+    this->batchTexture = NULL;
+    this->batchProgram = NULL;
+    this->batchState = 0;
+    this->drawn = 0;
+    this->culled = 0;
+    this->drawCalls = 0;
+    this->occlusionCulling = true;
+    this->occluded = 0;
+    this->overdrawMode = false;
+    this->overdrawHeatmap = true;
+    this->dirtyTracking = false;
+    this->lastCamera[0] = this->lastCamera[1] = 0.0;
+    this->lastCamera[2] = this->lastCamera[3] = 0.0;
+    this->redrawAll = true;
+    this->scissoring = false;
+    this->redrawn = 0;
     this->defFB = NULL;
     this->fwdFB = NULL;
     this->time = 0.000;
     this->frameCount = 0;
+    this->instanceEpoch = 0.0;
+    this->instanceEpochFrame = 0;
 }
 
 Renderer::~Renderer()
@@ -30,12 +54,130 @@ void Renderer::initStockShaders()
     this->vitalAssets->addNewShaderStrings("scene_tile_shader",
                                scene_tile_shader_vert,
                                scene_tile_shader_frag);
+    this->vitalAssets->addNewShaderStrings("bg_tile_shader_inst", 
+                               bg_tile_shader_inst_vert,
+                               bg_tile_shader_frag);
+    this->vitalAssets->addNewShaderStrings("scene_tile_shader_inst",
+                               scene_tile_shader_inst_vert,
+                               scene_tile_shader_frag);
     this->vitalAssets->addNewShaderStrings("anim_tile_shader", 
                                anim_tile_shader_vert,
                                anim_tile_shader_frag);
+    this->vitalAssets->addNewShaderStrings("anim_tile_shader_inst", 
+                               anim_tile_shader_inst_vert,
+                               anim_tile_shader_frag);
+    
+    // The texture array variants of the instanced shaders can only be
+    // compiled where texture arrays are supported.
+    if( glewIsSupported("GL_EXT_texture_array") )
+    {
+        this->vitalAssets->addNewShaderStrings("bg_tile_shader_inst_array", 
+                                   bg_tile_shader_inst_vert,
+                                   bg_tile_shader_array_frag);
+        this->vitalAssets->addNewShaderStrings("scene_tile_shader_inst_array",
+                                   scene_tile_shader_inst_vert,
+                                   scene_tile_shader_array_frag);
+        this->vitalAssets->addNewShaderStrings("anim_tile_shader_inst_array", 
+                                   anim_tile_shader_inst_vert,
+                                   anim_tile_shader_array_frag);
+    }
+    this->vitalAssets->addNewShaderStrings("static_chunk_shader",
+                               static_chunk_shader_vert,
+                               scene_tile_shader_frag);
+    if( glewIsSupported("GL_EXT_texture_array") )
+    {
+        this->vitalAssets->addNewShaderStrings("static_chunk_shader_array",
+                                   static_chunk_shader_vert,
+                                   scene_tile_shader_array_frag);
+    }
+    this->vitalAssets->addNewShaderStrings("tile_map_shader",
+                               scene_tile_shader_vert,
+                               tile_map_shader_frag);
     this->vitalAssets->addNewShaderStrings("final_pass_shader",
                                final_pass_shader_vert,
                                final_pass_shader_frag);    
+    this->vitalAssets->addNewShaderStrings("overdraw_heatmap_shader",
+                               final_pass_shader_vert,
+                               overdraw_heatmap_shader_frag);
+    
+    // Now that they're all loaded, look up the uniforms of the ones that get
+    // used for every non-instanced Tile.
+    this->initStockShader(&this->bgShader, "bg_tile_shader");
+    this->initStockShader(&this->sceneShader, "scene_tile_shader");
+    this->initStockShader(&this->animShader, "anim_tile_shader");
+    this->initStockShader(&this->chunkShader, "static_chunk_shader");
+    this->chunkArrayShader.program = NULL;
+    if( this->vitalAssets->get("static_chunk_shader_array") != NULL )
+        this->initStockShader(&this->chunkArrayShader, "static_chunk_shader_array");
+    this->initStockShader(&this->mapShader, "tile_map_shader");
+    this->instanceShaders.clear();
+    this->initInstanceShader("bg_tile_shader_inst");
+    this->initInstanceShader("scene_tile_shader_inst");
+    this->initInstanceShader("anim_tile_shader_inst");
+    
+    // Then remember which ones scroll, so they can be kept up to date with
+    // the camera.
+    const char * scrolling[] = {
+        "bg_tile_shader", "scene_tile_shader", "anim_tile_shader",
+        "bg_tile_shader_inst", "scene_tile_shader_inst", "anim_tile_shader_inst",
+        "bg_tile_shader_inst_array", "scene_tile_shader_inst_array",
+        "anim_tile_shader_inst_array", "tile_map_shader"
+    };
+    this->scrollShaders.clear();
+    for( unsigned int i = 0; i < sizeof(scrolling)/sizeof(scrolling[0]); ++i )
+    {
+        ScrollShader s;
+        s.program = (Shader*) this->vitalAssets->get(scrolling[i]);
+        if( s.program == NULL ) continue;
+        s.camera = s.program->uniform("camera");
+        s.scrollCoeffs = s.program->uniform("scrollCoeffs");
+        this->scrollShaders.push_back(s);
+    }
+}
+
+void Renderer::initStockShader(StockShader * s, const char * key)
+{
+    Shader * program = (Shader*) this->vitalAssets->get(key);
+    s->program = program;
+    s->transform = program->uniform("transform");
+    s->depth = program->uniform("depth");
+    s->texture = program->uniform("texture");
+    s->hFlip = program->uniform("hFlip");
+    s->vFlip = program->uniform("vFlip");
+    s->fractFrameDim = program->uniform("fractFrameDim");
+    s->curFrame = program->uniform("curFrame");
+    s->parallax = program->uniform("parallax");
+    s->plane = program->uniform("plane");
+    s->cells = program->uniform("cells");
+    s->mapSize = program->uniform("mapSize");
+    s->tilesetSize = program->uniform("tilesetSize");
+    s->texDim = program->uniform("texDim");
+    s->time = program->uniform("time");
+    s->frameCount = program->uniform("frameCount");
+}
+
+void Renderer::initInstanceShader(const char * key)
+{
+    InstanceShader s;
+    s.key = key;
+    this->initStockShader(&s.plain, key);
+    std::string arrayKey(key);
+    arrayKey += "_array";
+    s.array.program = NULL;
+    if( this->vitalAssets->get(arrayKey.c_str()) != NULL )
+        this->initStockShader(&s.array, arrayKey.c_str());
+    this->instanceShaders.push_back(s);
+}
+
+InstanceShader * Renderer::getInstanceShader(const char * key)
+{
+    // There are only a few, and this is only asked once a batch.
+    for( unsigned int i = 0; i < this->instanceShaders.size(); ++i )
+    {
+        InstanceShader * s = &this->instanceShaders[i];
+        if( s->key == key || strcmp(s->key, key) == 0 ) return s;
+    }
+    return NULL;
 }
 
 void Renderer::initTileVAO()
@@ -69,7 +211,7 @@ void Renderer::initTileVAO()
     
     // Now that we've created the VBOs, we can create the VAO and tie them together.
     glGenVertexArrays(1, &(this->tileVAO));
-    glBindVertexArray(this->tileVAO);
+    GLStateCache::bindVertexArray(this->tileVAO);
     
     // Attach the vertex VBO to the VAO.
     glBindBuffer(GL_ARRAY_BUFFER, this->tileVertVBO);
@@ -82,6 +224,37 @@ void Renderer::initTileVAO()
     // Tell the VAO which indices we're actually using.
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
+    
+    // If we can, hook up the instance buffer too.
+    this->initInstancing();
+}
+
+void Renderer::initInstancing()
+{
+    // We need to be able to both source attributes per-instance and
+    // draw instances.
+    this->instancingSupported = glewIsSupported("GL_ARB_instanced_arrays")
+                             && glewIsSupported("GL_ARB_draw_instanced");
+    this->instancing = this->instancingSupported;
+    if( !this->instancingSupported ) return;
+    
+    // Create the stream the instances are written to. Each batch gets
+    // copied into it right before it's drawn.
+    this->instanceStream = new StreamBuffer();
+    this->instanceStream->init(INSTANCE_STREAM_SIZE * sizeof(TileInstance));
+    
+    // Attach it to the Tile VAO. (Which should still be bound.) Each
+    // attribute only advances once per instance.
+    GLStateCache::bindVertexArray(this->tileVAO);
+    this->setInstanceAttribs(0);
+    for( GLuint i = INSTANCE_ATTRIB_FIRST; i <= INSTANCE_ATTRIB_LAST; ++i )
+    {
+        glVertexAttribDivisorARB(i, 1);
+        
+        // These only get enabled while an instanced batch is being drawn, so
+        // that the per-Tile path never reads from them.
+        glDisableVertexAttribArray(i);
+    }
 }
 
 bool Renderer::init(GLuint width, GLuint height)
@@ -93,6 +266,10 @@ bool Renderer::init(GLuint width, GLuint height)
     // Next we initialize the RenderQueues.
     this->fwdQueue = new RenderQueue();
     this->defQueue = new RenderQueue();
+    this->fwdQueue->setAssetManager(this->assets);
+    this->defQueue->setAssetManager(this->assets);
+    this->fwdQueue->setWorkerPool(&this->workers);
+    this->defQueue->setWorkerPool(&this->workers);
     
     // Next initialize the Camera.
     this->camera = new Camera(0.0, 0.0);
@@ -104,6 +281,11 @@ bool Renderer::init(GLuint width, GLuint height)
     this->finalPass = new SceneTile();
     this->finalPass->init(0,0,PLANE_PLAYFIELD_B,2,2,false,(char*)"using our own");
     
+    // Create the per-frame uniform block before any shaders get loaded.
+    // (Not that it matters, they only need to know its binding point.)
+    this->frameBlock = new FrameBlock();
+    this->frameBlock->init();
+    
     // Now that that's done, we load the stock shaders for the tiles
     // that use them.
     initStockShaders();
@@ -127,6 +309,7 @@ bool Renderer::resize(GLuint width, GLuint height)
 {
     this->defFB->resize(width, height);
     this->fwdFB->resize(width, height);
+    this->redrawAll = true;
     return true;
 }
 
@@ -192,13 +375,221 @@ unsigned long Renderer::getFrameCount()
     return this->frameCount;
 }
 
-void Renderer::addToRenderQueue(tile_type type, Tile * tile)
+void Renderer::setInstanceAttribs(GLintptr offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, this->instanceStream->getID());
+    GLsizei stride = sizeof(TileInstance);
+    GLubyte * base = (GLubyte*) NULL + offset;
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(TileInstance, row0));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(TileInstance, row1));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, base + offsetof(TileInstance, depth));
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, base + offsetof(TileInstance, anim));
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(TileInstance, frame));
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, stride, base + offsetof(TileInstance, layer));
+}
+
+void Renderer::setInstancing(bool instancing)
+{
+    this->instancing = instancing && this->instancingSupported;
+}
+
+bool Renderer::usesInstancing()
+{
+    return this->instancing;
+}
+
+unsigned int Renderer::getDrawCalls()
+{
+    return this->drawCalls;
+}
+
+const std::vector<Tile*> & Renderer::getVisibleTiles(tile_plane plane)
+{
+    return this->visibleTiles[plane % NUM_PLANES];
+}
+
+void Renderer::setOcclusionCulling(bool occlusionCulling)
+{
+    this->occlusionCulling = occlusionCulling;
+}
+
+bool Renderer::usesOcclusionCulling()
+{
+    return this->occlusionCulling;
+}
+
+unsigned int Renderer::getOccludedCount()
+{
+    return this->occluded;
+}
+
+bool Renderer::setOverdrawMode(bool overdrawMode)
+{
+    if( overdrawMode && !( OverdrawMeter::isSupported() &&
+                           this->fwdFB->hasStencil() && this->defFB->hasStencil() ) )
+        overdrawMode = false;
+    this->overdrawMode = overdrawMode;
+    return overdrawMode;
+}
+
+bool Renderer::usesOverdrawMode()
+{
+    return this->overdrawMode;
+}
+
+void Renderer::setOverdrawHeatmap(bool overdrawHeatmap)
+{
+    this->overdrawHeatmap = overdrawHeatmap;
+}
+
+const OverdrawStats & Renderer::getOverdrawStats(overdraw_pass pass)
+{
+    return this->overdraw.getStats(pass);
+}
+
+void Renderer::setDirtyTracking(bool dirtyTracking)
+{
+    this->dirtyTracking = dirtyTracking;
+    this->redrawAll = true;
+}
+
+bool Renderer::usesDirtyTracking()
+{
+    return this->dirtyTracking;
+}
+
+void Renderer::invalidate()
+{
+    this->redrawAll = true;
+}
+
+unsigned int Renderer::getRedrawnPixels()
+{
+    return this->redrawn;
+}
+
+bool Renderer::setWorkerThreads(unsigned int threads)
+{
+    this->workers.destroy();
+    return this->workers.init(threads);
+}
+
+unsigned int Renderer::getWorkerThreads()
+{
+    return this->workers.getThreadCount();
+}
+
+bool Renderer::animates(const TileWithType & t)
+{
+    return t.first == ANIM_TILE || t.first == DEF_TILE || t.first == FWD_TILE;
+}
+
+void Renderer::gather(RenderQueue * q)
+{
+    // Have the queue find the Tiles that are on screen. Its grids skip
+    // most of the rest without even looking at them, and the CullKernel
+    // takes care of what's left over.
+    Camera * c = this->getCamera();
+    q->gatherVisible(c->getX(), c->getY(), c->getOffX(), c->getOffY());
+    q->collectVisibleTiles(this->visibleTiles);
+}
+
+bool Renderer::beginPass(RenderQueue * q, bool full)
+{
+    GLfloat rect[4];
+    queue_damage d = full ? DAMAGE_ALL : q->getDamage(rect);
+    q->clearDamage();
+    
+    // Animated Tiles change without telling anyone, so wherever they are
+    // is always damaged.
+    for( unsigned int i = 0; d != DAMAGE_ALL && i < q->visibleSize(); ++i )
+    {
+        if( q->getVisibleChunk(i) != NULL || !this->animates(q->getVisible(i)) ) continue;
+        GLfloat r[4];
+        q->getVisibleRect(i, r);
+        if( d == DAMAGE_NONE )
+        {
+            rect[0] = r[0]; rect[1] = r[1];
+            rect[2] = r[2]; rect[3] = r[3];
+            d = DAMAGE_PARTIAL;
+            continue;
+        }
+        rect[0] = std::min(rect[0], r[0]);
+        rect[1] = std::min(rect[1], r[1]);
+        rect[2] = std::max(rect[2], r[2]);
+        rect[3] = std::max(rect[3], r[3]);
+    }
+    if( d == DAMAGE_NONE ) return false;
+    
+    GLint w = this->getWidth(), h = this->getHeight();
+    this->scissoring = ( d == DAMAGE_PARTIAL );
+    if( this->scissoring )
+    {
+        // Round out to whole pixels, with one to spare for filtering.
+        GLint x0 = std::max( (GLint)floor( (rect[0]+1.0)*.5*w ) - 1, 0 );
+        GLint y0 = std::max( (GLint)floor( (rect[1]+1.0)*.5*h ) - 1, 0 );
+        GLint x1 = std::min( (GLint)ceil( (rect[2]+1.0)*.5*w ) + 1, w );
+        GLint y1 = std::min( (GLint)ceil( (rect[3]+1.0)*.5*h ) + 1, h );
+        if( x1 <= x0 || y1 <= y0 ) return false;
+        this->scissor[0] = x0;
+        this->scissor[1] = y0;
+        this->scissor[2] = x1 - x0;
+        this->scissor[3] = y1 - y0;
+        
+        // And back, so renderQueue() can skip what's outside.
+        this->scissorRect[0] = (GLfloat)x0/w*2.0 - 1.0;
+        this->scissorRect[1] = (GLfloat)y0/h*2.0 - 1.0;
+        this->scissorRect[2] = (GLfloat)x1/w*2.0 - 1.0;
+        this->scissorRect[3] = (GLfloat)y1/h*2.0 - 1.0;
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(x0, y0, x1 - x0, y1 - y0);
+    }
+    else
+    {
+        this->scissor[0] = this->scissor[1] = 0;
+        this->scissor[2] = w;
+        this->scissor[3] = h;
+    }
+    this->redrawn += this->scissor[2] * this->scissor[3];
+    
+    // The scissor keeps this to just the part being redrawn.
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return true;
+}
+
+void Renderer::endPass()
+{
+    if( this->scissoring ) glDisable(GL_SCISSOR_TEST);
+    this->scissoring = false;
+}
+
+bool Renderer::occludes(const TileWithType & t)
+{
+    // DefTiles, FwdTiles and TileMapLayers have shaders that might not draw
+    // every fragment, so only the stock Tiles count.
+    if( t.first != BG_TILE && t.first != SCENE_TILE && t.first != ANIM_TILE ) return false;
+    if( t.second->hasTrans() || t.second->getRotation() != 0.0 ) return false;
+    
+    // Tiles can be told they're opaque when their Texture isn't.
+    Texture * tex = (Texture*) this->assets->get(t.second->getTextureKey());
+    return tex != NULL && !tex->hasAlpha();
+}
+
+TileHandle Renderer::addToRenderQueue(tile_type type, Tile * tile)
+{
+    // Hand the Tile off to the queue for the pass it's drawn in.
+    if(type != DEF_TILE)
+        return this->fwdQueue->addToRenderQueue(type, tile);
+    else
+        return this->defQueue->addToRenderQueue(type, tile);
+}
+
+void Renderer::addBatch(tile_type type, Tile ** tiles, unsigned int n)
 {
-    // Just tack the Tile on the end since it'll be sorted.
     if(type != DEF_TILE)
-        this->fwdQueue->addToRenderQueue(type, tile);
+        this->fwdQueue->addBatch(type, tiles, n);
     else
-        this->defQueue->addToRenderQueue(type, tile);
+        this->defQueue->addBatch(type, tiles, n);
 }
 
 bool Renderer::removeFromRenderQueue(Tile* tile)
@@ -214,36 +605,51 @@ bool Renderer::removeFromRenderQueue(Tile* tile)
     else return false;
 }
 
+bool Renderer::removeFromRenderQueue(TileHandle handle)
+{
+    // The handle knows which queue it came from.
+    if( handle.queue == this->fwdQueue->getID() ) return this->fwdQueue->removeFromRenderQueue(handle);
+    if( handle.queue == this->defQueue->getID() ) return this->defQueue->removeFromRenderQueue(handle);
+    return false;
+}
+
 void Renderer::flushRenderQueue()
 {
     this->fwdQueue->flush();
     this->defQueue->flush();
 }
 
-bool Renderer::onScreenTest(Tile * t)
+void Renderer::invalidateRenderQueue()
 {
-	// Get the Tile's projected screen coordinates.
-    float tx = t->getX(), ty = t->getY();
-    if( !t->ignoresScroll() )
-    {
-        Camera * c = this->getCamera();
-        float Fp = t->getParallaxFactor(t->getPlane());
-    	tx = ( tx - c->getX() )*Fp - c->getOffX()*(1.0-Fp);
-    	ty = ( ty - c->getY() )*Fp - c->getOffX()*(1.0-Fp);
-    }
-    	
-    // First we check if the distance between the center of the screen and the
-    // center of the Tile is greater than 1 + the width of the Tile. If so the
-    // Tile is not on screen.
-    if( fabs(tx) > 1.0 + t->getWidth()*.5 ) return false;
-    // We do the same in the vertical axis.
-    if( fabs(ty) > 1.0 + t->getHeight()*.5 ) return false;
+    this->fwdQueue->invalidate();
+    this->defQueue->invalidate();
+}
+
+void Renderer::updateTransforms(const TileRef * refs, const float * xs, const float * ys,
+                                const float * rots, size_t n)
+{
+    if( n == 0 ) return;
+    this->changedTiles.resize(n);
+    unsigned int count = Tile::getStore()->setTransforms(refs, xs, ys, rots, n, &this->changedTiles[0]);
+    if( count == 0 ) return;
     
-    return true;
+    // Each queue skips the Tiles that aren't its own.
+    this->fwdQueue->tilesChanged(&this->changedTiles[0], count);
+    this->defQueue->tilesChanged(&this->changedTiles[0], count);
 }
 
 void Renderer::renderFinalPass(Window * window)
 {
+    // While measuring overdraw the heatmap stands in for the scene.
+    if( this->overdrawMode && this->overdrawHeatmap && this->overdraw.getHeatmap() )
+    {
+        Shader * heatmap = (Shader*) this->vitalAssets->get("overdraw_heatmap_shader");
+        heatmap->use();
+        heatmap->setTextureUniform("counts", this->overdraw.getHeatmap(), 0);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        return;
+    }
+    
     // Get the shader that we need for the final pass' screen quad. If the customCompositor key
 	// is not NULL, and actually represents a value in the AssetManager then it is used for
 	// composition. Otherwise the stock shader is used.
@@ -271,7 +677,8 @@ void Renderer::renderFinalPass(Window * window)
     program->setTextureUniform("defFB", this->defFB->getRenderTexture(), 1);
 	
 	// If we're using a custom shader, we pass in extra stuff that's useful.
-	if( this->customCompositor != NULL )
+	// (Unless it gets it from the frame block.)
+	if( this->customCompositor != NULL && !program->usesFrameBlock() )
 	{
 		Renderer::resolution[0] = (GLfloat)(this->getWidth());
 		Renderer::resolution[1] = (GLfloat)(this->getHeight());
@@ -279,7 +686,7 @@ void Renderer::renderFinalPass(Window * window)
 		Renderer::resolution[0] = (GLfloat)(window->getWidth());  // Oh yeah memory reuse.
 		Renderer::resolution[1] = (GLfloat)(window->getHeight());
 		program->setUniform("winResolution", &resolution);
-		float time = glfwGetTime();
+		float time = this->time;
 		program->setUniform("time", &time);
 	}
     
@@ -287,16 +694,304 @@ void Renderer::renderFinalPass(Window * window)
     glDrawArrays(GL_TRIANGLES, 0, 6); 
 }
 
+void Renderer::updateFrameBlock(Window * window)
+{
+    this->frameBlock->setCamera(this->camera->getX(), this->camera->getY(),
+                                this->camera->getOffX(), this->camera->getOffY());
+    this->frameBlock->setResolution((GLfloat)this->getWidth(), (GLfloat)this->getHeight(),
+                                    (GLfloat)window->getWidth(), (GLfloat)window->getHeight());
+    for( unsigned int i = 0; i < NUM_PLANES; ++i )
+        this->frameBlock->setScroll(i, Tile::getParallaxFactor((tile_plane)i));
+    this->frameBlock->setTime((GLfloat)this->time, (GLfloat)this->frameCount);
+    this->frameBlock->upload();
+}
+
+void Renderer::updateScrollUniforms()
+{
+    GLfloat camera[4] = { this->camera->getX(), this->camera->getY(),
+                          this->camera->getOffX(), this->camera->getOffY() };
+    GLfloat coeffs[NUM_PLANES];
+    for( unsigned int i = 0; i < NUM_PLANES; ++i )
+        coeffs[i] = Tile::getParallaxFactor((tile_plane)i);
+    
+    // The uniforms remember what they were last set to, so a camera that
+    // hasn't moved doesn't cost anything here either.
+    GLfloat * cp = camera;
+    for( unsigned int i = 0; i < this->scrollShaders.size(); ++i )
+    {
+        ScrollShader & s = this->scrollShaders[i];
+        s.program->use();
+        s.program->set(s.camera, &cp);
+        s.program->set(s.scrollCoeffs, coeffs);
+    }
+}
+
+void Renderer::flushInstances()
+{
+    // No batch, no draw.
+    if( this->instances.empty() ) return;
+    
+    // Get the instanced Shader and the Texture of the batch. If the
+    // Texture is in a TextureArray, then the whole array is bound instead
+    // and drawn with the array variant of the Shader.
+    // (Both variants were looked up when the stock shaders were loaded.)
+    StockShader * sh;
+    Texture * tex = (Texture*) this->assets->get(this->batchTexture);
+    if( tex->getArray() == NULL )
+    {
+        sh = &this->batchProgram->plain;
+        sh->program->use();
+        sh->program->setTextureUniform(sh->texture, tex->getID(), 0);
+    }
+    else
+    {
+        sh = &this->batchProgram->array;
+        sh->program->use();
+        GLStateCache::bindTexture(0, GL_TEXTURE_2D_ARRAY_EXT, tex->getArray()->getID());
+        int unit = 0;
+        sh->program->set(sh->texture, &unit);
+    }
+    Shader * program = sh->program;
+    
+    // The instanced AnimTile shader also needs the size of the texture and
+    // the time, so it can work out each instance's frame.
+    Renderer::resolution[0] = (GLfloat)(tex->getWidth());
+    Renderer::resolution[1] = (GLfloat)(tex->getHeight());
+    program->set(sh->texDim, &resolution);
+    // (Relative to when the instances were filled in, like their starts.)
+    float time = (float)( this->time - this->instanceEpoch );
+    float frameCount = (float)( this->frameCount - this->instanceEpochFrame );
+    program->set(sh->time, &time);
+    program->set(sh->frameCount, &frameCount);
+    
+    // Copy the instances into this frame's part of the stream, and point
+    // the instance attributes at them.
+    GLsizeiptr size = this->instances.size() * sizeof(TileInstance);
+    GLintptr offset = this->instanceStream->write(&this->instances[0], size);
+    this->setInstanceAttribs(offset);
+    
+    // Now draw every instance at once.
+    for( GLuint i = INSTANCE_ATTRIB_FIRST; i <= INSTANCE_ATTRIB_LAST; ++i ) glEnableVertexAttribArray(i);
+    glDrawArraysInstancedARB(GL_TRIANGLES, 0, 6, this->instances.size());
+    for( GLuint i = INSTANCE_ATTRIB_FIRST; i <= INSTANCE_ATTRIB_LAST; ++i ) glDisableVertexAttribArray(i);
+    ++ this->drawCalls;
+    
+    this->instances.clear();
+}
+
+void Renderer::renderChunk(RenderQueue * q, StaticChunk * c)
+{
+    // Chunks holding Textures from a TextureArray bind the whole array, just
+    // like an instanced batch would.
+    StockShader * sh = &this->chunkShader;
+    Texture * tex = (Texture*) this->assets->get(c->getTextureKey());
+    if( tex->getArray() != NULL && this->chunkArrayShader.program != NULL )
+    {
+        sh = &this->chunkArrayShader;
+        sh->program->use();
+        GLStateCache::bindTexture(0, GL_TEXTURE_2D_ARRAY_EXT, tex->getArray()->getID());
+        int unit = 0;
+        sh->program->set(sh->texture, &unit);
+    }
+    else
+    {
+        sh->program->use();
+        sh->program->setTextureUniform(sh->texture, tex->getID(), 0);
+    }
+    
+    // Give it the parallax of the view it's in, the same one it was culled
+    // against, and the depth of its plane.
+    const CullView & v = q->getView();
+    int view = c->getKey().view;
+    GLfloat parallax[3] = { v.scale[view], v.centerX[view], v.centerY[view] };
+    GLfloat * pp = parallax;
+    sh->program->set(sh->parallax, &pp);
+    GLfloat depth = Tile::getTileDepth(c->getPlane());
+    sh->program->set(sh->depth, &depth);
+    
+    // Draw it, then put the Tile VAO back for everything else.
+    c->draw();
+    GLStateCache::bindVertexArray(this->tileVAO);
+    ++ this->drawCalls;
+}
+
+/*
+ * What the workers filling in instances need.
+ */
+struct InstanceJob
+{
+    Renderer * renderer;
+    RenderQueue * queue;
+};
+
+void Renderer::prepareInstances(void * job, unsigned int begin, unsigned int end, unsigned int /*part*/)
+{
+    Renderer * r = ((InstanceJob*) job)->renderer;
+    RenderQueue * q = ((InstanceJob*) job)->queue;
+    for( unsigned int j = begin; j < end; ++j )
+    {
+        unsigned int i = r->drawList[j];
+        r->preparedShaders[j] = NULL;
+        if( q->getVisibleChunk(i) != NULL ) continue;
+        
+        // Only the ones that can go in a batch need one.
+        TileWithType t = q->getVisible(i);
+        const char * instShader = t.second->getInstanceShaderKey();
+        if( instShader == NULL ) continue;
+        r->preparedShaders[j] = instShader;
+        t.second->fillInstance(r, &r->prepared[j]);
+        r->prepared[j].layer = q->getVisibleLayer(i);
+    }
+}
+
+void Renderer::renderQueue(RenderQueue * q)
+{
+    // Create a TileWithType to load the queries from the render queue into.
+    TileWithType t;
+    
+    unsigned int drawnHere = 0;
+    
+    // Opaque Tiles come first, nearest plane first, so by the time we get
+    // to anything every opaque Tile on a nearer plane is already in the
+    // occlusion buffer.
+    this->occlusion.clear();
+    GLfloat rect[4];
+    
+    // First work out what actually gets drawn.
+    this->drawList.clear();
+    for(unsigned int i = 0; i < q->visibleSize(); ++i)
+    {
+        StaticChunk * chunk = q->getVisibleChunk(i);
+        t = q->getVisible(i);
+        
+        // When only part of the screen is being redrawn, what's outside
+        // of it can be skipped outright.
+        if( this->scissoring )
+        {
+            q->getVisibleRect(i, rect);
+            if( rect[0] >= this->scissorRect[2] || rect[2] <= this->scissorRect[0] ||
+                rect[1] >= this->scissorRect[3] || rect[3] <= this->scissorRect[1] ) continue;
+        }
+        
+        // Skip whatever's hidden, and add what'll do the hiding.
+        if( this->occlusionCulling )
+        {
+            q->getVisibleRect(i, rect);
+            GLfloat depth = Tile::getTileDepth( chunk ? chunk->getPlane() : t.second->getPlane() );
+            if( this->occlusion.isOccluded(rect[0], rect[1], rect[2], rect[3], depth) )
+            {
+                this->occluded += chunk ? chunk->getTileCount() : 1;
+                continue;
+            }
+            if( chunk == NULL && this->occludes(t) )
+                this->occlusion.addOccluder(rect[0], rect[1], rect[2], rect[3], depth);
+        }
+        this->drawList.push_back(i);
+    }
+    
+    // Then have the workers fill in the instances of everything that can be
+    // batched. Each only touches its own entries, so it all comes out the
+    // same as if one thread had done it.
+    bool instancing = this->instancing && !this->overdrawMode;
+    if( instancing && !this->drawList.empty() )
+    {
+        this->prepared.resize(this->drawList.size());
+        this->preparedShaders.resize(this->drawList.size());
+        this->instanceEpoch = this->time;
+        this->instanceEpochFrame = this->frameCount;
+        InstanceJob job;
+        job.renderer = this;
+        job.queue = q;
+        this->workers.run(Renderer::prepareInstances, &job, this->drawList.size(), INSTANCE_GRAIN);
+    }
+    
+    // Which leaves nothing but drawing, in order.
+    for(unsigned int j = 0; j < this->drawList.size(); ++j)
+    {
+        unsigned int i = this->drawList[j];
+        StaticChunk * chunk = q->getVisibleChunk(i);
+        t = q->getVisible(i);
+        
+        // StaticChunks are drawn where their Tiles would've been, so
+        // whatever's been batched has to go first.
+        if( chunk != NULL )
+        {
+            this->flushInstances();
+            if( this->overdrawMode ) this->overdraw.beginDraw(NULL, chunk);
+            this->renderChunk(q, chunk);
+            if( this->overdrawMode ) this->overdraw.endDraw();
+            drawnHere += chunk->getTileCount();
+            continue;
+        }
+        
+        // See if this Tile can go in a batch.
+        const char * instShader = instancing ? this->preparedShaders[j] : NULL;
+        if( instShader == NULL )
+        {
+            // If not, whatever's been batched so far needs to be drawn
+            // first to keep the order right. Then we render the tile.
+            this->flushInstances();
+            if( this->overdrawMode ) this->overdraw.beginDraw(t.second, NULL);
+            t.second->render(this);
+            if( this->overdrawMode ) this->overdraw.endDraw();
+            ++ this->drawCalls;
+        }
+        else
+        {
+            // The queue already grouped Tiles by Shader and Texture, so all
+            // we have to do is compare the render state bits of their keys.
+            SortKey state = q->getVisibleKey(i) & SORT_KEY_STATE_MASK;
+            if( !this->instances.empty() && 
+                ( state != this->batchState || instShader != this->batchShader ) )
+            {
+                this->flushInstances();
+            }
+            
+            // Start a new batch if need be.
+            if( this->instances.empty() )
+            {
+                this->batchShader = instShader;
+                this->batchProgram = this->getInstanceShader(instShader);
+                this->batchTexture = t.second->getTextureKey();
+                this->batchState = state;
+            }
+            
+            // Add this Tile's instance to it.
+            this->instances.push_back(this->prepared[j]);
+        }
+    
+        // Print out the current tile if necessary.
+        #ifdef T2D_PER_TILE_STATS
+        t.second->report();
+        #endif
+        
+        ++ drawnHere;
+    }
+    
+    // Draw whatever's left over.
+    this->flushInstances();
+    this->drawn += drawnHere;
+    this->culled += q->size() - drawnHere;
+}
+
 void Renderer::render(Window * window)
 {
-    // Counters for how many Tiles were drawn and how many were culled, and
-    // timer values for how long the entire frame, fwd pass, and deferred pass takes.
+    // Timer values for how long the entire frame, fwd pass, and deferred pass takes.
     #ifdef T2D_PER_FRAME_STATS
-    int drawn = 0, culled = 0;
     float total, fwd, def;
     #endif
     
-    float cur = 0;
+    // Reset the counters for how many Tiles were drawn and culled, and how
+    // many draw calls it took.
+    this->drawn = 0;
+    this->culled = 0;
+    this->drawCalls = 0;
+    this->occluded = 0;
+    for( unsigned int i = 0; i < NUM_PLANES; ++i ) this->visibleTiles[i].clear();
+    #ifdef T2D_PER_FRAME_STATS
+    ShaderUniform::resetCounts();
+    GLStateCache::resetCounts();
+    #endif
     
     // Print a header to delineate each frame.
     #ifdef T2D_PER_TILE_STATS
@@ -309,7 +1004,7 @@ void Renderer::render(Window * window)
     #endif
     
     // Bind to the VAO.
-    glBindVertexArray( this->tileVAO );    
+    GLStateCache::bindVertexArray( this->tileVAO );    
     
     // Enable these just in case.
     glEnableVertexAttribArray(0);
@@ -320,51 +1015,49 @@ void Renderer::render(Window * window)
     fwd = glfwGetTime();
     #endif
     
+    // Everything has to be redrawn if the Camera moved, unless we aren't
+    // keeping track and redraw everything anyway. (Measuring overdraw
+    // only makes sense over the whole frame, too.)
+    Camera * c = this->getCamera();
+    bool full = !this->dirtyTracking || this->overdrawMode || this->redrawAll ||
+                c->getX() != this->lastCamera[0] || c->getY() != this->lastCamera[1] ||
+                c->getOffX() != this->lastCamera[2] || c->getOffY() != this->lastCamera[3];
+    this->lastCamera[0] = c->getX();
+    this->lastCamera[1] = c->getY();
+    this->lastCamera[2] = c->getOffX();
+    this->lastCamera[3] = c->getOffY();
+    this->redrawAll = false;
+    this->redrawn = 0;
+    
     // Start drawing to the forward framebuffer.
     this->fwdFB->setAsRenderTarget();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear out what was in the framebuffer.
     
     // Set the current frame time.
     this->time = glfwGetTime();
-
-    // Create a TileWithType to load the queries from the render queues into.
-    TileWithType t;
     
-    // Go through and render the forward tiles.
-    for(unsigned int i = 0; i < this->fwdQueue->size(); ++i)
+    // Everything that's the same for every Tile this frame goes up in one go.
+    this->updateFrameBlock(window);
+    this->updateScrollUniforms();
+    
+    // Move on to the next region of the instance stream.
+    if( this->instancingSupported ) this->instanceStream->beginFrame();
+
+    // Find what's on screen, and clear out whatever part of the
+    // framebuffer needs redrawing. (If any.)
+    this->gather(this->fwdQueue);
+    if( this->beginPass(this->fwdQueue, full) )
     {
-        // Get the current tile.
-        t = fwdQueue->get(i);
-        
-        // If this is a DefTile, then we go ahead and save it for later.
-        //if( t.first == DEF_TILE ) break;
-        
-        // Also if it's offscreen we don't need to render it.
-        if( !this->onScreenTest(t.second) ) 
+        // Start counting, if we're measuring overdraw.
+        if( this->overdrawMode )
         {
-    
-            #ifdef T2D_PER_FRAME_STATS
-            ++ culled;
-            #endif
-            continue;
+            this->overdraw.beginFrame(this->getWidth(), this->getHeight());
+            this->overdraw.beginPass(OVERDRAW_FWD);
         }
-        
-        // Otherwise we render the tile.
-        t.second->render(this);
-    
-        // Print out the current tile if necessary.
-        #ifdef T2D_PER_TILE_STATS
-        t.second->report();
-        #endif
-        
-        #ifdef T2D_PER_FRAME_STATS
-        ++ drawn;
-        #endif
-        
-        // Update how many tiles we've drawn so we can start the second loop at the start of
-        // the DefTiles.
-        ++cur;
-        
+
+        // Go through and render the forward tiles.
+        this->renderQueue(this->fwdQueue);
+        if( this->overdrawMode ) this->overdraw.endPass();
+        this->endPass();
     }
     
     // Clock the forward pass and
@@ -376,34 +1069,24 @@ void Renderer::render(Window * window)
     
     // Now for the DefTiles we flip to the second framebuffer.
     this->defFB->setAsRenderTarget();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Flush again.
     
     // Now that the primary-pass Tiles have been rendered...
-    for(unsigned int i = 0; i < this->defQueue->size(); ++i)
+    this->gather(this->defQueue);
+    if( this->beginPass(this->defQueue, full) )
     {
-        // Get the current Tile.
-        t = this->defQueue->get(i);
-        
-        // Again, if it's offscreen we don't need to render it.
-        if( !this->onScreenTest(t.second) )
+        if( this->overdrawMode ) this->overdraw.beginPass(OVERDRAW_DEF);
+        this->renderQueue(this->defQueue);
+        if( this->overdrawMode )
         {
-            #ifdef T2D_PER_FRAME_STATS
-            ++ culled;
-            #endif
-            continue;
+            this->overdraw.endPass();
+            this->overdraw.endFrame();
         }
-        
-        // Render the DefTile.
-        t.second->render(this);
-    
-        #ifdef T2D_PER_TILE_STATS
-        t.second->report();
-        #endif
-        
-        #ifdef T2D_PER_FRAME_STATS
-        ++ drawn;
-        #endif
+        this->endPass();
     }
+    
+    // That's all the instances this frame.
+    if( this->instancingSupported ) this->instanceStream->endFrame();
+    
     // Clock the final pass.
     #ifdef T2D_PER_FRAME_STATS
     def = glfwGetTime()-def;
@@ -420,8 +1103,16 @@ void Renderer::render(Window * window)
     // Clock the entire frame and actually print the stats to the screen.
     #ifdef T2D_PER_FRAME_STATS
     total = glfwGetTime()-total;
-    std::cout << "Tiles drawn: " << drawn << "\tculled: " << culled << "\ttotal: " << drawn+culled << std::endl;
+    std::cout << "Tiles drawn: " << drawn << "\tculled: " << culled << " (occluded: " << this->occluded << ")"
+              << "\ttotal: " << drawn+culled 
+              << "\tdraw calls: " << drawCalls
+              << "\tpixels redrawn: " << this->redrawn << std::endl;
+    std::cout << "Uniform updates issued: " << ShaderUniform::getIssuedCount()
+              << "\tskipped: " << ShaderUniform::getSkippedCount() << std::endl;
+    std::cout << "GL state changes issued: " << GLStateCache::getIssuedCount()
+              << "\tfiltered: " << GLStateCache::getFilteredCount() << std::endl;
     std::cout << "Frame time: " << total << " (fwd: " << fwd << ") (def: " << def << ")" << std::endl;
+    if( this->overdrawMode ) this->overdraw.report();
     #endif
 }
 
@@ -549,6 +1240,34 @@ FwdTile * Renderer::makeFwdTile(GLfloat x, GLfloat y, tile_plane plane, GLfloat
 							  (char*)texC, (char*)texD, (char*)shader);
 }
 
+TileMapLayer * Renderer::makeTileMapLayer(GLfloat x, GLfloat y, tile_plane plane, GLfloat width,
+                                          GLfloat height, bool normalize, char* texture,
+                                          GLuint tilesetCols, GLuint tilesetRows,
+                                          GLuint cols, GLuint rows)
+{
+    TileMapLayer * t = new TileMapLayer();
+    if(normalize)
+    {
+        width /= this->getWidth()*.5;
+        height /= this->getHeight()*.5;
+        x = (x/(this->getWidth()*.5))-1.0+width*.5;
+        y = (y/(this->getHeight()*.5))-1.0+height*.5;
+    }
+    t->init(x, y, plane, width, height,
+            ((Texture*)(this->getAssetManager()->get(texture)))->hasAlpha(),
+            texture, tilesetCols, tilesetRows, cols, rows);
+    return t;
+}
+
+TileMapLayer * Renderer::makeTileMapLayer(GLfloat x, GLfloat y, tile_plane plane, GLfloat width,
+                                          GLfloat height, bool normalize, const char* texture,
+                                          GLuint tilesetCols, GLuint tilesetRows,
+                                          GLuint cols, GLuint rows)
+{
+	return this->makeTileMapLayer(x,y,plane,width,height,normalize,(char*)texture,
+								  tilesetCols,tilesetRows,cols,rows);
+}
+
 GLfloat Renderer::getTilePxX(Tile * tile)
 {
     return ( tile->getX()+1.0 ) * (this->getWidth() * .5);
@@ -588,7 +1307,14 @@ void Renderer::destroyTileVAO()
 {
     glDeleteBuffers(1, &this->tileVertVBO);
     glDeleteBuffers(1, &this->tileUvVBO);
+    if( this->instanceStream )
+    {
+        this->instanceStream->destroy();
+        delete this->instanceStream;
+        this->instanceStream = NULL;
+    }
     glDeleteVertexArrays(1, &this->tileVAO);
+    GLStateCache::forgetVertexArray(this->tileVAO);
 }
 
 void Renderer::destroyFBOs()
@@ -621,6 +1347,14 @@ void Renderer::destroy()
     this->destroyTileVAO();
     this->destroyFBOs();
     this->destroyRenderQueues();
+    this->overdraw.destroy();
+    this->workers.destroy();
+    if( this->frameBlock )
+    {
+        this->frameBlock->destroy();
+        delete this->frameBlock;
+        this->frameBlock = NULL;
+    }
 }
 
 GLfloat *Renderer::resolution = (GLfloat*) malloc(sizeof(GLfloat)*2);
@@ -17,54 +17,34 @@ void SceneTile::init(GLfloat x, GLfloat y, tile_plane plane, GLfloat width, GLfl
 
 void SceneTile::render(Renderer * r)
 {
-    Shader * program = (Shader*) r->vitalAssets->get("scene_tile_shader");
+    // The stock shader and its uniforms were looked up when it was loaded.
+    StockShader * sh = &r->sceneShader;
+    Shader * program = sh->program;
 
     Texture * tex = (Texture*) r->getAssetManager()->get(this->texture);
     
     program->use();
     
-    // Store the original values so we can put them back.
-    GLfloat x = this->getX();
-    GLfloat y = this->getY();
-    
-    // Get the parallax factor.
-    float Fp = this->getParallaxFactor(this->getPlane());
-    
-	// Now we set up the matrix. There's documentation on how this works.
-    BasicMatrix * pm = this->getPositionMat();
-
-    if( this->ignoresScroll() )
-    {
-		pm->set(0,2, x );
-		pm->set(1,2, y );
-	}
-    else
-    {	
-        Camera * c = r->getCamera();
-		pm->set(0,2, ( x - c->getX() )*Fp - c->getOffX()*(1.0-Fp) );
-		pm->set(1,2, ( y - c->getY() )*Fp - c->getOffY()*(1.0-Fp) );
-	}
-    
-    // Alrighty! Now that that's done, we can feed the matrix to the shader.
-    float * lm = this->getCompoundMat()->getLinear();
-    program->setUniform("transform", &lm);
-    
-    // Reset the BasicMatrix.
-    this->setX(x);
-    this->setY(y);
+    // Hand over where the Tile is in the world. Parallax is the shader's
+    // job now, since it already has the camera.
+    Matrix3 transform = this->getCompoundMat();
+    float * lm = transform.getLinear();
+    program->set(sh->transform, &lm);
+    GLfloat plane = this->getScrollPlane();
+    program->set(sh->plane, &plane);
     
     // Feed this tile's depth information to the shader.
     float depth = Tile::getTileDepth(this->getPlane());
-    program->setUniform("depth", &depth);
+    program->set(sh->depth, &depth);
     
     // Now we set up this texture.
-    program->setTextureUniform("texture", tex->getID(), 0); 
+    program->setTextureUniform(sh->texture, tex->getID(), 0); 
     
     // Let's not forget about texture flip!
     GLuint hFlip = (GLuint)(this->getTextureFlip() & Tile::FLIP_HORIZ);
     GLuint vFlip = (GLuint)(this->getTextureFlip() & Tile::FLIP_VERT);
-    program->setUniform("hFlip", &hFlip);
-    program->setUniform("vFlip", &vFlip);
+    program->set(sh->hFlip, &hFlip);
+    program->set(sh->vFlip, &vFlip);
     
     // Draw the vertex arrays. We want the primitives drawn to be
     // triangles, and to start at the 0th vertex, and to draw a
@@ -80,6 +60,21 @@ char * SceneTile::getTexture()
     return this->texture;
 }
 
+const char * SceneTile::getShaderKey()
+{
+    return "scene_tile_shader";
+}
+
+const char * SceneTile::getTextureKey()
+{
+    return this->texture;
+}
+
+const char * SceneTile::getInstanceShaderKey()
+{
+    return "scene_tile_shader_inst";
+}
+
 void SceneTile::report()
 {
     std::cout << "SceneTile:\t" << this->getID()  
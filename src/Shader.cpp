@@ -4,6 +4,7 @@ Shader::Shader()
 {
     // Default value for the shader ID.
     this->id = 0;
+    this->frameBlock = false;
 }
 
 Shader::~Shader()
@@ -74,12 +75,29 @@ int Shader::parseSourceString(char * src, char *** dst)
 
 void Shader::scanLineForUniforms(char* line)
 {
+    // The frame block isn't a regular uniform, and its members aren't
+    // declared with "uniform", so it gets special treatment.
+    if( strstr(line, "uniform") != NULL && strstr(line, FRAME_BLOCK_NAME) != NULL )
+    {
+        this->bindFrameBlock();
+        return;
+    }
+    
+    // Arrays have their length right after the name, in brackets. (Before
+    // the end of the declaration, and before any initializer.) Look for that
+    // before the tokenizer chews the brackets up.
+    char * bracket = strchr(line, '[');
+    char * end = strchr(line, ';');
+    char * equals = strchr(line, '=');
+    bool array = bracket != NULL && end != NULL && bracket < end &&
+                 ( equals == NULL || bracket < equals );
+    
     // Number of tokens found in the line.
     unsigned int numTokens = 0;
     // The current token.
     char * token;
     // An array to store all the tokens in.
-    char ** tokens = (char**) malloc( sizeof(char*) * 3 );
+    char ** tokens = (char**) malloc( sizeof(char*) * 4 );
     
     // Get the first token.
     token = strtok(line, " ;,/*+-^&!()\n=?.!{}[]"); /**/
@@ -87,8 +105,8 @@ void Shader::scanLineForUniforms(char* line)
     // While we've no more than three tokens, and the prior token
     // read returned something. (Since all uniform declarations
     // in GLSL 1.2 and earlier are three tokens, we only need the
-    // first three.)
-    while( numTokens < 3 && token != NULL )
+    // first three. Arrays need a fourth, their length.)
+    while( numTokens < ( array ? 4 : 3 ) && token != NULL )
     {
         // Store the token.
         tokens[numTokens] = token;
@@ -99,13 +117,17 @@ void Shader::scanLineForUniforms(char* line)
     }
     
     // If we have three tokens, there's a chance this is a uniform!
-    if(numTokens == 3)
+    if(numTokens >= 3)
     {
         // If the first token is "uniform" then the next should be
-        // the type and the third is the variable name.
+        // the type and the third is the variable name. Arrays have to
+        // have a plain number for their length.
         if( strcmp(tokens[0], "uniform") == 0 )
         {
-            this->addUniform( tokens[2], ShaderUniform::getType(tokens[1]) );
+            unsigned int count = 1;
+            if( numTokens == 4 ) count = (unsigned int) atoi(tokens[3]);
+            if( count == 0 ) count = 1;
+            this->addUniform( tokens[2], ShaderUniform::getType(tokens[1]), count );
             #ifdef T2D_SHADER_UNI_INFO
             std::cout << "    -Found uniform: \"" << tokens[2] << "\" (" << tokens[1] << ")" << std::endl;
             #endif
@@ -115,6 +137,22 @@ void Shader::scanLineForUniforms(char* line)
     // Gotta free the token array.
     free(tokens);
 }
+void Shader::bindFrameBlock()
+{
+    // If uniform buffers aren't supported, the shader wouldn't have compiled
+    // in the first place.
+    if( !glewIsSupported("GL_ARB_uniform_buffer_object") ) return;
+    
+    GLuint index = glGetUniformBlockIndex(this->id, FRAME_BLOCK_NAME);
+    if( index == GL_INVALID_INDEX ) return;
+    glUniformBlockBinding(this->id, index, FRAME_BLOCK_BINDING);
+    this->frameBlock = true;
+    
+    #ifdef T2D_SHADER_UNI_INFO
+    std::cout << "    -Found uniform block: \"" << FRAME_BLOCK_NAME << "\"" << std::endl;
+    #endif
+}
+
 void Shader::scanSourceForUniforms(char** source, int numLines)
 {
     // Just go through and check each line.
@@ -242,6 +280,15 @@ shader_error Shader::linkShaders(GLuint vertID, GLuint fragID)
     // Oh wait, we also need to link the UV buffer.
     glBindAttribLocation(this->id, 1, "vertUV");
     
+    // And the per-instance attributes of the instanced Tile shaders. Shaders
+    // that don't declare them don't mind.
+    glBindAttribLocation(this->id, 2, "instRow0");
+    glBindAttribLocation(this->id, 3, "instRow1");
+    glBindAttribLocation(this->id, 4, "instParams");
+    glBindAttribLocation(this->id, 5, "instAnim");
+    glBindAttribLocation(this->id, 6, "instFrame");
+    glBindAttribLocation(this->id, 7, "instLayer");
+    
     // Time to link, guys.
     glLinkProgram(this->id);
     
@@ -404,13 +451,24 @@ shader_error Shader::loadStrings(const char* vertString, const char* fragString)
 
 void Shader::addUniform(char * name, uniform_type type)
 {
+    this->addUniform(name, type, 1);
+}
+
+void Shader::addUniform(char * name, uniform_type type, unsigned int count)
+{
+    // Uniforms declared in both stages only need adding once.
+    if( this->hasUniform(name) ) return;
+    
     // Create a new ShaderUniform.
     ShaderUniform* s = new ShaderUniform();
     // Initialize it.
-    s->init(this->id, type, name);
+    s->init(this->id, type, name, count);
     
-    // Speed date->court->marry the string and add it to uniforms.
-    this->uniforms.insert(std::pair<std::string,ShaderUniform*>(name,s));
+    // Give it the next handle, then speed date->court->marry the string
+    // and the handle.
+    UniformId id = this->uniforms.size();
+    this->uniforms.push_back(s);
+    this->uniformIDs.insert(std::pair<std::string,UniformId>(name,id));
 }
 
 void Shader::addUniform(const char * name, uniform_type type)
@@ -421,12 +479,15 @@ void Shader::addUniform(const char * name, uniform_type type)
 bool Shader::removeUniform(char * name)
 {
     // Check to see if the uniform exists.
-    if( this->uniforms.find(name) != uniforms.end() )
+    std::map<std::string,UniformId>::iterator it = this->uniformIDs.find(name);
+    if( it != this->uniformIDs.end() )
     {
-        // If so, delete the ShaderUniform instance.
-        delete this->uniforms[name];
+        // If so, delete the ShaderUniform instance. Its slot stays behind
+        // so that the other handles don't change.
+        delete this->uniforms[it->second];
+        this->uniforms[it->second] = NULL;
         // Clear it out of the map.
-        this->uniforms.erase(name);
+        this->uniformIDs.erase(it);
         // Return "Yes sir. It's taken care of."
         return true;
     }
@@ -441,7 +502,12 @@ bool Shader::removeUniform(const char * name)
 
 bool Shader::hasUniform(char * name)
 {
-    return ( this->uniforms.find(name) != this->uniforms.end() );
+    return ( this->uniformIDs.find(name) != this->uniformIDs.end() );
+}
+
+bool Shader::usesFrameBlock()
+{
+    return this->frameBlock;
 }
 
 bool Shader::hasUniform(const char * name)
@@ -451,11 +517,13 @@ bool Shader::hasUniform(const char * name)
 
 void Shader::setUniform(char * name, void * data)
 {
-    if(!this->hasUniform(name)) return;
+    // Only look the name up the once.
+    std::map<std::string,UniformId>::iterator it = this->uniformIDs.find(name);
+    if( it == this->uniformIDs.end() ) return;
     // Pretty straightforward really. It's so straight
     // forward that it has not one but two arrows pointing
     // straight forward! How about that.
-    this->uniforms[name]->set(data);
+    this->uniforms[it->second]->set(data);
 }
 
 void Shader::setUniform(const char * name, void * data)
@@ -463,10 +531,22 @@ void Shader::setUniform(const char * name, void * data)
     this->setUniform((char*)name, data);
 }
 
+UniformId Shader::uniform(const char * name)
+{
+    std::map<std::string,UniformId>::iterator it = this->uniformIDs.find(name);
+    if( it == this->uniformIDs.end() ) return NO_UNIFORM;
+    return it->second;
+}
+
+void Shader::set(UniformId id, void * data)
+{
+    if( id < 0 || id >= (UniformId) this->uniforms.size() || this->uniforms[id] == NULL ) return;
+    this->uniforms[id]->set(data);
+}
+
 void Shader::setTextureUniform(char * name, GLuint texID, GLuint texUnit)
 {
-    glActiveTexture(GL_TEXTURE0+texUnit);
-    glBindTexture(GL_TEXTURE_2D, texID);
+    GLStateCache::bindTexture(texUnit, GL_TEXTURE_2D, texID);
     int tu = texUnit;
     //std::cout << this->hasUniform(name) << " asdf" << std::endl;
     this->setUniform(name, &tu);
@@ -477,6 +557,13 @@ void Shader::setTextureUniform(const char * name, GLuint texID, GLuint texUnit)
     this->setTextureUniform((char*)name, texID, texUnit);
 }
 
+void Shader::setTextureUniform(UniformId id, GLuint texID, GLuint texUnit)
+{
+    GLStateCache::bindTexture(texUnit, GL_TEXTURE_2D, texID);
+    int tu = texUnit;
+    this->set(id, &tu);
+}
+
 GLuint Shader::getID()
 {
     return this->id;
@@ -484,7 +571,7 @@ GLuint Shader::getID()
 
 void Shader::use()
 {
-    glUseProgram(this->id);
+    GLStateCache::useProgram(this->id);
 }
 
 const char* Shader::getErrorDesc(shader_error e)
@@ -502,8 +589,10 @@ const char* Shader::getErrorDesc(shader_error e)
 void Shader::destroy()
 {
     glDeleteProgram(this->id);
-    for (std::map<std::string,ShaderUniform*>::iterator it=uniforms.begin(); it!=uniforms.end(); ++it)
-        delete it->second;
+    GLStateCache::forgetProgram(this->id);
+    for (unsigned int i = 0; i < uniforms.size(); ++i)
+        delete uniforms[i];
     uniforms.clear();
+    uniformIDs.clear();
 }
 
@@ -1,7 +1,13 @@
 #include "ShaderUniform.h"
+#include <iostream>
+
+unsigned long ShaderUniform::issuedCount = 0;
+unsigned long ShaderUniform::skippedCount = 0;
 
 ShaderUniform::ShaderUniform()
 {
+    this->count = 1;
+    this->hasShadow = false;
 }
 
 ShaderUniform::~ShaderUniform()
@@ -19,19 +25,83 @@ uniform_type ShaderUniform::getType(char * typeAsText)
     if( strcmp(typeAsText, "mat3") == 0 ) return UNI_MAT3;
     if( strcmp(typeAsText, "mat4") == 0 ) return UNI_MAT4;
     if( strcmp(typeAsText, "sampler2D") == 0 ) return UNI_TEX;
+    if( strcmp(typeAsText, "sampler2DArray") == 0 ) return UNI_TEX;
     return UNI_INT;
 }
 
 void ShaderUniform::init(GLuint program, uniform_type type, char * name)
+{
+    this->init(program, type, name, 1);
+}
+
+void ShaderUniform::init(GLuint program, uniform_type type, char * name, unsigned int count)
 {
     this->type = type;
-    glUseProgram(program);
+    this->count = count ? count : 1;
+    this->hasShadow = false;
+    GLStateCache::useProgram(program);
     this->location = glGetUniformLocation(program, name);    
     
 }
 
+unsigned int ShaderUniform::getValueSize()
+{
+    switch(this->type)
+    {
+        case UNI_FLOAT: return sizeof(float);
+        case UNI_VEC2:  return sizeof(float)*2;
+        case UNI_VEC3:  return sizeof(float)*3;
+        case UNI_VEC4:  return sizeof(float)*4;
+        case UNI_MAT2:  return sizeof(float)*4;
+        case UNI_MAT3:  return sizeof(float)*9;
+        case UNI_MAT4:  return sizeof(float)*16;
+        default:        return sizeof(int);
+    }
+}
+
 void ShaderUniform::set(void * data)
 {
+    // Vectors and matrices are handed to us as a pointer to a pointer to
+    // their values. Everything else is just a pointer to the value.
+    void * value = data;
+    if( this->type != UNI_FLOAT && this->type != UNI_INT && this->type != UNI_TEX )
+        value = *(float**) data;
+    
+    // If it's the same value as last time, there's no need to send it again.
+    // (Arrays too big to keep a copy of are just sent every time.)
+    unsigned int size = this->getValueSize() * this->count;
+    bool shadowed = size <= sizeof(this->shadow);
+    if( shadowed && this->hasShadow && memcmp(this->shadow, value, size) == 0 )
+    {
+        ++ ShaderUniform::skippedCount;
+        return;
+    }
+    if( shadowed ) memcpy(this->shadow, value, size);
+    this->hasShadow = shadowed;
+    ++ ShaderUniform::issuedCount;
+    
+    // Arrays are sent all at once.
+    if( this->count > 1 )
+    {
+        switch(this->type)
+        {
+            case UNI_FLOAT: glUniform1fv(this->location, this->count, (float*) value); break;
+            case UNI_VEC2:  glUniform2fv(this->location, this->count, (float*) value); break;
+            case UNI_VEC3:  glUniform3fv(this->location, this->count, (float*) value); break;
+            case UNI_VEC4:  glUniform4fv(this->location, this->count, (float*) value); break;
+            case UNI_INT:   glUniform1iv(this->location, this->count, (int*) value); break;
+            case UNI_TEX:   glUniform1iv(this->location, this->count, (int*) value); break;
+            case UNI_MAT2:  glUniformMatrix2fv(this->location, this->count, (GLboolean) true, (float*) value); break;
+            case UNI_MAT3:  glUniformMatrix3fv(this->location, this->count, (GLboolean) true, (float*) value); break;
+            case UNI_MAT4:  glUniformMatrix4fv(this->location, this->count, (GLboolean) true, (float*) value); break;
+            default:
+                std::cerr << "Can't set an array uniform of type " << this->type << "." << std::endl;
+                this->hasShadow = false;
+                break;
+        }
+        return;
+    }
+    
     // Welcome to This Is Hinky Sketchy World!
     switch(this->type)
     {
@@ -94,3 +164,24 @@ void ShaderUniform::set(void * data)
             break;
     }
 }
+
+void ShaderUniform::forget()
+{
+    this->hasShadow = false;
+}
+
+unsigned long ShaderUniform::getIssuedCount()
+{
+    return ShaderUniform::issuedCount;
+}
+
+unsigned long ShaderUniform::getSkippedCount()
+{
+    return ShaderUniform::skippedCount;
+}
+
+void ShaderUniform::resetCounts()
+{
+    ShaderUniform::issuedCount = 0;
+    ShaderUniform::skippedCount = 0;
+}
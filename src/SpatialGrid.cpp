@@ -0,0 +1,92 @@
+#include "SpatialGrid.h"
+
+unsigned long long SpatialGrid::cellKey(int x, int y)
+{
+    return ( (unsigned long long)(unsigned int)x << 32 ) | (unsigned int)y;
+}
+
+bool SpatialGrid::removeFrom(std::vector<unsigned int> & list, unsigned int item)
+{
+    for( unsigned int i = 0; i < list.size(); ++i )
+    {
+        if( list[i] == item )
+        {
+            list[i] = list.back();
+            list.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+CellRange SpatialGrid::getRange(float minX, float minY, float maxX, float maxY)
+{
+    CellRange r;
+    r.x0 = (int) floor(minX / GRID_CELL_SIZE);
+    r.y0 = (int) floor(minY / GRID_CELL_SIZE);
+    r.x1 = (int) floor(maxX / GRID_CELL_SIZE);
+    r.y1 = (int) floor(maxY / GRID_CELL_SIZE);
+    return r;
+}
+
+bool SpatialGrid::isOversized(const CellRange & r)
+{
+    // Done in floating point so that absurd ranges don't overflow.
+    return ( (double)(r.x1 - r.x0 + 1) * (double)(r.y1 - r.y0 + 1) ) > GRID_MAX_CELLS;
+}
+
+void SpatialGrid::insert(unsigned int item, const CellRange & r)
+{
+    if( SpatialGrid::isOversized(r) )
+    {
+        this->oversized.push_back(item);
+        return;
+    }
+    for( int x = r.x0; x <= r.x1; ++x )
+        for( int y = r.y0; y <= r.y1; ++y )
+            this->cells[SpatialGrid::cellKey(x,y)].push_back(item);
+}
+
+void SpatialGrid::remove(unsigned int item, const CellRange & r)
+{
+    if( SpatialGrid::isOversized(r) )
+    {
+        SpatialGrid::removeFrom(this->oversized, item);
+        return;
+    }
+    for( int x = r.x0; x <= r.x1; ++x )
+    {
+        for( int y = r.y0; y <= r.y1; ++y )
+        {
+            std::map< unsigned long long, std::vector<unsigned int> >::iterator it;
+            it = this->cells.find(SpatialGrid::cellKey(x,y));
+            if( it == this->cells.end() ) continue;
+            SpatialGrid::removeFrom(it->second, item);
+            
+            // Don't let empty cells pile up as things move around.
+            if( it->second.empty() ) this->cells.erase(it);
+        }
+    }
+}
+
+void SpatialGrid::query(const CellRange & r, std::vector<unsigned int> & out)
+{
+    out.insert(out.end(), this->oversized.begin(), this->oversized.end());
+    if( this->cells.empty() ) return;
+    
+    for( int x = r.x0; x <= r.x1; ++x )
+    {
+        for( int y = r.y0; y <= r.y1; ++y )
+        {
+            std::map< unsigned long long, std::vector<unsigned int> >::iterator it;
+            it = this->cells.find(SpatialGrid::cellKey(x,y));
+            if( it != this->cells.end() ) out.insert(out.end(), it->second.begin(), it->second.end());
+        }
+    }
+}
+
+void SpatialGrid::clear()
+{
+    this->cells.clear();
+    this->oversized.clear();
+}
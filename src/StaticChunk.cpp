@@ -0,0 +1,162 @@
+#include "StaticChunk.h"
+
+StaticChunk::StaticChunk(const ChunkKey & key, const char * textureKey, tile_plane plane)
+{
+    this->key = key;
+    this->textureKey = textureKey;
+    this->plane = plane;
+    this->centerX = 0.0;
+    this->centerY = 0.0;
+    this->halfW = 0.0;
+    this->halfH = 0.0;
+    this->baked = false;
+    this->uploaded = false;
+    this->vbo = 0;
+    this->vao = 0;
+}
+
+StaticChunk::~StaticChunk()
+{
+}
+
+void StaticChunk::add(Tile * tile, GLint layer)
+{
+    this->tiles.push_back(tile);
+    this->layers.push_back(layer);
+    this->baked = false;
+}
+
+bool StaticChunk::remove(Tile * tile)
+{
+    // Order doesn't matter in here, so just swap the last one in.
+    for( unsigned int i = 0; i < this->tiles.size(); ++i )
+    {
+        if( this->tiles[i] != tile ) continue;
+        this->tiles[i] = this->tiles.back();
+        this->layers[i] = this->layers.back();
+        this->tiles.pop_back();
+        this->layers.pop_back();
+        this->baked = false;
+        return true;
+    }
+    return false;
+}
+
+unsigned int StaticChunk::getTileCount()
+{
+    return this->tiles.size();
+}
+
+Tile * StaticChunk::getTile(unsigned int i)
+{
+    return this->tiles[i];
+}
+
+void StaticChunk::bake()
+{
+    if( this->baked ) return;
+
+    // Six vertices a Tile.
+    this->verts.resize(this->tiles.size() * 6);
+    GLfloat x0 = 0.0, y0 = 0.0, x1 = 0.0, y1 = 0.0;
+    for( unsigned int i = 0; i < this->tiles.size(); ++i )
+    {
+        Tile * t = this->tiles[i];
+        GLfloat layer = (this->layers[i] < 0) ? 0.0 : (GLfloat)this->layers[i];
+        t->fillChunkVertices(layer, &this->verts[i*6]);
+
+        // Grow the bounds to fit, the same way the RenderQueue bounds a
+        // lone Tile.
+        GLfloat Fp = t->ignoresScroll() ? 1.0 : Tile::getParallaxFactor(t->getPlane());
+        GLfloat x = t->getX()*Fp, y = t->getY()*Fp;
+        GLfloat hw = t->getBoundsHalfWidth(), hh = t->getBoundsHalfHeight();
+        if( i == 0 || x-hw < x0 ) x0 = x-hw;
+        if( i == 0 || y-hh < y0 ) y0 = y-hh;
+        if( i == 0 || x+hw > x1 ) x1 = x+hw;
+        if( i == 0 || y+hh > y1 ) y1 = y+hh;
+    }
+    this->centerX = (x0+x1)*.5;
+    this->centerY = (y0+y1)*.5;
+    this->halfW = (x1-x0)*.5;
+    this->halfH = (y1-y0)*.5;
+
+    this->baked = true;
+    this->uploaded = false;
+}
+
+bool StaticChunk::onScreenTest(const CullView & view)
+{
+    int v = this->key.view;
+    return fabs(this->centerX - view.centerX[v]) <= view.extentX + this->halfW
+        && fabs(this->centerY - view.centerY[v]) <= view.extentY + this->halfH;
+}
+
+void StaticChunk::getScreenRect(const CullView & view, GLfloat * rect)
+{
+    int v = this->key.view;
+    GLfloat x = this->centerX - view.centerX[v], y = this->centerY - view.centerY[v];
+    rect[0] = x - this->halfW;
+    rect[1] = y - this->halfH;
+    rect[2] = x + this->halfW;
+    rect[3] = y + this->halfH;
+}
+
+void StaticChunk::upload()
+{
+    // Make the buffer and hook it up to a VAO of our own the first time.
+    if( !this->vbo )
+    {
+        glGenBuffers(1, &this->vbo);
+        glGenVertexArrays(1, &this->vao);
+        GLStateCache::bindVertexArray(this->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+        GLsizei stride = sizeof(ChunkVertex);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof(ChunkVertex, pos));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)offsetof(ChunkVertex, uv));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+
+    // These only change when a Tile in here does, which should be next to
+    // never.
+    glBindBuffer(GL_ARRAY_BUFFER, this->vbo);
+    glBufferData(GL_ARRAY_BUFFER, this->verts.size() * sizeof(ChunkVertex),
+                 this->verts.empty() ? NULL : &this->verts[0], GL_STATIC_DRAW);
+    this->uploaded = true;
+}
+
+void StaticChunk::draw()
+{
+    this->bake();
+    if( !this->uploaded ) this->upload();
+    GLStateCache::bindVertexArray(this->vao);
+    glDrawArrays(GL_TRIANGLES, 0, this->verts.size());
+}
+
+const ChunkKey & StaticChunk::getKey()
+{
+    return this->key;
+}
+
+const char * StaticChunk::getTextureKey()
+{
+    return this->textureKey;
+}
+
+tile_plane StaticChunk::getPlane()
+{
+    return this->plane;
+}
+
+void StaticChunk::destroy()
+{
+    if( this->vbo ) glDeleteBuffers(1, &this->vbo);
+    if( this->vao )
+    {
+        glDeleteVertexArrays(1, &this->vao);
+        GLStateCache::forgetVertexArray(this->vao);
+    }
+    this->vbo = 0;
+    this->vao = 0;
+    this->uploaded = false;
+}
@@ -0,0 +1,159 @@
+#include "StreamBuffer.h"
+
+StreamBuffer::StreamBuffer()
+{
+    this->buffer = 0;
+    this->persistent = false;
+    this->mapped = NULL;
+    this->regionSize = 0;
+    this->region = 0;
+    this->offset = 0;
+    for( unsigned int i = 0; i < STREAM_BUFFER_REGIONS; ++i ) this->fences[i] = 0;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+}
+
+void StreamBuffer::allocate(GLsizeiptr regionSize)
+{
+    this->regionSize = regionSize;
+    this->region = 0;
+    this->offset = 0;
+    GLsizeiptr size = regionSize * STREAM_BUFFER_REGIONS;
+
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+    if( this->persistent )
+    {
+        // Immutable storage that stays mapped for as long as it lives. Since
+        // it's coherent, whatever we write is seen by the GPU without any
+        // explicit flushing.
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        this->mapped = (GLubyte*) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+    }
+    else
+    {
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::release()
+{
+    for( unsigned int i = 0; i < STREAM_BUFFER_REGIONS; ++i )
+    {
+        if( this->fences[i] ) glDeleteSync(this->fences[i]);
+        this->fences[i] = 0;
+    }
+    if( this->buffer )
+    {
+        if( this->mapped )
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        glDeleteBuffers(1, &this->buffer);
+    }
+    this->buffer = 0;
+    this->mapped = NULL;
+}
+
+void StreamBuffer::waitForRegion(unsigned int region)
+{
+    if( !this->fences[region] ) return;
+
+    // Keep waiting until the GPU has gotten past the fence. The first wait
+    // flushes, so the fence is sure to eventually be reached.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while( glClientWaitSync(this->fences[region], flags, 1000000) == GL_TIMEOUT_EXPIRED )
+    {
+        flags = 0;
+    }
+    glDeleteSync(this->fences[region]);
+    this->fences[region] = 0;
+}
+
+void StreamBuffer::init(GLsizeiptr regionSize)
+{
+    // We need immutable storage to map persistently, fences to know when
+    // it's safe to write, and glMapBufferRange() to do the mapping.
+    this->persistent = glewIsSupported("GL_ARB_buffer_storage")
+                    && glewIsSupported("GL_ARB_sync")
+                    && glewIsSupported("GL_ARB_map_buffer_range");
+    this->allocate(regionSize);
+}
+
+void StreamBuffer::beginFrame()
+{
+    if( this->persistent )
+    {
+        // Move to the next region, once the GPU is done with it.
+        this->region = (this->region + 1) % STREAM_BUFFER_REGIONS;
+        this->waitForRegion(this->region);
+        this->offset = this->region * this->regionSize;
+    }
+    else
+    {
+        // Orphan the buffer. The driver hands us fresh storage, and the old
+        // storage sticks around until the GPU is done with it.
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        glBufferData(GL_ARRAY_BUFFER, this->regionSize * STREAM_BUFFER_REGIONS, NULL, GL_STREAM_DRAW);
+        this->offset = 0;
+    }
+}
+
+void StreamBuffer::endFrame()
+{
+    if( !this->persistent ) return;
+    if( this->fences[this->region] ) glDeleteSync(this->fences[this->region]);
+    this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLintptr StreamBuffer::write(const void * data, GLsizeiptr size)
+{
+    // Without persistent mapping we only ever need the one region, so the
+    // whole buffer is fair game.
+    GLintptr end = this->persistent ? (this->region + 1) * this->regionSize
+                                    : this->regionSize * STREAM_BUFFER_REGIONS;
+
+    // If this frame has outgrown its region, make a bigger buffer. Draws
+    // already made from the old one still get to read it, since GL keeps
+    // the storage of deleted buffers alive until they're done.
+    if( this->offset + size > end )
+    {
+        GLsizeiptr newSize = this->regionSize * 2;
+        while( newSize < size ) newSize *= 2;
+        this->release();
+        this->allocate(newSize);
+    }
+
+    // Copy the data in.
+    GLintptr at = this->offset;
+    if( this->persistent )
+    {
+        memcpy(this->mapped + at, data, size);
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, at, size, data);
+    }
+    this->offset += size;
+    return at;
+}
+
+GLuint StreamBuffer::getID()
+{
+    return this->buffer;
+}
+
+bool StreamBuffer::isPersistent()
+{
+    return this->persistent;
+}
+
+void StreamBuffer::destroy()
+{
+    this->release();
+}
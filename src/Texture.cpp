@@ -9,6 +9,8 @@ Texture::Texture()
     this->colorType = 0;
     this->colorDepth = 0;
     this->alpha = false;
+    this->array = NULL;
+    this->layer = -1;
 }
 
 Texture::~Texture()
@@ -180,7 +182,7 @@ tex_error Texture::load(char* filename)
     glGenTextures(1,&this->texID);
     
     // Bind to that texture object so that future functions modify it.
-    glBindTexture(GL_TEXTURE_2D, this->texID);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->texID);
     
     // Set up some generic texture parameters.
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -210,7 +212,7 @@ tex_error Texture::createEmpty()
     glGenTextures(1,&this->texID);
     
     // Bind to that texture object so that future functions modify it.
-    glBindTexture(GL_TEXTURE_2D, this->texID);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->texID);
     
     // Set up some generic texture parameters.
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -261,7 +263,29 @@ bool Texture::hasAlpha()
     return this->alpha;
 }
 
+GLenum Texture::getFormat()
+{
+    return this->alpha ? GL_RGBA : GL_RGB;
+}
+
+TextureArray * Texture::getArray()
+{
+    return this->array;
+}
+
+GLint Texture::getLayer()
+{
+    return this->layer;
+}
+
+void Texture::setArrayLayer(TextureArray * array, GLint layer)
+{
+    this->array = array;
+    this->layer = layer;
+}
+
 void Texture::destroy()
 {
     glDeleteTextures(1, &this->texID);
+    GLStateCache::forgetTexture(this->texID);
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "TextureArray.h"
+
+TextureArray::TextureArray()
+{
+    this->texID = 0;
+    this->width = 0;
+    this->height = 0;
+    this->format = GL_RGBA;
+    this->layers = 0;
+    this->capacity = 0;
+    this->maxLayers = 0;
+    this->key[0] = '\0';
+}
+
+TextureArray::~TextureArray()
+{
+}
+
+GLuint TextureArray::getLayerSize()
+{
+    return this->width * this->height * ( (this->format == GL_RGB) ? 3 : 4 );
+}
+
+void TextureArray::allocate(GLuint capacity, GLubyte * data)
+{
+    // Out with the old.
+    if( this->texID )
+    {
+        glDeleteTextures(1, &this->texID);
+        GLStateCache::forgetTexture(this->texID);
+    }
+
+    // In with the new.
+    glGenTextures(1, &this->texID);
+    GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY_EXT, this->texID);
+
+    // Use the same parameters as a regular Texture.
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    // Make room for every layer, then put back the ones that were in use.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, this->format, this->width, this->height,
+                 capacity, 0, this->format, GL_UNSIGNED_BYTE, NULL);
+    if( data != NULL && this->layers > 0 )
+    {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, 0, this->width, this->height,
+                        this->layers, this->format, GL_UNSIGNED_BYTE, data);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    this->capacity = capacity;
+}
+
+void TextureArray::grow()
+{
+    // Texture arrays can't be resized, so we have to read back what's
+    // there and make a bigger one.
+    GLubyte * data = (GLubyte*) malloc( this->getLayerSize() * this->layers );
+    GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY_EXT, this->texID);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D_ARRAY_EXT, 0, this->format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    GLuint newCapacity = this->capacity * 2;
+    if( newCapacity > this->maxLayers ) newCapacity = this->maxLayers;
+    this->allocate(newCapacity, data);
+
+    free(data);
+}
+
+void TextureArray::init(GLuint width, GLuint height, GLenum format, unsigned int index)
+{
+    this->width = width;
+    this->height = height;
+    this->format = format;
+    this->layers = 0;
+
+    // Find out how big we're allowed to get.
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS_EXT, &maxLayers);
+    this->maxLayers = (maxLayers > 0) ? maxLayers : 1;
+
+    // Give ourselves a name.
+    snprintf(this->key, sizeof(this->key), "T2D_TEXTURE_ARRAY_%u", index);
+
+    // Then start out small.
+    GLuint capacity = TEXTURE_ARRAY_INITIAL_LAYERS;
+    if( capacity > this->maxLayers ) capacity = this->maxLayers;
+    this->allocate(capacity, NULL);
+}
+
+bool TextureArray::accepts(GLuint width, GLuint height, GLenum format)
+{
+    return this->width == width
+        && this->height == height
+        && this->format == format
+        && this->layers < this->maxLayers;
+}
+
+GLint TextureArray::addLayer(GLuint sourceID)
+{
+    // Make sure there's room.
+    if( this->layers >= this->maxLayers ) return -1;
+    if( this->layers >= this->capacity ) this->grow();
+
+    // Read the source texture back.
+    GLubyte * data = (GLubyte*) malloc( this->getLayerSize() );
+    GLStateCache::bindTexture(GL_TEXTURE_2D, sourceID);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 0, this->format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // And copy it into the next free layer.
+    GLStateCache::bindTexture(GL_TEXTURE_2D_ARRAY_EXT, this->texID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, this->layers, this->width, this->height,
+                    1, this->format, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    free(data);
+
+    return this->layers++;
+}
+
+GLuint TextureArray::getID()
+{
+    return this->texID;
+}
+
+GLuint TextureArray::getWidth()
+{
+    return this->width;
+}
+
+GLuint TextureArray::getHeight()
+{
+    return this->height;
+}
+
+GLuint TextureArray::getLayerCount()
+{
+    return this->layers;
+}
+
+const char * TextureArray::getKey()
+{
+    return this->key;
+}
+
+void TextureArray::destroy()
+{
+    glDeleteTextures(1, &this->texID);
+    GLStateCache::forgetTexture(this->texID);
+    this->texID = 0;
+}
@@ -1,43 +1,41 @@
 #include "Tile.h"
+#include "Renderer.h"
 #include <iostream>
 
 // Initialize the scrolling coefficients.
-float Tile::scrollCoeffs[10] = {1.5, 1.25, 1.0, 1.0, 1.0, .85, .70, .525, .3, .05};
+float Tile::scrollCoeffs[NUM_PLANES] = {1.5, 1.25, 1.0, 1.0, 1.0, .85, .70, .525, .3, .05};
+unsigned int Tile::scrollVersion = 0;
+TileStore Tile::store;
 
 Tile::Tile()
 {
+    // Not in the store until init(), and generation zero never matches.
+    this->ref.index = 0;
+    this->ref.generation = 0;
 }
 
 Tile::~Tile()
 {
-    delete this->pd;
+    // Whatever destroy() didn't get to. (Releasing twice is fine.)
+    this->destroy();
 }
 
 void Tile::init(GLfloat x, GLfloat y, tile_plane plane, GLfloat width, GLfloat height, bool trans)
 {
-    // Create the position and dimension matrix and initialize it. (The modelview matrix).
-    this->pd = new BasicMatrix(3,3);
-    this->pd->set(0,2, x);
-    this->pd->set(1,2, y);
-    this->pd->set(0,0, width);
-    this->pd->set(1,1, height);
-    
-    // Create and initialize the rotation matrix. Since BasicMatrices are initialized to
-    // an identity matrix, we don't need to set any values.
-    this->r = new BasicMatrix(3,3);
-    this->rotation = 0.0; // We do need to store the current rotation.
-    
-    // Create the swap-space matrix.
-    this->mult = new BasicMatrix(3,3);
-    
-    // Store the other stuff.
-    this->plane = plane;
-    this->trans = trans;
-    this->texFlip = 0;
-    this->ignoreScroll = false;
+    // Get a fresh entry in the store. (Initializing twice shouldn't leak
+    // the first one.) It starts out unrotated, unflipped and scrolling.
+    Tile::store.release(this->ref);
+    this->ref = Tile::store.create(this, x, y, plane, width, height);
+    Tile::store.setFlag(this->ref.index, TILE_STORE_TRANS, trans);
     
     // Oh why look at that our unique identifier is already figured out for us.
     this->id = (unsigned long) this;
+    
+    // We aren't in any RenderQueue yet.
+    this->queueHandle.queue = 0;
+    this->queueHandle.slot = 0;
+    this->queueHandle.generation = 0;
+    this->queue = NULL;
 }
 
 GLfloat Tile::getParallaxFactor(tile_plane plane)
@@ -50,74 +48,121 @@ GLfloat Tile::getTileDepth(tile_plane plane)
     return plane*.0625;
 }
 
+unsigned int Tile::getScrollVersion()
+{
+    return Tile::scrollVersion;
+}
+
+void Tile::notifyQueue(bool resort)
+{
+    if( this->queue != NULL ) this->queue->tileChanged(this, resort);
+}
+
 GLfloat Tile::getX() const
 {
-    return this->pd->get(0,2);
+    return Tile::store.getX(this->ref.index);
 }
 
 GLfloat Tile::getY() const
 {
-    return this->pd->get(1,2);
+    return Tile::store.getY(this->ref.index);
 }
 
 tile_plane Tile::getPlane() const
 {
-    return this->plane;
+    return (tile_plane) Tile::store.getPlane(this->ref.index);
 }
 
 GLfloat Tile::getWidth() const
 {
-    return this->pd->get(0,0);
+    return Tile::store.getWidth(this->ref.index);
 }
 
 GLfloat Tile::getHeight() const
 {
-    return this->pd->get(1,1);
+    return Tile::store.getHeight(this->ref.index);
 }
 
 bool Tile::hasTrans() const
 {
-    return this->trans;
+    return Tile::store.getFlags(this->ref.index) & TILE_STORE_TRANS;
 }
 
 bool Tile::ignoresScroll() const
 {
-	return this->ignoreScroll;
+    return Tile::store.getFlags(this->ref.index) & TILE_STORE_IGNORE_SCROLL;
+}
+
+GLfloat Tile::getScrollPlane() const
+{
+    if( this->ignoresScroll() ) return (GLfloat) NUM_PLANES;
+    return (GLfloat)( this->getPlane() % NUM_PLANES );
+}
+
+bool Tile::isStatic() const
+{
+    return Tile::store.getFlags(this->ref.index) & TILE_STORE_STATIC;
 }
 
 GLuint Tile::getTextureFlip() const
 {
-    return this->texFlip;
+    return Tile::store.getTexFlip(this->ref.index);
 }
 
 GLfloat Tile::getRotation() const
 {
-    return this->rotation;
+    return Tile::store.getRotation(this->ref.index);
 }
 
-BasicMatrix * Tile::getCompoundMat()
+GLfloat Tile::getBoundsHalfWidth() const
 {
-    // Plop the position and dimension matrix into
-    // the swap space matrix.
-    this->mult->set(this->pd);
-    // Multiply that matrix by the rotation matrix.
-    this->mult->multiplyBy(this->r);
-    
-    // Return the swap space matrix. This way neither
-    // of the two important matrices are modified by
-    // this function, and no extraneous matrices are
-    // made.
-    return this->mult;
+    return Tile::store.getHalfW(this->ref.index);
+}
+
+GLfloat Tile::getBoundsHalfHeight() const
+{
+    return Tile::store.getHalfH(this->ref.index);
+}
+
+Matrix3 Tile::getCompoundMat() const
+{
+    return this->getCompoundMat(this->getX(), this->getY());
 }
 
-BasicMatrix * Tile::getPositionMat()
+Matrix3 Tile::getCompoundMat(GLfloat x, GLfloat y) const
 {
-    return this->pd;
+    // The store keeps the rest multiplied out already, so all that's left
+    // is tacking on the translation.
+    const GLfloat * l = Tile::store.getLinear(this->ref.index);
+    Matrix3 m;
+    m.set(0,0, l[0]); m.set(0,1, l[1]); m.set(0,2, x);
+    m.set(1,0, l[2]); m.set(1,1, l[3]); m.set(1,2, y);
+    return m;
 }
 
-BasicMatrix * Tile::getRotationMat()
+Matrix3 Tile::getPositionMat() const
 {
-    return this->r;
+    Matrix3 m;
+    m.set(0,0, this->getWidth());
+    m.set(1,1, this->getHeight());
+    m.set(0,2, this->getX());
+    m.set(1,2, this->getY());
+    return m;
+}
+
+Matrix3 Tile::getRotationMat() const
+{
+    return Matrix3::rotation(this->getRotation());
+}
+
+TileStore * Tile::getStore()
+{
+    return &Tile::store;
+}
+
+TileRef Tile::getRef() const
+{
+    return this->ref;
 }
 
 unsigned long Tile::getID() const
@@ -125,6 +170,11 @@ unsigned long Tile::getID() const
     return this->id;
 }
 
+TileHandle Tile::getQueueHandle() const
+{
+    return this->queueHandle;
+}
+
 float Tile::getScrollCoeff(tile_plane plane) const
 {
     return Tile::scrollCoeffs[plane%NUM_PLANES];
@@ -132,64 +182,142 @@ float Tile::getScrollCoeff(tile_plane plane) const
 
 void Tile::setX(GLfloat x)
 {
-    this->pd->set(0,2, x);
+    Tile::store.setX(this->ref.index, x);
+    this->notifyQueue(false);
 }
 
 void Tile::setY(GLfloat y)
 {
-    this->pd->set(1,2, y);
+    Tile::store.setY(this->ref.index, y);
+    this->notifyQueue(false);
 }
 
 void Tile::setPlane(tile_plane plane)
 {
-    this->plane = plane;
+    Tile::store.setPlane(this->ref.index, plane);
+    this->notifyQueue(true);
 }
 
 void Tile::setWidth(GLfloat width)
 {
-    this->pd->set(0,0, width);
+    Tile::store.setWidth(this->ref.index, width);
+    this->notifyQueue(false);
 }
 
 void Tile::setHeight(GLfloat height)
 {
-    this->pd->set(1,1, height);
+    Tile::store.setHeight(this->ref.index, height);
+    this->notifyQueue(false);
 }
 
 void Tile::setTransparency(bool trans)
 {
-    this->trans = trans;
+    Tile::store.setFlag(this->ref.index, TILE_STORE_TRANS, trans);
+    this->notifyQueue(true);
 }
 
 void Tile::setIgnoreScroll(bool ignoreScroll)
 {
-	this->ignoreScroll = ignoreScroll;
+    Tile::store.setFlag(this->ref.index, TILE_STORE_IGNORE_SCROLL, ignoreScroll);
+    this->notifyQueue(false);
 }
 
 void Tile::setRotation(GLfloat rotation)
 {
-    this->rotation = rotation;
-    this->r->set(0,0,  cos(this->rotation));
-    this->r->set(0,1, -sin(this->rotation));
-    this->r->set(1,0,  sin(this->rotation));
-    this->r->set(1,1,  cos(this->rotation));
+    Tile::store.setRotation(this->ref.index, rotation);
+    this->notifyQueue(false);
 }
 
 void Tile::setTextureFlip(GLuint flip)
 {
-    this->texFlip = flip;
+    Tile::store.setTexFlip(this->ref.index, flip);
+    this->notifyQueue(false);
+}
+
+void Tile::setStatic(bool isStatic)
+{
+    Tile::store.setFlag(this->ref.index, TILE_STORE_STATIC, isStatic);
+    this->notifyQueue(false);
 }
 
 void Tile::setScrollCoeff(tile_plane plane, float coeff)
 {
     scrollCoeffs[plane%NUM_PLANES] = coeff;
+    ++ Tile::scrollVersion;
+}
+
+const char * Tile::getShaderKey()
+{
+    return NULL;
+}
+
+const char * Tile::getTextureKey()
+{
+    return NULL;
+}
+
+const char * Tile::getInstanceShaderKey()
+{
+    return NULL;
+}
+
+void Tile::fillInstance(Renderer * /*r*/, TileInstance * inst)
+{
+    // The transform stays in world space; the vertex shader scrolls it. The
+    // rest of it hasn't changed unless the Tile was resized or rotated, and
+    // the store's kept it up to date if so.
+    const GLfloat * l = Tile::store.getLinear(this->ref.index);
+    inst->row0[0] = l[0];
+    inst->row0[1] = l[1];
+    inst->row0[2] = this->getX();
+    inst->row1[0] = l[2];
+    inst->row1[1] = l[3];
+    inst->row1[2] = this->getY();
+    
+    // Then the depth, texture flip and plane.
+    inst->depth = Tile::getTileDepth(this->getPlane());
+    inst->hFlip = (this->getTextureFlip() & Tile::FLIP_HORIZ) ? 1.0 : 0.0;
+    inst->vFlip = (this->getTextureFlip() & Tile::FLIP_VERT) ? 1.0 : 0.0;
+    inst->plane = this->getScrollPlane();
+}
+
+void Tile::fillChunkVertices(GLfloat layer, ChunkVertex * verts)
+{
+    // The same corners and texture coordinates as the Tile VAO.
+    static const GLfloat corners[6][2] = {
+        {-0.5f, -0.5f}, { 0.5f,  0.5f}, { 0.5f, -0.5f},
+        {-0.5f, -0.5f}, {-0.5f,  0.5f}, { 0.5f,  0.5f}
+    };
+    static const GLfloat uvs[6][2] = {
+        {0.0f, 1.0f}, {1.0f, 0.0f}, {1.0f, 1.0f},
+        {0.0f, 1.0f}, {0.0f, 0.0f}, {1.0f, 0.0f}
+    };
+    
+    // Scale and rotate each corner the way the Tile's matrix would, but
+    // leave the position to the shader so it can apply parallax.
+    const GLfloat * l = Tile::store.getLinear(this->ref.index);
+    GLfloat a = l[0], b = l[1];
+    GLfloat c = l[2], d = l[3];
+    bool hFlip = this->getTextureFlip() & Tile::FLIP_HORIZ;
+    bool vFlip = this->getTextureFlip() & Tile::FLIP_VERT;
+    for( unsigned int i = 0; i < 6; ++i )
+    {
+        verts[i].pos[0] = this->getX();
+        verts[i].pos[1] = this->getY();
+        verts[i].pos[2] = a*corners[i][0] + b*corners[i][1];
+        verts[i].pos[3] = c*corners[i][0] + d*corners[i][1];
+        verts[i].uv[0] = hFlip ? 1.0f-uvs[i][0] : uvs[i][0];
+        verts[i].uv[1] = vFlip ? 1.0f-uvs[i][1] : uvs[i][1];
+        verts[i].uv[2] = layer;
+    }
 }
 
 void Tile::report()
 {
-    std::cout << "Tile: " << this->id  << " trans: " << this->trans << " plane: " << this->plane << std::endl;
+    std::cout << "Tile: " << this->id  << " trans: " << this->hasTrans() << " plane: " << this->getPlane() << std::endl;
 }
 
 void Tile::destroy()
 {
-    delete this->pd;
+    Tile::store.release(this->ref);
 }
@@ -0,0 +1,236 @@
+#include "TileMapLayer.h"
+
+TileMapLayer::TileMapLayer()
+: Tile()
+{
+    this->texture = NULL;
+    this->tilesetCols = 1;
+    this->tilesetRows = 1;
+    this->cols = 0;
+    this->rows = 0;
+    this->cellTex = 0;
+    this->dirtyX0 = this->dirtyY0 = 0;
+    this->dirtyX1 = this->dirtyY1 = 0;
+}
+
+TileMapLayer::~TileMapLayer()
+{
+}
+
+void TileMapLayer::init(GLfloat x, GLfloat y, tile_plane plane, GLfloat width, GLfloat height,
+                        bool trans, char * texture, GLuint tilesetCols, GLuint tilesetRows,
+                        GLuint cols, GLuint rows)
+{
+    Tile::init(x, y, plane, width, height, trans);
+    this->texture = texture;
+    this->tilesetCols = (tilesetCols > 0) ? tilesetCols : 1;
+    this->tilesetRows = (tilesetRows > 0) ? tilesetRows : 1;
+
+    // Don't ask for a bigger index texture than we can get.
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    GLuint limit = TILE_MAP_MAX_CELLS;
+    if( maxSize > 0 && (GLuint)maxSize < limit ) limit = maxSize;
+    if( cols > limit ) cols = limit;
+    if( rows > limit ) rows = limit;
+    this->cols = (cols > 0) ? cols : 1;
+    this->rows = (rows > 0) ? rows : 1;
+
+    // Every cell starts out empty.
+    this->cells.assign(this->cols * this->rows, 0);
+    this->dirtyX0 = this->dirtyY0 = 0;
+    this->dirtyX1 = this->dirtyY1 = 0;
+
+    // Integer textures need GL 3, so each index gets split into two bytes
+    // of a luminance-alpha texture instead. It has to be sampled exactly,
+    // hence nearest filtering and no wrapping.
+    glGenTextures(1, &this->cellTex);
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->cellTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    // Zeroes all around are empty cells, so that's what we start with.
+    this->staging.assign(this->cols * this->rows * 2, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8_ALPHA8, this->cols, this->rows, 0,
+                 GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, &this->staging[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // That's a lot of zeroes to keep around for nothing.
+    std::vector<GLubyte>().swap(this->staging);
+}
+
+void TileMapLayer::markDirty(GLuint x, GLuint y, GLuint w, GLuint h)
+{
+    if( this->dirtyX0 >= this->dirtyX1 )
+    {
+        this->dirtyX0 = x;
+        this->dirtyY0 = y;
+        this->dirtyX1 = x + w;
+        this->dirtyY1 = y + h;
+        
+        // The first edit since the last upload is the one that means the
+        // layer needs redrawing.
+        this->notifyQueue(false);
+        return;
+    }
+    if( x < this->dirtyX0 ) this->dirtyX0 = x;
+    if( y < this->dirtyY0 ) this->dirtyY0 = y;
+    if( x + w > this->dirtyX1 ) this->dirtyX1 = x + w;
+    if( y + h > this->dirtyY1 ) this->dirtyY1 = y + h;
+}
+
+void TileMapLayer::upload()
+{
+    if( this->dirtyX0 >= this->dirtyX1 ) return;
+
+    // Pack the dirty cells into low and high bytes.
+    GLuint w = this->dirtyX1 - this->dirtyX0;
+    GLuint h = this->dirtyY1 - this->dirtyY0;
+    this->staging.resize(w * h * 2);
+    GLubyte * out = &this->staging[0];
+    for( GLuint y = this->dirtyY0; y < this->dirtyY1; ++y )
+    {
+        const GLushort * row = &this->cells[y * this->cols];
+        for( GLuint x = this->dirtyX0; x < this->dirtyX1; ++x )
+        {
+            *out++ = (GLubyte)( row[x] & 0xFF );
+            *out++ = (GLubyte)( row[x] >> 8 );
+        }
+    }
+
+    // And send them off.
+    GLStateCache::bindTexture(GL_TEXTURE_2D, this->cellTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, this->dirtyX0, this->dirtyY0, w, h,
+                    GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, &this->staging[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    this->dirtyX0 = this->dirtyX1 = 0;
+    this->dirtyY0 = this->dirtyY1 = 0;
+}
+
+void TileMapLayer::setCell(GLuint x, GLuint y, GLushort index)
+{
+    if( x >= this->cols || y >= this->rows ) return;
+    if( this->cells[y * this->cols + x] == index ) return;
+    this->cells[y * this->cols + x] = index;
+    this->markDirty(x, y, 1, 1);
+}
+
+void TileMapLayer::setCells(GLuint x, GLuint y, GLuint w, GLuint h, const GLushort * indices)
+{
+    if( x >= this->cols || y >= this->rows ) return;
+
+    // Clip the rectangle to the map, but keep stepping through the indices
+    // with the width we were given.
+    GLuint stride = w;
+    if( w > this->cols - x ) w = this->cols - x;
+    if( h > this->rows - y ) h = this->rows - y;
+    if( w == 0 || h == 0 ) return;
+
+    for( GLuint j = 0; j < h; ++j )
+    {
+        memcpy(&this->cells[(y + j) * this->cols + x], indices + j * stride,
+               w * sizeof(GLushort));
+    }
+    this->markDirty(x, y, w, h);
+}
+
+GLushort TileMapLayer::getCell(GLuint x, GLuint y)
+{
+    if( x >= this->cols || y >= this->rows ) return 0;
+    return this->cells[y * this->cols + x];
+}
+
+GLuint TileMapLayer::getColumns()
+{
+    return this->cols;
+}
+
+GLuint TileMapLayer::getRows()
+{
+    return this->rows;
+}
+
+void TileMapLayer::render(Renderer * r)
+{
+    // Get any edits onto the GPU first.
+    this->upload();
+
+    StockShader * sh = &r->mapShader;
+    Shader * program = sh->program;
+
+    Texture * tex = (Texture*) r->getAssetManager()->get(this->texture);
+
+    program->use();
+
+    // The map is just one big quad, so it's placed (and scrolled) exactly
+    // as a SceneTile would be.
+    Matrix3 transform = this->getCompoundMat();
+    float * lm = transform.getLinear();
+    program->set(sh->transform, &lm);
+    GLfloat plane = this->getScrollPlane();
+    program->set(sh->plane, &plane);
+
+    float depth = Tile::getTileDepth(this->getPlane());
+    program->set(sh->depth, &depth);
+
+    // The tileset goes in the first texture unit, and the cells the second.
+    program->setTextureUniform(sh->texture, tex->getID(), 0);
+    program->setTextureUniform(sh->cells, this->cellTex, 1);
+
+    // The shader needs to know how to carve up both of them.
+    GLfloat mapSize[2] = { (GLfloat)this->cols, (GLfloat)this->rows };
+    GLfloat tilesetSize[2] = { (GLfloat)this->tilesetCols, (GLfloat)this->tilesetRows };
+    GLfloat * mp = mapSize;
+    GLfloat * tp = tilesetSize;
+    program->set(sh->mapSize, &mp);
+    program->set(sh->tilesetSize, &tp);
+
+    // Texture flip flips the whole map.
+    GLuint hFlip = (GLuint)(this->getTextureFlip() & Tile::FLIP_HORIZ);
+    GLuint vFlip = (GLuint)(this->getTextureFlip() & Tile::FLIP_VERT);
+    program->set(sh->hFlip, &hFlip);
+    program->set(sh->vFlip, &vFlip);
+
+    // One quad, the whole map.
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+char * TileMapLayer::getTexture()
+{
+    return this->texture;
+}
+
+const char * TileMapLayer::getShaderKey()
+{
+    return "tile_map_shader";
+}
+
+const char * TileMapLayer::getTextureKey()
+{
+    return this->texture;
+}
+
+void TileMapLayer::destroy()
+{
+    if( this->cellTex )
+    {
+        glDeleteTextures(1, &this->cellTex);
+        GLStateCache::forgetTexture(this->cellTex);
+    }
+    this->cellTex = 0;
+    Tile::destroy();
+}
+
+void TileMapLayer::report()
+{
+    std::cout << "TileMapLayer:\t" << this->getID()
+              << " trans: " << this->hasTrans()
+              << " plane: " << this->getPlane()
+              << " cells: " << this->cols << "x" << this->rows
+              << " tex: " << this->texture << std::endl;
+}
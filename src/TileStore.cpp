@@ -0,0 +1,393 @@
+#include "TileStore.h"
+#include <cstring>
+
+// Only x86 compilers that let individual functions target AVX2 get the
+// vectorized sinCos(), just like the CullKernel.
+#if !defined(T2D_NO_SIMD) && defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+    #include <immintrin.h>
+    #if defined(__SSE2__)
+        #define SINCOS_HAVE_SSE2
+    #endif
+    #define SINCOS_HAVE_AVX2
+#endif
+
+// The constants of the polynomials (Cephes' sinf and cosf), and pi/4 split
+// into three parts so the range reduction doesn't lose anything.
+#define SINCOS_FOPI 1.27323954473516f
+#define SINCOS_DP1 -0.78515625f
+#define SINCOS_DP2 -2.4187564849853515625e-4f
+#define SINCOS_DP3 -3.77489497744594108e-8f
+#define SINCOS_S0 -1.9515295891e-4f
+#define SINCOS_S1  8.3321608736e-3f
+#define SINCOS_S2 -1.6666654611e-1f
+#define SINCOS_C0  2.443315711809948e-5f
+#define SINCOS_C1 -1.388731625493765e-3f
+#define SINCOS_C2  4.166664568298827e-2f
+
+cull_path TileStore::sinCosPath = CULL_SCALAR;
+bool TileStore::sinCosDetected = false;
+
+/**
+ * @brief Works out the sine and cosine of one angle. The vectorized versions
+ *        do this same math, step for step, in each lane.
+ */
+static inline void sinCosLane(GLfloat a, GLfloat * s, GLfloat * c)
+{
+    GLfloat x = fabsf(a);
+    if( !( x <= TILE_STORE_SINCOS_MAX ) )
+    {
+        *s = sinf(a);
+        *c = cosf(a);
+        return;
+    }
+
+    // Find which eighth of the circle we're in (rounded up to an even one),
+    // and how far from the middle of it.
+    int j = (int)( x * SINCOS_FOPI );
+    j = ( j + 1 ) & ~1;
+    GLfloat y = (GLfloat) j;
+    x = x + y * SINCOS_DP1;
+    x = x + y * SINCOS_DP2;
+    x = x + y * SINCOS_DP3;
+    GLfloat z = x * x;
+
+    GLfloat pc = SINCOS_C0;
+    pc = pc * z + SINCOS_C1;
+    pc = pc * z + SINCOS_C2;
+    pc = pc * z;
+    pc = pc * z;
+    pc = pc - z * 0.5f;
+    pc = pc + 1.0f;
+
+    GLfloat ps = SINCOS_S0;
+    ps = ps * z + SINCOS_S1;
+    ps = ps * z + SINCOS_S2;
+    ps = ps * z;
+    ps = ps * x;
+    ps = ps + x;
+
+    // Every other quarter turn the two swap, then put the signs back.
+    bool swap = ( j & 2 ) != 0;
+    GLfloat sv = swap ? pc : ps;
+    GLfloat cv = swap ? ps : pc;
+    // (The sign bit, rather than a < 0, so -0 gives -0 like it should.)
+    unsigned int bits;
+    memcpy(&bits, &a, sizeof(bits));
+    if( ( ( bits >> 31 ) != 0 ) != ( ( j & 4 ) != 0 ) ) sv = -sv;
+    if( ( ( j - 2 ) & 4 ) == 0 ) cv = -cv;
+    *s = sv;
+    *c = cv;
+}
+
+TileStore::TileStore()
+{
+    this->live = 0;
+}
+
+void TileStore::updateTransform(unsigned int i)
+{
+    // The position matrix only has scale and translation, so its product
+    // with the rotation matrix is just the rotation scaled row by row.
+    GLfloat * m = &this->linear[4*i];
+    m[0] =  this->width[i] * this->cosR[i];
+    m[1] = -this->width[i] * this->sinR[i];
+    m[2] =  this->height[i] * this->sinR[i];
+    m[3] =  this->height[i] * this->cosR[i];
+
+    // The unit square's corners reach out half of each row's magnitudes.
+    this->halfW[i] = .5f * ( fabs(m[0]) + fabs(m[1]) );
+    this->halfH[i] = .5f * ( fabs(m[2]) + fabs(m[3]) );
+}
+
+TileRef TileStore::create(Tile * owner, GLfloat x, GLfloat y, unsigned char plane,
+                          GLfloat width, GLfloat height)
+{
+    // Reuse a free entry if there is one, otherwise grow every column.
+    unsigned int i;
+    if( !this->freeEntries.empty() )
+    {
+        i = this->freeEntries.back();
+        this->freeEntries.pop_back();
+    }
+    else
+    {
+        i = this->owner.size();
+        unsigned int n = i + 1;
+        this->x.resize(n);
+        this->y.resize(n);
+        this->width.resize(n);
+        this->height.resize(n);
+        this->rotation.resize(n);
+        this->cosR.resize(n);
+        this->sinR.resize(n);
+        this->linear.resize(4*n);
+        this->halfW.resize(n);
+        this->halfH.resize(n);
+        this->plane.resize(n);
+        this->flags.resize(n);
+        this->texFlip.resize(n);
+        this->owner.resize(n);
+        this->generation.resize(n, 1);
+    }
+
+    this->x[i] = x;
+    this->y[i] = y;
+    this->width[i] = width;
+    this->height[i] = height;
+    this->rotation[i] = 0.0f;
+    this->cosR[i] = 1.0f;
+    this->sinR[i] = 0.0f;
+    this->plane[i] = plane;
+    this->flags[i] = TILE_STORE_ALIVE;
+    this->texFlip[i] = 0;
+    this->owner[i] = owner;
+    this->updateTransform(i);
+    ++ this->live;
+
+    TileRef ref;
+    ref.index = i;
+    ref.generation = this->generation[i];
+    return ref;
+}
+
+void TileStore::release(TileRef ref)
+{
+    if( !this->isValid(ref) ) return;
+    this->flags[ref.index] = 0;
+    this->owner[ref.index] = NULL;
+
+    // Skip zero on the way around, so it never looks valid.
+    if( ++ this->generation[ref.index] == 0 ) this->generation[ref.index] = 1;
+    this->freeEntries.push_back(ref.index);
+    -- this->live;
+}
+
+bool TileStore::isValid(TileRef ref) const
+{
+    return ref.index < this->generation.size()
+        && this->generation[ref.index] == ref.generation
+        && ( this->flags[ref.index] & TILE_STORE_ALIVE );
+}
+
+unsigned int TileStore::capacity() const
+{
+    return this->owner.size();
+}
+
+unsigned int TileStore::size() const
+{
+    return this->live;
+}
+
+void TileStore::sinCosScalar(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t first, size_t n)
+{
+    for( size_t i = first; i < n; ++i ) sinCosLane(angles[i], &s[i], &c[i]);
+}
+
+#ifdef SINCOS_HAVE_SSE2
+size_t TileStore::sinCosSSE2(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n)
+{
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2), four = _mm_set1_epi32(4);
+    const __m128 maxAngle = _mm_set1_ps(TILE_STORE_SINCOS_MAX);
+    size_t i = 0;
+    for( ; i + 4 <= n; i += 4 )
+    {
+        __m128 a = _mm_loadu_ps(angles + i);
+        __m128 x = _mm_andnot_ps(signMask, a);
+        __m128 sinSign = _mm_and_ps(a, signMask);
+
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(SINCOS_FOPI)));
+        j = _mm_andnot_si128(one, _mm_add_epi32(j, one));
+        __m128 y = _mm_cvtepi32_ps(j);
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP1)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP2)));
+        x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP3)));
+        __m128 z = _mm_mul_ps(x, x);
+
+        __m128 pc = _mm_set1_ps(SINCOS_C0);
+        pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(SINCOS_C1));
+        pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(SINCOS_C2));
+        pc = _mm_mul_ps(pc, z);
+        pc = _mm_mul_ps(pc, z);
+        pc = _mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+        pc = _mm_add_ps(pc, _mm_set1_ps(1.0f));
+
+        __m128 ps = _mm_set1_ps(SINCOS_S0);
+        ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(SINCOS_S1));
+        ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(SINCOS_S2));
+        ps = _mm_mul_ps(ps, z);
+        ps = _mm_mul_ps(ps, x);
+        ps = _mm_add_ps(ps, x);
+
+        // SSE2 can't blend, so mask and combine.
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), two));
+        __m128 sv = _mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps));
+        __m128 cv = _mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc));
+        sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29)));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, two), four), 29));
+        _mm_storeu_ps(s + i, _mm_xor_ps(sv, sinSign));
+        _mm_storeu_ps(c + i, _mm_xor_ps(cv, cosSign));
+
+        // Angles too big for the polynomial (or not numbers at all) get
+        // done over the slow way.
+        int ok = _mm_movemask_ps(_mm_cmple_ps(_mm_andnot_ps(signMask, a), maxAngle));
+        if( ok != 0xF ) TileStore::sinCosScalar(angles, s, c, i, i + 4);
+    }
+    return i;
+}
+#else
+size_t TileStore::sinCosSSE2(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n)
+{
+    return 0;
+}
+#endif
+
+#ifdef SINCOS_HAVE_AVX2
+__attribute__((target("avx2")))
+size_t TileStore::sinCosAVX2(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n)
+{
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    const __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2), four = _mm256_set1_epi32(4);
+    const __m256 maxAngle = _mm256_set1_ps(TILE_STORE_SINCOS_MAX);
+    size_t i = 0;
+    for( ; i + 8 <= n; i += 8 )
+    {
+        __m256 a = _mm256_loadu_ps(angles + i);
+        __m256 x = _mm256_andnot_ps(signMask, a);
+        __m256 sinSign = _mm256_and_ps(a, signMask);
+
+        __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(SINCOS_FOPI)));
+        j = _mm256_andnot_si256(one, _mm256_add_epi32(j, one));
+        __m256 y = _mm256_cvtepi32_ps(j);
+        x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP1)));
+        x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP2)));
+        x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP3)));
+        __m256 z = _mm256_mul_ps(x, x);
+
+        __m256 pc = _mm256_set1_ps(SINCOS_C0);
+        pc = _mm256_add_ps(_mm256_mul_ps(pc, z), _mm256_set1_ps(SINCOS_C1));
+        pc = _mm256_add_ps(_mm256_mul_ps(pc, z), _mm256_set1_ps(SINCOS_C2));
+        pc = _mm256_mul_ps(pc, z);
+        pc = _mm256_mul_ps(pc, z);
+        pc = _mm256_sub_ps(pc, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+        pc = _mm256_add_ps(pc, _mm256_set1_ps(1.0f));
+
+        __m256 ps = _mm256_set1_ps(SINCOS_S0);
+        ps = _mm256_add_ps(_mm256_mul_ps(ps, z), _mm256_set1_ps(SINCOS_S1));
+        ps = _mm256_add_ps(_mm256_mul_ps(ps, z), _mm256_set1_ps(SINCOS_S2));
+        ps = _mm256_mul_ps(ps, z);
+        ps = _mm256_mul_ps(ps, x);
+        ps = _mm256_add_ps(ps, x);
+
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, two), two));
+        __m256 sv = _mm256_blendv_ps(ps, pc, swap);
+        __m256 cv = _mm256_blendv_ps(pc, ps, swap);
+        sinSign = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29)));
+        __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, two), four), 29));
+        _mm256_storeu_ps(s + i, _mm256_xor_ps(sv, sinSign));
+        _mm256_storeu_ps(c + i, _mm256_xor_ps(cv, cosSign));
+
+        int ok = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(signMask, a), maxAngle, _CMP_LE_OQ));
+        if( ok != 0xFF ) TileStore::sinCosScalar(angles, s, c, i, i + 8);
+    }
+    return i;
+}
+#else
+size_t TileStore::sinCosAVX2(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n)
+{
+    return TileStore::sinCosSSE2(angles, s, c, n);
+}
+#endif
+
+void TileStore::sinCos(const GLfloat * angles, GLfloat * s, GLfloat * c, size_t n)
+{
+    if( !TileStore::sinCosDetected )
+    {
+        TileStore::sinCosPath = CULL_SCALAR;
+        #ifdef SINCOS_HAVE_SSE2
+        TileStore::sinCosPath = CULL_SSE2;
+        #endif
+        #ifdef SINCOS_HAVE_AVX2
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx2") ) TileStore::sinCosPath = CULL_AVX2;
+        #endif
+        TileStore::sinCosDetected = true;
+    }
+
+    // Whatever doesn't fill a whole register is done one at a time.
+    size_t done = 0;
+    switch( TileStore::sinCosPath )
+    {
+        case CULL_AVX2: done = TileStore::sinCosAVX2(angles, s, c, n); break;
+        case CULL_SSE2: done = TileStore::sinCosSSE2(angles, s, c, n); break;
+        default:        break;
+    }
+    TileStore::sinCosScalar(angles, s, c, done, n);
+}
+
+size_t TileStore::getEntryBytes()
+{
+    return 13 * sizeof(GLfloat) + 3 * sizeof(unsigned char) + sizeof(Tile*) + sizeof(unsigned int);
+}
+
+void TileStore::setWidth(unsigned int i, GLfloat width)
+{
+    this->width[i] = width;
+    this->updateTransform(i);
+}
+
+void TileStore::setHeight(unsigned int i, GLfloat height)
+{
+    this->height[i] = height;
+    this->updateTransform(i);
+}
+
+void TileStore::setRotation(unsigned int i, GLfloat rotation)
+{
+    this->rotation[i] = rotation;
+    TileStore::sinCos(&rotation, &this->sinR[i], &this->cosR[i], 1);
+    this->updateTransform(i);
+}
+
+void TileStore::setFlag(unsigned int i, unsigned char flag, bool on)
+{
+    if( on ) this->flags[i] |= flag;
+    else this->flags[i] &= ~flag;
+}
+
+unsigned int TileStore::setTransforms(const TileRef * refs, const GLfloat * xs, const GLfloat * ys,
+                                      const GLfloat * rots, size_t n, Tile ** changed)
+{
+    GLfloat c[TILE_STORE_BATCH];
+    GLfloat s[TILE_STORE_BATCH];
+    unsigned int count = 0;
+    for( size_t begin = 0; begin < n; begin += TILE_STORE_BATCH )
+    {
+        size_t len = n - begin;
+        if( len > TILE_STORE_BATCH ) len = TILE_STORE_BATCH;
+
+        // The rotations are contiguous, so do all of the batch's trig in
+        // one go, several lanes at a time.
+        if( rots != NULL ) TileStore::sinCos(rots + begin, s, c, len);
+
+        // Then scatter it all into the columns.
+        for( size_t k = 0; k < len; ++k )
+        {
+            TileRef ref = refs[begin+k];
+            if( !this->isValid(ref) ) continue;
+            unsigned int i = ref.index;
+            this->x[i] = xs[begin+k];
+            this->y[i] = ys[begin+k];
+            if( rots != NULL )
+            {
+                this->rotation[i] = rots[begin+k];
+                this->cosR[i] = c[k];
+                this->sinR[i] = s[k];
+                this->updateTransform(i);
+            }
+            changed[count++] = this->owner[i];
+        }
+    }
+    return count;
+}
@@ -40,6 +40,7 @@ Window::Window()
     this->height = 0;
     this->title = (char*)"GRenderer Window :)";
     this->fullscreen = false;
+    this->hidden = false;
 }
 
 Window::~Window()
@@ -59,8 +60,8 @@ window_error Window::initGLState(unsigned int width, unsigned int height)
     
     // Set the front face to CCW.
     glFrontFace(GL_CCW);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    GLStateCache::setDepthTest(true);
+    GLStateCache::depthFunc(GL_LESS);
     
     // Enable textures.
     glEnable(GL_TEXTURE_2D);
@@ -68,8 +69,8 @@ window_error Window::initGLState(unsigned int width, unsigned int height)
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     
     // Enable alpha blending.
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLStateCache::setBlend(true);
+    GLStateCache::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
     // Enable alpha testing.
     glAlphaFunc(GL_GREATER, 0.005);
@@ -79,7 +80,7 @@ window_error Window::initGLState(unsigned int width, unsigned int height)
     // and texture coordinates into a single OpenGL object.
     glEnable(GL_VERTEX_ARRAY);
         
-    glViewport(0, 0, width, height);
+    GLStateCache::viewport(0, 0, width, height);
     
     glfwSwapInterval(1);
     
@@ -88,6 +89,11 @@ window_error Window::initGLState(unsigned int width, unsigned int height)
 
 }
 
+void Window::setHidden(bool hidden)
+{
+    this->hidden = hidden;
+}
+
 window_error Window::create(unsigned int windowW, unsigned int windowH,
                             unsigned int fbW, unsigned int fbH, char* title)
 {
@@ -111,6 +117,7 @@ window_error Window::create(unsigned int windowW, unsigned int windowH,
     // Set window hints.
     if(!e) glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
     if(!e) glfwWindowHint(GLFW_FOCUSED, GL_TRUE);
+    if(!e) glfwWindowHint(GLFW_VISIBLE, this->hidden ? GL_FALSE : GL_TRUE);
     
     // Create the GLFW window.
     this->baseWindow = NULL;
@@ -121,6 +128,9 @@ window_error Window::create(unsigned int windowW, unsigned int windowH,
     // (And also initialize GLEW.)
     if(!e) glfwMakeContextCurrent(this->baseWindow);
     
+    // Whatever the state cache thought it knew was about some other context.
+    GLStateCache::invalidate();
+    
     // Now that we have a current OpenGL context we can initialize GLEW.
     // Otherwise we'd get the dreadful "Missing GL version" error.
     if(!e)
@@ -231,6 +241,9 @@ window_error Window::setFullscreen(bool fullscreen)
     // Make the new window's context current.
     glfwMakeContextCurrent(this->baseWindow);
     
+    // Shared objects came along, but none of the state did.
+    GLStateCache::invalidate();
+    
     // Give it a resize callback.
     glfwSetWindowSizeCallback(this->baseWindow, Window::resize_callback);
     
@@ -289,11 +302,11 @@ void Window::setAsRenderTarget()
     // Bind teh current framebuffer to zero, which tells OpenGL
     // to not actually use a user-defined framebuffer, but to
     // fall back to the window context itself.
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache::bindFramebuffer(0);
     
     // Update the OpenGL state to recognize the dimensions of
     // the window.
-    glViewport(0,0,this->width, this->height);
+    GLStateCache::viewport(0,0,this->width, this->height);
 }
 
 void Window::update()
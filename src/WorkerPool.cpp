@@ -0,0 +1,136 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool()
+{
+    this->threadCount = 0;
+    this->running = false;
+    this->job = NULL;
+    this->arg = NULL;
+    this->count = 0;
+    this->parts = 0;
+    this->partSize = 0;
+    this->nextPart = 0;
+    this->remaining = 0;
+}
+
+WorkerPool::~WorkerPool()
+{
+}
+
+bool WorkerPool::init(unsigned int threads)
+{
+    if( threads > WORKER_POOL_MAX_THREADS ) threads = WORKER_POOL_MAX_THREADS;
+    pthread_mutex_init(&this->lock, NULL);
+    pthread_cond_init(&this->wake, NULL);
+    pthread_cond_init(&this->done, NULL);
+    this->running = true;
+    this->parts = this->nextPart = this->remaining = 0;
+
+    // The caller's one of them, so it doesn't need starting.
+    this->threadCount = 0;
+    for( unsigned int i = 1; i < threads; ++i )
+    {
+        if( pthread_create(&this->threads[this->threadCount], NULL, WorkerPool::work, this) != 0 )
+            return false;
+        ++ this->threadCount;
+    }
+    return true;
+}
+
+unsigned int WorkerPool::getThreadCount()
+{
+    return this->threadCount + 1;
+}
+
+void * WorkerPool::work(void * pool)
+{
+    WorkerPool * p = (WorkerPool*) pool;
+    pthread_mutex_lock(&p->lock);
+    while( true )
+    {
+        while( p->running && p->nextPart >= p->parts ) pthread_cond_wait(&p->wake, &p->lock);
+        if( !p->running ) break;
+        p->doParts();
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+void WorkerPool::doParts()
+{
+    while( this->nextPart < this->parts )
+    {
+        // Claim a part, then do it without holding anyone else up.
+        unsigned int part = this->nextPart++;
+        worker_job job = this->job;
+        void * arg = this->arg;
+        unsigned int begin = part * this->partSize;
+        unsigned int end = begin + this->partSize;
+        if( end > this->count ) end = this->count;
+        pthread_mutex_unlock(&this->lock);
+
+        job(arg, begin, end, part);
+
+        pthread_mutex_lock(&this->lock);
+        if( -- this->remaining == 0 ) pthread_cond_signal(&this->done);
+    }
+}
+
+unsigned int WorkerPool::run(worker_job job, void * arg, unsigned int count, unsigned int grain)
+{
+    if( grain == 0 ) grain = 1;
+
+    // Split it as evenly as we can, in whole grains, without making parts
+    // smaller than a grain.
+    unsigned int grains = ( count + grain - 1 ) / grain;
+    unsigned int parts = this->getThreadCount();
+    if( parts > grains ) parts = grains;
+    if( parts == 0 ) parts = 1;
+    unsigned int partSize = ( ( grains + parts - 1 ) / parts ) * grain;
+    parts = partSize ? ( count + partSize - 1 ) / partSize : 1;
+    if( parts == 0 ) parts = 1;
+
+    // Nobody else to help, so don't bother with the lock. (Or the job
+    // fields, which sleeping threads might look at.)
+    if( parts == 1 || this->threadCount == 0 )
+    {
+        this->partSize = count;
+        job(arg, 0, count, 0);
+        return 1;
+    }
+
+    pthread_mutex_lock(&this->lock);
+    this->job = job;
+    this->arg = arg;
+    this->count = count;
+    this->partSize = partSize;
+    this->remaining = parts;
+    this->nextPart = 0;
+    this->parts = parts;
+    pthread_cond_broadcast(&this->wake);
+
+    // Pitch in, then wait for the stragglers.
+    this->doParts();
+    while( this->remaining > 0 ) pthread_cond_wait(&this->done, &this->lock);
+    pthread_mutex_unlock(&this->lock);
+    return parts;
+}
+
+unsigned int WorkerPool::getPartBegin(unsigned int part)
+{
+    return part * this->partSize;
+}
+
+void WorkerPool::destroy()
+{
+    if( !this->running ) return;
+    pthread_mutex_lock(&this->lock);
+    this->running = false;
+    pthread_cond_broadcast(&this->wake);
+    pthread_mutex_unlock(&this->lock);
+    for( unsigned int i = 0; i < this->threadCount; ++i ) pthread_join(this->threads[i], NULL);
+    this->threadCount = 0;
+    pthread_cond_destroy(&this->done);
+    pthread_cond_destroy(&this->wake);
+    pthread_mutex_destroy(&this->lock);
+}
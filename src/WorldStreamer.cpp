@@ -0,0 +1,548 @@
+#include "WorldStreamer.h"
+
+/*
+ * How a chunk file is laid out: a header, then a record for each Tile, then
+ * all of the texture keys, NUL terminated, one after the other.
+ */
+struct ChunkFileHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int count;
+    unsigned int keyBytes;
+};
+
+struct ChunkFileRecord
+{
+    unsigned char type;
+    unsigned char plane;
+    unsigned char isStatic;
+    unsigned char pad;
+    GLfloat x, y;
+    GLfloat width, height;
+    unsigned int keyOffset;
+};
+
+/*
+ * Sorts requests so that the most urgent ones end up at the back.
+ */
+static bool lessUrgent(const WorldChunk * a, const WorldChunk * b)
+{
+    return a->priority > b->priority;
+}
+
+WorldStreamer::WorldStreamer()
+{
+    this->renderer = NULL;
+    this->directory[0] = '\0';
+    this->chunkSize = 1.0;
+    this->radius = 1;
+    this->prefetchTime = 0.5;
+    this->insertBudget = 4;
+    this->lastX = this->lastY = 0.0;
+    this->velX = this->velY = 0.0;
+    this->lastTime = -1.0;
+    this->workerCount = 0;
+    this->running = false;
+    this->residentChunks = 0;
+    this->residentTiles = 0;
+    this->residentBytes = 0;
+    this->loadCount = 0;
+    this->totalLatency = 0.0;
+    this->maxLatency = 0.0;
+}
+
+WorldStreamer::~WorldStreamer()
+{
+}
+
+bool WorldStreamer::init(Renderer * r, const char * directory, GLfloat chunkSize,
+                         unsigned int radius, unsigned int workers)
+{
+    this->renderer = r;
+    snprintf(this->directory, sizeof(this->directory), "%s", directory);
+    this->chunkSize = (chunkSize > 0.0) ? chunkSize : 1.0;
+    this->radius = radius;
+
+    if( workers < 1 ) workers = 1;
+    if( workers > WORLD_STREAMER_MAX_WORKERS ) workers = WORLD_STREAMER_MAX_WORKERS;
+
+    pthread_mutex_init(&this->lock, NULL);
+    pthread_cond_init(&this->wake, NULL);
+    this->running = true;
+    for( this->workerCount = 0; this->workerCount < workers; ++this->workerCount )
+    {
+        if( pthread_create(&this->workers[this->workerCount], NULL,
+                           WorldStreamer::work, this) != 0 )
+        {
+            std::cerr << "WorldStreamer: Couldn't start worker thread "
+                      << this->workerCount << "." << std::endl;
+            break;
+        }
+    }
+
+    // Make do with however many we got, as long as it's something.
+    return this->workerCount > 0;
+}
+
+void * WorldStreamer::work(void * streamer)
+{
+    ((WorldStreamer*)streamer)->workLoop();
+    return NULL;
+}
+
+void WorldStreamer::workLoop()
+{
+    pthread_mutex_lock(&this->lock);
+    while( true )
+    {
+        while( this->running && this->requests.empty() )
+            pthread_cond_wait(&this->wake, &this->lock);
+        if( !this->running ) break;
+
+        // Take the most urgent chunk and read it with the lock let go, so
+        // the main thread's never kept waiting on the disk.
+        WorldChunk * c = this->requests.back();
+        this->requests.pop_back();
+        c->state = WORLD_CHUNK_LOADING;
+        pthread_mutex_unlock(&this->lock);
+
+        this->read(c);
+
+        pthread_mutex_lock(&this->lock);
+        if( c->state != WORLD_CHUNK_CANCELLED ) c->state = WORLD_CHUNK_LOADED;
+        this->loaded.push_back(c);
+    }
+    pthread_mutex_unlock(&this->lock);
+}
+
+void WorldStreamer::chunkPath(const char * directory, int x, int y, char * path, size_t size)
+{
+    snprintf(path, size, "%s/%d_%d.chunk", directory, x, y);
+}
+
+void WorldStreamer::read(WorldChunk * c)
+{
+    char path[600];
+    WorldStreamer::chunkPath(this->directory, c->x, c->y, path, sizeof(path));
+
+    // Not every chunk of a world has something in it, so no file is just an
+    // empty chunk.
+    FILE * f = fopen(path, "rb");
+    if( f == NULL ) return;
+
+    ChunkFileHeader header;
+    std::vector<ChunkFileRecord> raw;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1
+           && header.magic == WORLD_CHUNK_MAGIC
+           && header.version == WORLD_CHUNK_VERSION;
+
+    // Make sure the file's actually big enough for what the header says
+    // before making room for it. Otherwise a broken file could have us try
+    // to allocate gigabytes.
+    if( ok )
+    {
+        long start = ftell(f);
+        ok = start >= 0 && fseek(f, 0, SEEK_END) == 0;
+        long end = ok ? ftell(f) : -1;
+        ok = ok && end >= start && fseek(f, start, SEEK_SET) == 0;
+        unsigned long long need = (unsigned long long) header.count * sizeof(ChunkFileRecord)
+                                + header.keyBytes;
+        ok = ok && need <= (unsigned long long)( end - start );
+    }
+    if( ok )
+    {
+        raw.resize(header.count);
+        c->keys.resize(header.keyBytes + 1);
+        ok = ( header.count == 0 || fread(&raw[0], sizeof(ChunkFileRecord), header.count, f) == header.count )
+          && ( header.keyBytes == 0 || fread(&c->keys[0], 1, header.keyBytes, f) == header.keyBytes );
+    }
+    fclose(f);
+
+    if( !ok )
+    {
+        std::cerr << "WorldStreamer: " << path << " is not a valid chunk file." << std::endl;
+        c->keys.clear();
+        return;
+    }
+
+    // Make sure the last key can't run off the end.
+    c->keys[header.keyBytes] = '\0';
+
+    // Decode the records, skipping any that don't make sense.
+    c->records.reserve(header.count);
+    for( unsigned int i = 0; i < header.count; ++i )
+    {
+        const ChunkFileRecord & in = raw[i];
+        if( in.keyOffset >= header.keyBytes ) continue;
+        if( in.type != BG_TILE && in.type != SCENE_TILE ) continue;
+        if( in.plane >= NUM_PLANES ) continue;
+
+        StreamedTile t;
+        t.type = (tile_type) in.type;
+        t.plane = (tile_plane) in.plane;
+        t.isStatic = in.isStatic != 0;
+        t.x = in.x;
+        t.y = in.y;
+        t.width = in.width;
+        t.height = in.height;
+        t.texture = &c->keys[in.keyOffset];
+        c->records.push_back(t);
+    }
+}
+
+void WorldStreamer::insert(WorldChunk * c, double now)
+{
+    AssetManager * assets = this->renderer->getAssetManager();
+    c->tiles.reserve(c->records.size());
+    c->handles.reserve(c->records.size());
+
+    for( unsigned int i = 0; i < c->records.size(); ++i )
+    {
+        const StreamedTile & r = c->records[i];
+
+        // We can't load Textures from here, since this isn't the only
+        // thread, so they have to already be around.
+        Texture * tex = (Texture*) assets->get(r.texture);
+        if( tex == NULL )
+        {
+            std::cerr << "WorldStreamer: Chunk (" << c->x << "," << c->y << ") uses "
+                      << r.texture << ", which isn't loaded." << std::endl;
+            continue;
+        }
+
+        Tile * t;
+        if( r.type == BG_TILE )
+        {
+            BGTile * bg = new BGTile();
+            bg->init(r.x, r.y, r.width, r.height, (char*)r.texture);
+            t = bg;
+            c->tileBytes += sizeof(BGTile);
+        }
+        else
+        {
+            SceneTile * st = new SceneTile();
+            st->init(r.x, r.y, r.plane, r.width, r.height, tex->hasAlpha(), (char*)r.texture);
+            t = st;
+            c->tileBytes += sizeof(SceneTile);
+        }
+        t->setStatic(r.isStatic);
+
+        c->tiles.push_back(t);
+        c->handles.push_back(this->renderer->addToRenderQueue(r.type, t));
+    }
+    c->state = WORLD_CHUNK_RESIDENT;
+
+    // Keep track of how we're doing.
+    double latency = now - c->requested;
+    this->totalLatency += latency;
+    if( latency > this->maxLatency ) this->maxLatency = latency;
+    ++ this->loadCount;
+    ++ this->residentChunks;
+    this->residentTiles += c->tiles.size();
+    this->residentBytes += WorldStreamer::chunkBytes(c);
+}
+
+void WorldStreamer::evict(WorldChunk * c)
+{
+    this->residentBytes -= WorldStreamer::chunkBytes(c);
+    this->residentTiles -= c->tiles.size();
+    -- this->residentChunks;
+
+    for( unsigned int i = 0; i < c->tiles.size(); ++i )
+    {
+        this->renderer->removeFromRenderQueue(c->handles[i]);
+        c->tiles[i]->destroy();
+        delete c->tiles[i];
+    }
+    c->tiles.clear();
+    c->handles.clear();
+    c->tileBytes = 0;
+}
+
+size_t WorldStreamer::chunkBytes(WorldChunk * c)
+{
+    // Each Tile has an entry in the TileStore as well.
+    size_t perTile = TileStore::getEntryBytes() + sizeof(Tile*) + sizeof(TileHandle);
+    return sizeof(WorldChunk)
+         + c->records.capacity() * sizeof(StreamedTile)
+         + c->keys.capacity()
+         + c->tileBytes
+         + c->tiles.size() * perTile;
+}
+
+void WorldStreamer::update()
+{
+    double now = glfwGetTime();
+    Camera * cam = this->renderer->getCamera();
+    GLfloat camX = cam->getX();
+    GLfloat camY = cam->getY();
+
+    // Keep a smoothed estimate of how fast the Camera's moving, so one odd
+    // frame doesn't send us prefetching off in the wrong direction.
+    if( this->lastTime >= 0.0 && now > this->lastTime )
+    {
+        GLfloat dt = (GLfloat)( now - this->lastTime );
+        this->velX = this->velX * .75 + ( (camX - this->lastX) / dt ) * .25;
+        this->velY = this->velY * .75 + ( (camY - this->lastY) / dt ) * .25;
+    }
+    this->lastX = camX;
+    this->lastY = camY;
+    this->lastTime = now;
+
+    // The chunks we want are the ones around the Camera, and the ones around
+    // where it'll be in a little while.
+    int cx = (int) floor( camX / this->chunkSize );
+    int cy = (int) floor( camY / this->chunkSize );
+    int px = (int) floor( ( camX + this->velX * this->prefetchTime ) / this->chunkSize );
+    int py = (int) floor( ( camY + this->velY * this->prefetchTime ) / this->chunkSize );
+    int rad = (int) this->radius;
+
+    pthread_mutex_lock(&this->lock);
+
+    // Let go of chunks that have gotten too far from both. There's an extra
+    // chunk of slack so that wobbling over a border doesn't thrash.
+    std::map< std::pair<int,int>, WorldChunk* >::iterator it = this->chunks.begin();
+    while( it != this->chunks.end() )
+    {
+        WorldChunk * c = it->second;
+        bool keep = ( abs(c->x - cx) <= rad + 1 && abs(c->y - cy) <= rad + 1 )
+                 || ( abs(c->x - px) <= rad + 1 && abs(c->y - py) <= rad + 1 );
+        if( keep )
+        {
+            ++ it;
+            continue;
+        }
+
+        switch( c->state )
+        {
+            case WORLD_CHUNK_QUEUED:
+                this->requests.erase(std::find(this->requests.begin(), this->requests.end(), c));
+                delete c;
+                break;
+            case WORLD_CHUNK_LOADING:
+            case WORLD_CHUNK_LOADED:
+                // It'll get cleaned up when it comes out of the loaded list.
+                c->state = WORLD_CHUNK_CANCELLED;
+                break;
+            case WORLD_CHUNK_RESIDENT:
+                this->evict(c);
+                delete c;
+                break;
+            default:
+                break;
+        }
+        this->chunks.erase(it++);
+    }
+
+    // Put what's been read into the render queues, up to our budget. The
+    // rest stay in the list for next time.
+    unsigned int inserted = 0;
+    unsigned int i = 0;
+    while( i < this->loaded.size() )
+    {
+        WorldChunk * c = this->loaded[i];
+        if( c->state == WORLD_CHUNK_CANCELLED )
+        {
+            delete c;
+        }
+        else if( inserted < this->insertBudget )
+        {
+            this->insert(c, now);
+            ++ inserted;
+        }
+        else
+        {
+            ++ i;
+            continue;
+        }
+        this->loaded[i] = this->loaded.back();
+        this->loaded.pop_back();
+    }
+
+    // Request the chunks we want that we don't have yet, and rank everything
+    // still waiting by how close it is to where the Camera is or will be.
+    bool requested = false;
+    for( int pass = 0; pass < 2; ++pass )
+    {
+        int ox = pass ? px : cx;
+        int oy = pass ? py : cy;
+        if( pass && ox == cx && oy == cy ) break;
+        for( int y = oy - rad; y <= oy + rad; ++y )
+        {
+            for( int x = ox - rad; x <= ox + rad; ++x )
+            {
+                std::pair<int,int> key(x, y);
+                if( this->chunks.find(key) != this->chunks.end() ) continue;
+
+                WorldChunk * c = new WorldChunk();
+                c->x = x;
+                c->y = y;
+                c->state = WORLD_CHUNK_QUEUED;
+                c->priority = 0.0;
+                c->requested = now;
+                c->tileBytes = 0;
+                this->chunks[key] = c;
+                this->requests.push_back(c);
+                requested = true;
+            }
+        }
+    }
+    for( i = 0; i < this->requests.size(); ++i )
+    {
+        WorldChunk * c = this->requests[i];
+        GLfloat dc = (GLfloat) std::max( abs(c->x - cx), abs(c->y - cy) );
+        GLfloat dp = (GLfloat) std::max( abs(c->x - px), abs(c->y - py) );
+        c->priority = std::min(dc, dp + .5f);
+    }
+    std::sort(this->requests.begin(), this->requests.end(), lessUrgent);
+
+    pthread_mutex_unlock(&this->lock);
+    if( requested ) pthread_cond_broadcast(&this->wake);
+}
+
+void WorldStreamer::setRadius(unsigned int radius)
+{
+    this->radius = radius;
+}
+
+void WorldStreamer::setPrefetchTime(GLfloat seconds)
+{
+    this->prefetchTime = seconds;
+}
+
+void WorldStreamer::setInsertBudget(unsigned int chunks)
+{
+    this->insertBudget = (chunks > 0) ? chunks : 1;
+}
+
+unsigned int WorldStreamer::getResidentChunks()
+{
+    return this->residentChunks;
+}
+
+unsigned int WorldStreamer::getResidentTiles()
+{
+    return this->residentTiles;
+}
+
+size_t WorldStreamer::getResidentBytes()
+{
+    return this->residentBytes;
+}
+
+unsigned int WorldStreamer::getPendingChunks()
+{
+    return this->chunks.size() - this->residentChunks;
+}
+
+double WorldStreamer::getAverageLatency()
+{
+    return this->loadCount ? this->totalLatency / this->loadCount : 0.0;
+}
+
+double WorldStreamer::getMaxLatency()
+{
+    return this->maxLatency;
+}
+
+void WorldStreamer::report()
+{
+    std::cout << "WorldStreamer: " << this->residentChunks << " chunks, "
+              << this->residentTiles << " tiles, "
+              << this->residentBytes / 1024 << " KiB resident; "
+              << this->getPendingChunks() << " pending; latency avg "
+              << this->getAverageLatency() * 1000.0 << "ms max "
+              << this->maxLatency * 1000.0 << "ms" << std::endl;
+}
+
+bool WorldStreamer::writeChunk(const char * directory, int x, int y,
+                               const StreamedTile * tiles, unsigned int n)
+{
+    // Lay out the records and the keys they point to.
+    std::vector<ChunkFileRecord> records(n);
+    std::vector<char> keys;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        ChunkFileRecord & out = records[i];
+        out.type = (unsigned char) tiles[i].type;
+        out.plane = (unsigned char) tiles[i].plane;
+        out.isStatic = tiles[i].isStatic ? 1 : 0;
+        out.pad = 0;
+        out.x = tiles[i].x;
+        out.y = tiles[i].y;
+        out.width = tiles[i].width;
+        out.height = tiles[i].height;
+        out.keyOffset = keys.size();
+        keys.insert(keys.end(), tiles[i].texture, tiles[i].texture + strlen(tiles[i].texture) + 1);
+    }
+
+    ChunkFileHeader header;
+    header.magic = WORLD_CHUNK_MAGIC;
+    header.version = WORLD_CHUNK_VERSION;
+    header.count = n;
+    header.keyBytes = keys.size();
+
+    char path[600];
+    WorldStreamer::chunkPath(directory, x, y, path, sizeof(path));
+    FILE * f = fopen(path, "wb");
+    if( f == NULL ) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+           && ( n == 0 || fwrite(&records[0], sizeof(ChunkFileRecord), n, f) == n )
+           && ( keys.empty() || fwrite(&keys[0], 1, keys.size(), f) == keys.size() );
+    return fclose(f) == 0 && ok;
+}
+
+bool WorldStreamer::writeWorld(const char * directory, GLfloat chunkSize,
+                               const StreamedTile * tiles, unsigned int n)
+{
+    // Bucket the Tiles by the chunk their center's in.
+    std::map< std::pair<int,int>, std::vector<StreamedTile> > buckets;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        std::pair<int,int> key( (int) floor( tiles[i].x / chunkSize ),
+                                (int) floor( tiles[i].y / chunkSize ) );
+        buckets[key].push_back(tiles[i]);
+    }
+
+    bool ok = true;
+    std::map< std::pair<int,int>, std::vector<StreamedTile> >::iterator it;
+    for( it = buckets.begin(); it != buckets.end(); ++it )
+    {
+        ok = WorldStreamer::writeChunk(directory, it->first.first, it->first.second,
+                                       &it->second[0], it->second.size()) && ok;
+    }
+    return ok;
+}
+
+void WorldStreamer::destroy()
+{
+    if( this->workerCount == 0 ) return;
+
+    // Tell the workers to stop, and wait for them to.
+    pthread_mutex_lock(&this->lock);
+    this->running = false;
+    pthread_mutex_unlock(&this->lock);
+    pthread_cond_broadcast(&this->wake);
+    for( unsigned int i = 0; i < this->workerCount; ++i ) pthread_join(this->workers[i], NULL);
+    this->workerCount = 0;
+
+    // Now that we're alone, free everything. Chunks that are in the map
+    // and not resident are also in requests or loaded, so they're freed
+    // from there.
+    std::map< std::pair<int,int>, WorldChunk* >::iterator it;
+    for( it = this->chunks.begin(); it != this->chunks.end(); ++it )
+    {
+        if( it->second->state != WORLD_CHUNK_RESIDENT ) continue;
+        this->evict(it->second);
+        delete it->second;
+    }
+    this->chunks.clear();
+    for( unsigned int i = 0; i < this->requests.size(); ++i ) delete this->requests[i];
+    for( unsigned int i = 0; i < this->loaded.size(); ++i ) delete this->loaded[i];
+    this->requests.clear();
+    this->loaded.clear();
+
+    pthread_mutex_destroy(&this->lock);
+    pthread_cond_destroy(&this->wake);
+}